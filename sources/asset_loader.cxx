@@ -0,0 +1,60 @@
+#include <cassert>
+#include <chrono>
+
+#include "asset_loader.hxx"
+
+AssetLoader::AssetLoader(uint32_t worker_count)
+    : jobs(worker_count) {}
+
+void AssetLoader::load_model(std::filesystem::path path, ModelCallback on_loaded) {
+    ++this->requested_count;
+    auto load = [this, path = std::move(path), on_loaded = std::move(on_loaded)]() mutable {
+        auto start = std::chrono::steady_clock::now();
+        auto model = Model<uint32_t>::from_glb_file(path);
+        assert(model.check_indices_all_in_bounds());
+        auto end = std::chrono::steady_clock::now();
+        log_verbose(
+            "loaded {} in {:.1f} ms",
+            path.string(),
+            std::chrono::duration<double, std::milli>(end - start).count()
+        );
+
+        auto lock = std::lock_guard(this->mutex);
+        this->load_seconds += std::chrono::duration<double>(end - start).count();
+        this->loaded_models.push_back(LoadedModel {
+            .model = std::move(model),
+            .on_loaded = std::move(on_loaded),
+        });
+    };
+    this->jobs.submit(this->counter, std::move(load));
+}
+
+size_t AssetLoader::dispatch_loaded() {
+    if (this->jobs.get_worker_count() == 0) {
+        this->jobs.wait(this->counter);
+    }
+    auto loaded_models = std::vector<LoadedModel>();
+    {
+        auto lock = std::lock_guard(this->mutex);
+        std::swap(loaded_models, this->loaded_models);
+    }
+    // Outside of the lock, callbacks may request more models.
+    for (auto& loaded : loaded_models) {
+        loaded.on_loaded(std::move(loaded.model));
+    }
+    this->dispatched_count += loaded_models.size();
+    return loaded_models.size();
+}
+
+bool AssetLoader::is_idle() const {
+    return this->dispatched_count == this->requested_count;
+}
+
+AssetLoader::Stats AssetLoader::stats() const {
+    auto lock = std::lock_guard(this->mutex);
+    return Stats {
+        .requested_count = this->requested_count,
+        .dispatched_count = this->dispatched_count,
+        .load_seconds = this->load_seconds,
+    };
+}
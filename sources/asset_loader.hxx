@@ -0,0 +1,65 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "geometry/model.hxx"
+#include "job_system.hxx"
+
+/// Loads models on worker threads of its own, and hands them back to the thread owning the scene.
+///
+/// Reading, parsing and decoding the attributes of glTF files happen on the workers, so loading
+/// many files scales with the number of cores. GPU resources are created from the loaded models in
+/// callbacks run by `dispatch_loaded`, on the thread calling it, e.g. between frames or between
+/// processing window events. Workers are separate from the job system of the scene, which would
+/// otherwise run long loads while waiting for the short jobs of a frame.
+class AssetLoader {
+  public:
+    using ModelCallback = std::function<void(Model<uint32_t> model)>;
+
+    struct Stats {
+        size_t requested_count = 0;
+        size_t dispatched_count = 0;
+        /// Summed over workers, of reading and parsing files.
+        double load_seconds = 0;
+    };
+
+  private:
+    struct LoadedModel {
+        Model<uint32_t> model;
+        ModelCallback on_loaded;
+    };
+
+    /// Written by workers, declared before `jobs` to outlive them.
+    mutable std::mutex mutex = {};
+    std::vector<LoadedModel> loaded_models = {};
+    double load_seconds = 0;
+
+    JobSystem::Counter counter = {};
+    size_t requested_count = 0;
+    size_t dispatched_count = 0;
+
+    JobSystem jobs;
+
+  public:
+    /// Without workers, models are loaded by `dispatch_loaded`.
+    explicit AssetLoader(uint32_t worker_count);
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    /// Loads the `.glb` file at `path` on a worker. `on_loaded` is called with the model by a later
+    /// `dispatch_loaded`. Aborts if the file is missing or invalid.
+    void load_model(std::filesystem::path path, ModelCallback on_loaded);
+
+    /// Calls the callbacks of models loaded since the last call, in the order they finished
+    /// loading. Returns the number of callbacks called.
+    size_t dispatch_loaded();
+
+    /// Whether all requested models were dispatched.
+    bool is_idle() const;
+
+    Stats stats() const;
+};
@@ -0,0 +1,394 @@
+#include "benchmark.hxx"
+#include "bvh.hxx"
+#include "job_system.hxx"
+#include "log.hxx"
+#include "render_queue.hxx"
+#include "transform_system.hxx"
+
+#include <chrono>
+#include <glm/ext.hpp>
+#include <random>
+#include <thread>
+
+/// Stand-in of `Entity` for what spatial queries need.
+struct BenchmarkEntity {
+    glm::mat4x4 model_matrix;
+    BoundingBox local_bounds;
+};
+
+/// Runs `f` `repeat` times, returns the average duration in milliseconds.
+template <class F>
+static inline double time_ms(size_t repeat, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repeat; ++i) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / (double)repeat;
+}
+
+void run_bvh_benchmark(size_t entity_count) {
+    constexpr size_t REPEAT = 20;
+    constexpr size_t QUERY_COUNT = 1000;
+
+    // Unit cubes scattered in a cube of the world, with roughly constant density.
+    auto world_size = 10.0f * std::cbrt((float)entity_count);
+    auto rng = std::mt19937(42);
+    auto random_position = std::uniform_real_distribution<float>(0, world_size);
+    auto random_scale = std::uniform_real_distribution<float>(0.5f, 4.0f);
+    auto random_direction = std::uniform_real_distribution<float>(-1, 1);
+    auto entities = std::vector<BenchmarkEntity>(entity_count);
+    for (auto& entity : entities) {
+        auto position = glm::vec3(random_position(rng), random_position(rng), random_position(rng));
+        auto scale = glm::vec3(random_scale(rng));
+        entity.model_matrix = glm::scale(glm::translate(glm::mat4x4(1), position), scale);
+        entity.local_bounds = BoundingBox {
+            .min = glm::vec3(0, 0, 0),
+            .max = glm::vec3(1, 1, 1),
+        };
+    }
+
+    log_info("BVH benchmark: {} entities in a world of size {}", entity_count, world_size);
+
+    auto bvh = DynamicBvh();
+    auto proxies = std::vector<uint32_t>(entity_count);
+    auto build_ms = time_ms(1, [&] {
+        for (size_t i = 0; i < entity_count; ++i) {
+            auto bounds = entities[i].local_bounds.transformed(entities[i].model_matrix);
+            proxies[i] = bvh.insert(bounds, (uint32_t)i);
+        }
+        bvh.rebuild();
+    });
+    log_info("build: {:.3f} ms, height {}", build_ms, bvh.height());
+
+    // Frustum culling, from the center of the world looking along +X.
+    auto projection =
+        glm::perspectiveRH_NO(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, world_size * 0.5f);
+    auto eye = glm::vec3(world_size * 0.5f);
+    auto view = glm::lookAtRH(eye, eye + glm::vec3(1, 0, 0), glm::vec3(0, 1, 0));
+    auto frustum = Frustum::from_view_projection(projection * view);
+    size_t brute_force_visible = 0;
+    auto brute_force_ms = time_ms(REPEAT, [&] {
+        brute_force_visible = 0;
+        for (const auto& entity : entities) {
+            auto bounds = entity.local_bounds.transformed(entity.model_matrix);
+            brute_force_visible += frustum.test(bounds) != FrustumTest::Outside;
+        }
+    });
+    auto culler = FrustumCuller();
+    size_t simd_visible = 0;
+    auto simd_ms = time_ms(REPEAT, [&] {
+        culler.clear();
+        for (const auto& entity : entities) {
+            culler.push(entity.local_bounds.transformed(entity.model_matrix));
+        }
+        culler.cull(frustum);
+        simd_visible = 0;
+        for (auto visible : culler.get_visibility()) {
+            simd_visible += visible;
+        }
+    });
+    auto results = std::vector<uint32_t>();
+    auto bvh_ms = time_ms(REPEAT, [&] {
+        results.clear();
+        bvh.query_frustum(frustum, results);
+    });
+    log_info(
+        "frustum: brute force {:.3f} ms, SIMD {:.3f} ms, BVH {:.3f} ms (visible: {}, {}, {})",
+        brute_force_ms,
+        simd_ms,
+        bvh_ms,
+        brute_force_visible,
+        simd_visible,
+        results.size()
+    );
+
+    // Raycasts from random points in random directions.
+    auto ray_origins = std::vector<glm::vec3>(QUERY_COUNT);
+    auto ray_directions = std::vector<glm::vec3>(QUERY_COUNT);
+    for (size_t i = 0; i < QUERY_COUNT; ++i) {
+        ray_origins[i] =
+            glm::vec3(random_position(rng), random_position(rng), random_position(rng));
+        ray_directions[i] =
+            glm::vec3(random_direction(rng), random_direction(rng), random_direction(rng));
+    }
+    size_t brute_force_hits = 0;
+    brute_force_ms = time_ms(1, [&] {
+        brute_force_hits = 0;
+        for (size_t i = 0; i < QUERY_COUNT; ++i) {
+            auto closest = std::numeric_limits<float>::infinity();
+            auto inverse_direction = inverse_ray_direction(ray_directions[i]);
+            if (!inverse_direction.has_value()) {
+                continue;
+            }
+            for (const auto& entity : entities) {
+                auto bounds = entity.local_bounds.transformed(entity.model_matrix);
+                auto distance = ray_box_distance(bounds, ray_origins[i], *inverse_direction);
+                closest = std::min(closest, distance);
+            }
+            brute_force_hits += closest != std::numeric_limits<float>::infinity();
+        }
+    });
+    size_t bvh_hits = 0;
+    bvh_ms = time_ms(1, [&] {
+        bvh_hits = 0;
+        for (size_t i = 0; i < QUERY_COUNT; ++i) {
+            bvh_hits += bvh.raycast(ray_origins[i], ray_directions[i]).has_value();
+        }
+    });
+    log_info(
+        "{} raycasts: brute force {:.3f} ms, BVH {:.3f} ms (hits: {}, {})",
+        QUERY_COUNT,
+        brute_force_ms,
+        bvh_ms,
+        brute_force_hits,
+        bvh_hits
+    );
+
+    // Box queries of random boxes.
+    auto query_boxes = std::vector<BoundingBox>(QUERY_COUNT);
+    for (auto& box : query_boxes) {
+        auto min = glm::vec3(random_position(rng), random_position(rng), random_position(rng));
+        box = BoundingBox {
+            .min = min,
+            .max = min + glm::vec3(10),
+        };
+    }
+    size_t brute_force_found = 0;
+    brute_force_ms = time_ms(1, [&] {
+        brute_force_found = 0;
+        for (const auto& box : query_boxes) {
+            for (const auto& entity : entities) {
+                auto bounds = entity.local_bounds.transformed(entity.model_matrix);
+                brute_force_found += bounds.intersects(box);
+            }
+        }
+    });
+    bvh_ms = time_ms(1, [&] {
+        results.clear();
+        for (const auto& box : query_boxes) {
+            bvh.query_aabb(box, results);
+        }
+    });
+    log_info(
+        "{} box queries: brute force {:.3f} ms, BVH {:.3f} ms (found: {}, {})",
+        QUERY_COUNT,
+        brute_force_ms,
+        bvh_ms,
+        brute_force_found,
+        results.size()
+    );
+
+    // Incremental updates, moving 1% of the entities by a small step each frame.
+    auto random_step = std::uniform_real_distribution<float>(-0.5f, 0.5f);
+    size_t reinsert_count = 0;
+    size_t rebuild_count = 0;
+    auto update_ms = time_ms(REPEAT, [&] {
+        for (size_t i = 0; i < entity_count; i += 100) {
+            auto step = glm::vec3(random_step(rng), random_step(rng), random_step(rng));
+            auto& entity = entities[i];
+            entity.model_matrix = glm::translate(glm::mat4x4(1), step) * entity.model_matrix;
+            auto bounds = entity.local_bounds.transformed(entity.model_matrix);
+            reinsert_count += bvh.update(proxies[i], bounds);
+        }
+        rebuild_count += bvh.rebuild_if_degraded();
+    });
+    log_info(
+        "update of 1% entities: {:.3f} ms per frame, {} re-inserts and {} rebuilds in {} frames",
+        update_ms,
+        reinsert_count,
+        rebuild_count,
+        REPEAT
+    );
+}
+
+void run_transform_benchmark(size_t entity_count) {
+    constexpr size_t REPEAT = 20;
+
+    auto rng = std::mt19937(42);
+    auto random_position = std::uniform_real_distribution<float>(-100, 100);
+    auto random_angle = std::uniform_real_distribution<float>(0, glm::two_pi<float>());
+    auto random_scale = std::uniform_real_distribution<float>(0.5f, 4.0f);
+    auto transforms = std::vector<Transform>(entity_count);
+    for (auto& transform : transforms) {
+        transform = Transform {
+            .translation =
+                glm::vec3(random_position(rng), random_position(rng), random_position(rng)),
+            .rotation = glm::angleAxis(
+                random_angle(rng),
+                glm::normalize(glm::vec3(random_position(rng), random_position(rng), 1))
+            ),
+            .scale = glm::vec3(random_scale(rng), random_scale(rng), random_scale(rng)),
+        };
+    }
+
+    log_info("transform benchmark: {} entities, all moving every frame", entity_count);
+
+    // What `Entity::prepare_for_drawing` used to do for each entity.
+    auto per_entity = std::vector<InstanceTransforms>(entity_count);
+    auto per_entity_ms = time_ms(REPEAT, [&] {
+        for (size_t i = 0; i < entity_count; ++i) {
+            auto model = transforms[i].to_matrix();
+            per_entity[i] = InstanceTransforms {
+                .model = model,
+                .normal_transform = glm::transpose(glm::inverse(model)),
+            };
+        }
+    });
+
+    auto system = TransformSystem();
+    auto slots = std::vector<uint32_t>(entity_count);
+    for (size_t i = 0; i < entity_count; ++i) {
+        slots[i] = (uint32_t)i;
+    }
+    auto batched = std::vector<InstanceTransforms>(entity_count);
+    double update_ms = 0;
+    double write_ms = 0;
+    for (size_t repeat = 0; repeat < REPEAT; ++repeat) {
+        for (size_t i = 0; i < entity_count; ++i) {
+            system.set((uint32_t)i, transforms[i]);
+        }
+        update_ms += time_ms(1, [&] { system.update(); });
+        write_ms += time_ms(1, [&] { system.write_instances(slots, batched); });
+    }
+    update_ms /= (double)REPEAT;
+    write_ms /= (double)REPEAT;
+
+    float max_error = 0;
+    for (size_t i = 0; i < entity_count; ++i) {
+        const auto& expected = per_entity[i];
+        const auto& actual = batched[i];
+        // Shaders only use the xyz of transformed normals, in which the general inverse and the TRS
+        // one agree.
+        for (int column = 0; column < 4; ++column) {
+            auto errors = glm::max(
+                glm::abs(expected.model[column] - actual.model[column]),
+                glm::abs(expected.normal_transform[column] - actual.normal_transform[column])
+            );
+            max_error = std::max({max_error, errors.x, errors.y, errors.z});
+        }
+    }
+    log_info(
+        "per entity {:.3f} ms, batched with {} kernels {:.3f} ms (update {:.3f} ms, write {:.3f} "
+        "ms), max error {}",
+        per_entity_ms,
+        system.kernel_name(),
+        update_ms + write_ms,
+        update_ms,
+        write_ms,
+        max_error
+    );
+}
+
+void run_job_system_benchmark(size_t entity_count) {
+    constexpr size_t REPEAT = 20;
+    // As in `Scene`.
+    constexpr size_t CHUNK_SIZE = 4096;
+
+    auto world_size = 10.0f * std::cbrt((float)entity_count);
+    auto rng = std::mt19937(42);
+    auto random_position = std::uniform_real_distribution<float>(0, world_size);
+    auto random_angle = std::uniform_real_distribution<float>(0, glm::two_pi<float>());
+    auto random_scale = std::uniform_real_distribution<float>(0.5f, 4.0f);
+    auto system = TransformSystem();
+    auto slots = std::vector<uint32_t>(entity_count);
+    for (size_t i = 0; i < entity_count; ++i) {
+        system.set(
+            (uint32_t)i,
+            Transform {
+                .translation =
+                    glm::vec3(random_position(rng), random_position(rng), random_position(rng)),
+                .rotation = glm::angleAxis(random_angle(rng), glm::vec3(0, 1, 0)),
+                .scale = glm::vec3(random_scale(rng)),
+            }
+        );
+        slots[i] = (uint32_t)i;
+    }
+    system.update();
+    auto local_bounds = BoundingBox {
+        .min = glm::vec3(0, 0, 0),
+        .max = glm::vec3(1, 1, 1),
+    };
+
+    // From the center of the world looking along +X, as in `run_bvh_benchmark`.
+    auto projection =
+        glm::perspectiveRH_NO(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, world_size * 0.5f);
+    auto eye = glm::vec3(world_size * 0.5f);
+    auto view = glm::lookAtRH(eye, eye + glm::vec3(1, 0, 0), glm::vec3(0, 1, 0));
+    auto frustum = Frustum::from_view_projection(projection * view);
+
+    auto max_thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    auto thread_counts = std::vector<uint32_t>();
+    for (uint32_t count = 1; count < max_thread_count; count *= 2) {
+        thread_counts.push_back(count);
+    }
+    thread_counts.push_back(max_thread_count);
+
+    log_info(
+        "job system benchmark: {} entities in chunks of {}, up to {} threads",
+        entity_count,
+        CHUNK_SIZE,
+        max_thread_count
+    );
+
+    auto instances = std::vector<InstanceTransforms>(entity_count);
+    auto visibility = std::vector<uint8_t>(entity_count);
+    auto sort_keys = std::vector<uint64_t>(entity_count);
+    auto chunk_count = (entity_count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    auto cullers = std::vector<FrustumCuller>(chunk_count);
+    auto chunk_visible_counts = std::vector<size_t>(chunk_count);
+    double single_thread_ms = 0;
+    for (auto thread_count : thread_counts) {
+        auto jobs = JobSystem(thread_count - 1);
+        auto write_ms = time_ms(REPEAT, [&] {
+            jobs.parallel_for(entity_count, CHUNK_SIZE, [&](size_t, size_t begin, size_t end) {
+                system.write_instances(
+                    std::span(slots).subspan(begin, end - begin),
+                    std::span(instances).subspan(begin, end - begin)
+                );
+            });
+        });
+        auto cull_chunk = [&](size_t chunk, size_t begin, size_t end) {
+            auto& culler = cullers[chunk];
+            culler.clear();
+            for (size_t i = begin; i < end; ++i) {
+                culler.push(local_bounds.transformed(system.get_model_matrix((uint32_t)i)));
+            }
+            culler.cull(frustum);
+            auto chunk_visibility = culler.get_visibility();
+            std::ranges::copy(chunk_visibility, visibility.begin() + (ptrdiff_t)begin);
+            chunk_visible_counts[chunk] = (size_t)std::ranges::count(chunk_visibility, 1);
+        };
+        auto cull_ms =
+            time_ms(REPEAT, [&] { jobs.parallel_for(entity_count, CHUNK_SIZE, cull_chunk); });
+        auto sort_key_ms = time_ms(REPEAT, [&] {
+            jobs.parallel_for(entity_count, CHUNK_SIZE, [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    // As `Entity::sort_key`, of one material and geometry.
+                    auto depth = -(view * system.get_model_matrix((uint32_t)i)[3]).z;
+                    sort_keys[i] =
+                        visibility[i] != 0 ? RenderQueue::make_key(0, nullptr, nullptr, depth) : 0;
+                }
+            });
+        });
+        auto total_ms = write_ms + cull_ms + sort_key_ms;
+        if (thread_count == 1) {
+            single_thread_ms = total_ms;
+        }
+        size_t visible_count = 0;
+        for (auto count : chunk_visible_counts) {
+            visible_count += count;
+        }
+        log_info(
+            "{} threads: {:.3f} ms (write {:.3f} ms, cull {:.3f} ms, sort keys {:.3f} ms), "
+            "speedup {:.2f}x, visible {}",
+            thread_count,
+            total_ms,
+            write_ms,
+            cull_ms,
+            sort_key_ms,
+            single_thread_ms / total_ms,
+            visible_count
+        );
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+/// CPU benchmark of `DynamicBvh` against brute-force iteration over the same entities, for frustum
+/// culling, raycasts, box queries and incremental updates. Results are logged.
+///
+/// Runs without a GPU device, with entities reduced to their model matrices and local bounds.
+void run_bvh_benchmark(size_t entity_count);
+
+/// CPU benchmark of `TransformSystem` against computing instance transforms per entity from a model
+/// matrix, with a general inverse for the normal matrix. Results are logged.
+void run_transform_benchmark(size_t entity_count);
+
+/// CPU benchmark of the per-frame preparation that `Scene::draw` splits into chunks with a
+/// `JobSystem`: writing instance transforms, frustum culling and computing sort keys, from 1 thread
+/// to one per hardware thread. Results are logged with the speedup over 1 thread.
+///
+/// Recording render bundles needs a device, so it is not part of this benchmark.
+void run_job_system_benchmark(size_t entity_count);
@@ -0,0 +1,168 @@
+#include <fmt/format.h>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "blob_cache.hxx"
+#include "log.hxx"
+
+using namespace std::literals;
+
+/// FNV-1a.
+static uint64_t hash_bytes(const void* data, size_t size) {
+    auto hash = (uint64_t)0xcbf29ce484222325;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= ((const uint8_t*)data)[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+#if !defined(__EMSCRIPTEN__)
+static size_t load_blob(
+    const void* key,
+    size_t key_size,
+    void* value,
+    size_t value_size,
+    void* userdata
+) {
+    return ((BlobCache*)userdata)->load(key, key_size, value, value_size);
+}
+
+static void store_blob(
+    const void* key,
+    size_t key_size,
+    const void* value,
+    size_t value_size,
+    void* userdata
+) {
+    ((BlobCache*)userdata)->store(key, key_size, value, value_size);
+}
+#endif
+
+BlobCache::BlobCache(const std::filesystem::path& root, const wgpu::AdapterInfo& adapter_info) {
+    this->isolation_key = fmt::format(
+        "{:04x}-{:04x}-{}-{}",
+        adapter_info.vendorID,
+        adapter_info.deviceID,
+        (uint32_t)adapter_info.backendType,
+        std::string_view(adapter_info.description)
+    );
+    auto adapter_directory =
+        fmt::format("{:016x}", hash_bytes(this->isolation_key.data(), this->isolation_key.size()));
+    this->directory = root / fmt::format("v{}", VERSION) / adapter_directory;
+
+    auto error = std::error_code();
+    std::filesystem::create_directories(this->directory, error);
+    if (error) {
+        log_warn(
+            "cannot create blob cache directory {}: {}",
+            this->directory.string(),
+            error.message()
+        );
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(this->directory, error)) {
+        if (entry.path().extension() == ".blob") {
+            ++this->stats_.initial_blob_count;
+        }
+    }
+    log_verbose(
+        "blob cache at {} with {} blobs",
+        this->directory.string(),
+        this->stats_.initial_blob_count
+    );
+
+#if !defined(__EMSCRIPTEN__)
+    this->cache_descriptor.isolationKey = wgpu::StringView(this->isolation_key);
+    this->cache_descriptor.loadDataFunction = load_blob;
+    this->cache_descriptor.storeDataFunction = store_blob;
+    this->cache_descriptor.functionUserdata = this;
+#endif
+}
+
+const wgpu::ChainedStruct* BlobCache::device_descriptor_chain() const {
+#if !defined(__EMSCRIPTEN__)
+    return &this->cache_descriptor;
+#else
+    return nullptr;
+#endif
+}
+
+const std::filesystem::path& BlobCache::get_directory() const {
+    return this->directory;
+}
+
+bool BlobCache::is_warm() const {
+    return this->stats_.initial_blob_count > 0;
+}
+
+size_t BlobCache::load(const void* key, size_t key_size, void* value, size_t value_size) {
+    auto path = this->directory / fmt::format("{:016x}.blob", hash_bytes(key, key_size));
+    auto stream = std::ifstream(path, std::ios::binary);
+    auto blob_key_size = (uint64_t)0;
+    auto blob_key = std::vector<uint8_t>();
+    auto blob_size = (uint64_t)0;
+    auto is_hit = false;
+    if (stream.read((char*)&blob_key_size, sizeof(blob_key_size)) && blob_key_size == key_size) {
+        blob_key.resize(key_size);
+        is_hit = stream.read((char*)blob_key.data(), (std::streamsize)key_size) &&
+                 std::memcmp(blob_key.data(), key, key_size) == 0 &&
+                 stream.read((char*)&blob_size, sizeof(blob_size));
+    }
+    if (is_hit && value != nullptr && value_size >= blob_size) {
+        is_hit = (bool)stream.read((char*)value, (std::streamsize)blob_size);
+    }
+
+    // Dawn asks for the size first, then for the blob if there is one: the first call is counted.
+    if (value == nullptr) {
+        auto lock = std::lock_guard(this->mutex);
+        ++this->stats_.load_count;
+        if (is_hit) {
+            ++this->stats_.hit_count;
+        }
+    }
+    return is_hit ? (size_t)blob_size : 0;
+}
+
+void BlobCache::store(const void* key, size_t key_size, const void* value, size_t value_size) {
+    // Random per process, as the counter alone would collide between processes sharing the cache.
+    static const auto process_tag = std::random_device()();
+    static std::atomic<uint64_t> temporary_index = 0;
+    auto name = fmt::format("{:016x}", hash_bytes(key, key_size));
+    auto path = this->directory / (name + ".blob");
+    // Written aside then renamed, so that other processes never load half a blob.
+    auto temporary_path = this->directory /
+                          fmt::format("{}.{:08x}.{}.tmp", name, process_tag, temporary_index++);
+    {
+        auto stream = std::ofstream(temporary_path, std::ios::binary | std::ios::trunc);
+        auto blob_key_size = (uint64_t)key_size;
+        auto blob_size = (uint64_t)value_size;
+        stream.write((const char*)&blob_key_size, sizeof(blob_key_size));
+        stream.write((const char*)key, (std::streamsize)key_size);
+        stream.write((const char*)&blob_size, sizeof(blob_size));
+        stream.write((const char*)value, (std::streamsize)value_size);
+        if (!stream) {
+            log_warn("cannot write blob cache file {}", temporary_path.string());
+            return;
+        }
+    }
+    auto error = std::error_code();
+    std::filesystem::rename(temporary_path, path, error);
+    if (error) {
+        log_warn("cannot write blob cache file {}: {}", path.string(), error.message());
+        std::filesystem::remove(temporary_path, error);
+        return;
+    }
+
+    auto lock = std::lock_guard(this->mutex);
+    ++this->stats_.store_count;
+    this->stats_.stored_bytes += value_size;
+}
+
+BlobCache::Stats BlobCache::stats() const {
+    auto lock = std::lock_guard(this->mutex);
+    return this->stats_;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <webgpu/webgpu_cpp.h>
+
+/// On-disk cache of compiled shaders and pipelines, plugged into Dawn at device creation, so that
+/// later runs load them instead of compiling the same WGSL again.
+///
+/// Blobs are files in `<root>/v<VERSION>/<adapter>/`, named by a hash of their key and starting
+/// with the key itself, so that hash collisions are misses. Bumping `VERSION` invalidates all
+/// caches, e.g. when the layout of the files changes. Dawn may load and store blobs from its own
+/// threads.
+class BlobCache {
+  public:
+    static constexpr uint32_t VERSION = 1;
+
+    struct Stats {
+        /// Blobs in the directory when the cache was opened, 0 for a cold start.
+        size_t initial_blob_count = 0;
+        size_t load_count = 0;
+        size_t hit_count = 0;
+        size_t store_count = 0;
+        size_t stored_bytes = 0;
+    };
+
+  private:
+    std::filesystem::path directory = {};
+    std::string isolation_key = {};
+    mutable std::mutex mutex = {};
+    Stats stats_ = {};
+#if !defined(__EMSCRIPTEN__)
+    wgpu::DawnCacheDeviceDescriptor cache_descriptor = {};
+#endif
+
+  public:
+    /// Blobs of devices of `adapter_info` under `root`, created if missing.
+    BlobCache(const std::filesystem::path& root, const wgpu::AdapterInfo& adapter_info);
+
+    /// Points into the cache, which must not move.
+    BlobCache(const BlobCache&) = delete;
+    BlobCache& operator=(const BlobCache&) = delete;
+
+    /// To chain into `wgpu::DeviceDescriptor::nextInChain`, null where Dawn's cache hooks are not
+    /// available.
+    const wgpu::ChainedStruct* device_descriptor_chain() const;
+
+    /// Versioned directory of the adapter, also holding other per-run caches.
+    const std::filesystem::path& get_directory() const;
+
+    bool is_warm() const;
+
+    /// Copies the blob of `key` into `value` if it fits, and returns its size, 0 if missing.
+    size_t load(const void* key, size_t key_size, void* value, size_t value_size);
+
+    void store(const void* key, size_t key_size, const void* value, size_t value_size);
+
+    Stats stats() const;
+};
@@ -0,0 +1,405 @@
+#include "bvh.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <glm/common.hpp>
+
+/// Fraction of a box's largest dimension that its fat box extends by on every side.
+static constexpr float FAT_MARGIN = 0.1f;
+
+/// The tree is rebuilt once its surface area heuristic cost grows beyond this factor of the cost
+/// right after the last rebuild.
+static constexpr float REBUILD_FACTOR = 1.5f;
+
+static inline BoundingBox fatten(const BoundingBox& box) {
+    auto size = box.max - box.min;
+    auto margin = glm::vec3(FAT_MARGIN * std::max({size.x, size.y, size.z}));
+    return BoundingBox {
+        .min = box.min - margin,
+        .max = box.max + margin,
+    };
+}
+
+std::optional<glm::vec3> inverse_ray_direction(glm::vec3 direction) {
+    if (std::isnan(direction.x) || std::isnan(direction.y) || std::isnan(direction.z) ||
+        direction == glm::vec3(0)) {
+        return std::nullopt;
+    }
+    // 1 / +-0 is +-infinity.
+    return 1.0f / direction;
+}
+
+float ray_box_distance(
+    const BoundingBox& box,
+    glm::vec3 origin,
+    glm::vec3 inverse_direction,
+    float max_distance
+) {
+    auto t_enter = 0.0f;
+    auto t_exit = max_distance;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::isinf(inverse_direction[axis])) {
+            // Parallel to the slab, where the distances below could be 0 * infinity = NaN.
+            if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis]) {
+                return std::numeric_limits<float>::infinity();
+            }
+            continue;
+        }
+        auto t_0 = (box.min[axis] - origin[axis]) * inverse_direction[axis];
+        auto t_1 = (box.max[axis] - origin[axis]) * inverse_direction[axis];
+        t_enter = std::max(t_enter, std::min(t_0, t_1));
+        t_exit = std::min(t_exit, std::max(t_0, t_1));
+    }
+    return t_enter <= t_exit ? t_enter : std::numeric_limits<float>::infinity();
+}
+
+uint32_t DynamicBvh::allocate_node() {
+    if (this->free_list == NULL_NODE) {
+        this->nodes.emplace_back();
+        return (uint32_t)(this->nodes.size() - 1);
+    }
+    auto node = this->free_list;
+    this->free_list = this->nodes[node].parent;
+    // Until the caller sets the children.
+    this->nodes[node].child_1 = NULL_NODE;
+    return node;
+}
+
+void DynamicBvh::free_node(uint32_t node) {
+    assert(!this->nodes[node].is_free());
+    this->nodes[node].parent = this->free_list;
+    this->nodes[node].child_0 = NULL_NODE;
+    this->nodes[node].child_1 = FREE_NODE;
+    this->free_list = node;
+}
+
+void DynamicBvh::refit(uint32_t node) {
+    while (node != NULL_NODE) {
+        auto& n = this->nodes[node];
+        auto old_area = n.box.surface_area();
+        n.box = this->nodes[n.child_0].box.merged(this->nodes[n.child_1].box);
+        this->internal_area += n.box.surface_area() - old_area;
+        node = n.parent;
+    }
+}
+
+void DynamicBvh::insert_leaf(uint32_t leaf) {
+    if (this->root == NULL_NODE) {
+        this->root = leaf;
+        this->nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Descend towards the sibling with the least increase of surface area, stopping when making a
+    // new parent here is cheaper than going further down.
+    auto leaf_box = this->nodes[leaf].box;
+    auto sibling = this->root;
+    while (!this->nodes[sibling].is_leaf()) {
+        const auto& node = this->nodes[sibling];
+        auto area = node.box.surface_area();
+        auto combined_area = node.box.merged(leaf_box).surface_area();
+        auto cost = 2.0f * combined_area;
+        // Cost of pushing the leaf further down, which grows all of the ancestors.
+        auto inheritance_cost = 2.0f * (combined_area - area);
+        auto child_cost = [&](uint32_t child) {
+            const auto& child_box = this->nodes[child].box;
+            auto merged_area = child_box.merged(leaf_box).surface_area();
+            if (this->nodes[child].is_leaf()) {
+                return merged_area + inheritance_cost;
+            } else {
+                return merged_area - child_box.surface_area() + inheritance_cost;
+            }
+        };
+        auto cost_0 = child_cost(node.child_0);
+        auto cost_1 = child_cost(node.child_1);
+        if (cost < cost_0 && cost < cost_1) {
+            break;
+        }
+        sibling = cost_0 < cost_1 ? node.child_0 : node.child_1;
+    }
+
+    auto old_parent = this->nodes[sibling].parent;
+    auto new_parent = this->allocate_node();
+    auto& parent = this->nodes[new_parent];
+    parent.box = this->nodes[sibling].box.merged(leaf_box);
+    parent.parent = old_parent;
+    parent.child_0 = sibling;
+    parent.child_1 = leaf;
+    parent.user_data = 0;
+    this->internal_area += parent.box.surface_area();
+
+    if (old_parent != NULL_NODE) {
+        auto& grandparent = this->nodes[old_parent];
+        if (grandparent.child_0 == sibling) {
+            grandparent.child_0 = new_parent;
+        } else {
+            grandparent.child_1 = new_parent;
+        }
+    } else {
+        this->root = new_parent;
+    }
+    this->nodes[sibling].parent = new_parent;
+    this->nodes[leaf].parent = new_parent;
+    this->refit(old_parent);
+}
+
+void DynamicBvh::remove_leaf(uint32_t leaf) {
+    if (leaf == this->root) {
+        this->root = NULL_NODE;
+        return;
+    }
+    auto parent = this->nodes[leaf].parent;
+    auto grandparent = this->nodes[parent].parent;
+    auto sibling = this->nodes[parent].child_0 == leaf ? this->nodes[parent].child_1
+                                                       : this->nodes[parent].child_0;
+    this->internal_area -= this->nodes[parent].box.surface_area();
+    if (grandparent != NULL_NODE) {
+        auto& g = this->nodes[grandparent];
+        if (g.child_0 == parent) {
+            g.child_0 = sibling;
+        } else {
+            g.child_1 = sibling;
+        }
+        this->nodes[sibling].parent = grandparent;
+        this->free_node(parent);
+        this->refit(grandparent);
+    } else {
+        this->root = sibling;
+        this->nodes[sibling].parent = NULL_NODE;
+        this->free_node(parent);
+    }
+}
+
+uint32_t DynamicBvh::insert(const BoundingBox& box, uint32_t user_data) {
+    auto leaf = this->allocate_node();
+    this->nodes[leaf] = Node {
+        .box = fatten(box),
+        .tight_box = box,
+        .parent = NULL_NODE,
+        .child_0 = NULL_NODE,
+        .child_1 = NULL_NODE,
+        .user_data = user_data,
+    };
+    this->insert_leaf(leaf);
+    ++this->leaf_count_;
+    return leaf;
+}
+
+void DynamicBvh::remove(uint32_t proxy) {
+    assert(proxy < this->nodes.size() && !this->nodes[proxy].is_free());
+    assert(this->nodes[proxy].is_leaf());
+    this->remove_leaf(proxy);
+    this->free_node(proxy);
+    --this->leaf_count_;
+}
+
+bool DynamicBvh::update(uint32_t proxy, const BoundingBox& box) {
+    assert(proxy < this->nodes.size() && !this->nodes[proxy].is_free());
+    assert(this->nodes[proxy].is_leaf());
+    auto& leaf = this->nodes[proxy];
+    leaf.tight_box = box;
+    if (leaf.box.contains(box)) {
+        return false;
+    }
+    this->remove_leaf(proxy);
+    this->nodes[proxy].box = fatten(box);
+    this->insert_leaf(proxy);
+    return true;
+}
+
+bool DynamicBvh::rebuild_if_degraded() {
+    if (this->leaf_count_ < 3 ||
+        this->internal_area <= REBUILD_FACTOR * this->internal_area_after_rebuild) {
+        return false;
+    }
+    this->rebuild();
+    return true;
+}
+
+void DynamicBvh::rebuild() {
+    this->leaves.clear();
+    if (this->root != NULL_NODE) {
+        this->stack.clear();
+        this->stack.push_back(this->root);
+        while (!this->stack.empty()) {
+            auto node = this->stack.back();
+            this->stack.pop_back();
+            if (this->nodes[node].is_leaf()) {
+                this->leaves.push_back(node);
+            } else {
+                this->stack.push_back(this->nodes[node].child_0);
+                this->stack.push_back(this->nodes[node].child_1);
+                this->free_node(node);
+            }
+        }
+    }
+    this->internal_area = 0;
+    this->root = this->leaves.empty() ? NULL_NODE : this->build_top_down(this->leaves, NULL_NODE);
+    this->internal_area_after_rebuild = this->internal_area;
+}
+
+uint32_t DynamicBvh::build_top_down(std::span<uint32_t> leaves, uint32_t parent) {
+    if (leaves.size() == 1) {
+        this->nodes[leaves[0]].parent = parent;
+        return leaves[0];
+    }
+
+    // Split at the median centroid along the axis where centroids spread the most.
+    auto centroid = [&](uint32_t leaf) {
+        const auto& box = this->nodes[leaf].box;
+        return (box.min + box.max) * 0.5f;
+    };
+    auto centroid_min = centroid(leaves[0]);
+    auto centroid_max = centroid_min;
+    for (auto leaf : leaves) {
+        centroid_min = glm::min(centroid_min, centroid(leaf));
+        centroid_max = glm::max(centroid_max, centroid(leaf));
+    }
+    auto spread = centroid_max - centroid_min;
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    auto middle = leaves.size() / 2;
+    std::nth_element(
+        leaves.begin(),
+        leaves.begin() + (ptrdiff_t)middle,
+        leaves.end(),
+        [&](uint32_t a, uint32_t b) { return centroid(a)[axis] < centroid(b)[axis]; }
+    );
+
+    auto node = this->allocate_node();
+    auto child_0 = this->build_top_down(leaves.first(middle), node);
+    auto child_1 = this->build_top_down(leaves.subspan(middle), node);
+    auto& n = this->nodes[node];
+    n.box = this->nodes[child_0].box.merged(this->nodes[child_1].box);
+    n.parent = parent;
+    n.child_0 = child_0;
+    n.child_1 = child_1;
+    n.user_data = 0;
+    this->internal_area += n.box.surface_area();
+    return node;
+}
+
+void DynamicBvh::push_leaves_of(uint32_t node, std::vector<uint32_t>& results) const {
+    this->subtree_stack.clear();
+    this->subtree_stack.push_back(node);
+    while (!this->subtree_stack.empty()) {
+        const auto& n = this->nodes[this->subtree_stack.back()];
+        this->subtree_stack.pop_back();
+        if (n.is_leaf()) {
+            results.push_back(n.user_data);
+        } else {
+            this->subtree_stack.push_back(n.child_0);
+            this->subtree_stack.push_back(n.child_1);
+        }
+    }
+}
+
+void DynamicBvh::query_frustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+    if (this->root == NULL_NODE) {
+        return;
+    }
+    this->stack.clear();
+    this->stack.push_back(this->root);
+    while (!this->stack.empty()) {
+        auto node = this->stack.back();
+        this->stack.pop_back();
+        const auto& n = this->nodes[node];
+        switch (frustum.test(n.box)) {
+        case FrustumTest::Outside: break;
+        case FrustumTest::Inside: this->push_leaves_of(node, results); break;
+        case FrustumTest::Intersecting:
+            if (!n.is_leaf()) {
+                this->stack.push_back(n.child_0);
+                this->stack.push_back(n.child_1);
+            } else if (frustum.test(n.tight_box) != FrustumTest::Outside) {
+                results.push_back(n.user_data);
+            }
+            break;
+        }
+    }
+}
+
+void DynamicBvh::query_aabb(const BoundingBox& box, std::vector<uint32_t>& results) const {
+    if (this->root == NULL_NODE) {
+        return;
+    }
+    this->stack.clear();
+    this->stack.push_back(this->root);
+    while (!this->stack.empty()) {
+        const auto& n = this->nodes[this->stack.back()];
+        this->stack.pop_back();
+        if (!n.box.intersects(box)) {
+            continue;
+        }
+        if (!n.is_leaf()) {
+            this->stack.push_back(n.child_0);
+            this->stack.push_back(n.child_1);
+        } else if (n.tight_box.intersects(box)) {
+            results.push_back(n.user_data);
+        }
+    }
+}
+
+std::optional<BvhRaycastHit> DynamicBvh::raycast(
+    glm::vec3 origin,
+    glm::vec3 direction,
+    float max_distance
+) const {
+    auto inverse_direction = inverse_ray_direction(direction);
+    if (this->root == NULL_NODE || !inverse_direction.has_value()) {
+        return std::nullopt;
+    }
+    auto closest = std::optional<BvhRaycastHit>();
+    // Nudged so that hits at exactly `max_distance` still pass the strict comparisons below.
+    auto closest_distance = std::nextafter(max_distance, std::numeric_limits<float>::infinity());
+    this->stack.clear();
+    this->stack.push_back(this->root);
+    while (!this->stack.empty()) {
+        const auto& n = this->nodes[this->stack.back()];
+        this->stack.pop_back();
+        // Misses are at infinity, so they are skipped as well.
+        if (ray_box_distance(n.box, origin, *inverse_direction, closest_distance) >=
+            closest_distance) {
+            continue;
+        }
+        if (!n.is_leaf()) {
+            this->stack.push_back(n.child_0);
+            this->stack.push_back(n.child_1);
+            continue;
+        }
+        auto distance =
+            ray_box_distance(n.tight_box, origin, *inverse_direction, closest_distance);
+        if (distance < closest_distance) {
+            closest_distance = distance;
+            closest = BvhRaycastHit {
+                .user_data = n.user_data,
+                .distance = distance,
+            };
+        }
+    }
+    return closest;
+}
+
+size_t DynamicBvh::leaf_count() const {
+    return this->leaf_count_;
+}
+
+size_t DynamicBvh::height() const {
+    if (this->root == NULL_NODE) {
+        return 0;
+    }
+    // (node, depth) pairs.
+    auto pending = std::vector<std::pair<uint32_t, size_t>> {{this->root, 1}};
+    size_t height = 0;
+    while (!pending.empty()) {
+        auto [node, depth] = pending.back();
+        pending.pop_back();
+        height = std::max(height, depth);
+        const auto& n = this->nodes[node];
+        if (!n.is_leaf()) {
+            pending.push_back({n.child_0, depth + 1});
+            pending.push_back({n.child_1, depth + 1});
+        }
+    }
+    return height;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "culling.hxx"
+
+struct BvhRaycastHit {
+    uint32_t user_data;
+    /// Distance along the ray direction to the entry point into the leaf's box.
+    float distance;
+};
+
+/// Inverse of a ray direction, as taken by `ray_box_distance`, or none if the ray cannot hit
+/// anything, i.e. if the direction is zero or has NaN components. Zero components become infinities
+/// that mark the ray as parallel to the slabs of their axis.
+std::optional<glm::vec3> inverse_ray_direction(glm::vec3 direction);
+
+/// Distance along the ray to where it enters `box` (0 if it starts inside), or infinity if the ray
+/// misses it or only reaches it beyond `max_distance`.
+float ray_box_distance(
+    const BoundingBox& box,
+    glm::vec3 origin,
+    glm::vec3 inverse_direction,
+    float max_distance = std::numeric_limits<float>::infinity()
+);
+
+/// Dynamic bounding volume hierarchy over axis-aligned boxes.
+///
+/// Leaves store a box enlarged by a margin ("fat" box), so that small movements only need a
+/// containment check. A leaf that moves out of its fat box is removed and re-inserted, refitting
+/// its ancestors. Incremental insertion degrades the tree over time, so it is rebuilt top-down once
+/// its total surface area grows too far beyond that of the last rebuild.
+///
+/// Queries test leaves against their exact boxes, not the fat ones.
+class DynamicBvh {
+  public:
+    static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+  private:
+    /// `child_1` of nodes in the free list, to catch proxies used after being removed.
+    static constexpr uint32_t FREE_NODE = UINT32_MAX - 1;
+
+    struct Node {
+        /// Fat box for leaves.
+        BoundingBox box;
+        /// Exact box, only for leaves.
+        BoundingBox tight_box;
+        /// Next free node for nodes in the free list.
+        uint32_t parent;
+        uint32_t child_0;
+        uint32_t child_1;
+        uint32_t user_data;
+
+        bool is_leaf() const {
+            return this->child_0 == NULL_NODE;
+        }
+
+        bool is_free() const {
+            return this->child_1 == FREE_NODE;
+        }
+    };
+
+    std::vector<Node> nodes = {};
+    uint32_t root = NULL_NODE;
+    uint32_t free_list = NULL_NODE;
+    size_t leaf_count_ = 0;
+
+    /// Sum of surface areas of internal nodes, the cost of the tree in the surface area heuristic.
+    float internal_area = 0;
+    float internal_area_after_rebuild = 0;
+
+    // Scratch space of queries and rebuilds.
+    mutable std::vector<uint32_t> stack = {};
+    mutable std::vector<uint32_t> subtree_stack = {};
+    std::vector<uint32_t> leaves = {};
+
+    uint32_t allocate_node();
+    void free_node(uint32_t node);
+    void insert_leaf(uint32_t leaf);
+    void remove_leaf(uint32_t leaf);
+    /// Recomputes boxes of `node` and its ancestors.
+    void refit(uint32_t node);
+    uint32_t build_top_down(std::span<uint32_t> leaves, uint32_t parent);
+    void push_leaves_of(uint32_t node, std::vector<uint32_t>& results) const;
+
+  public:
+    DynamicBvh() = default;
+
+    /// Returns the proxy of the box, stable until it is removed.
+    uint32_t insert(const BoundingBox& box, uint32_t user_data);
+
+    /// Removing a proxy twice is caught by an assertion, unless its node was reused by an insertion
+    /// in between.
+    void remove(uint32_t proxy);
+
+    /// Returns whether the tree changed, i.e. the box moved out of its fat box.
+    bool update(uint32_t proxy, const BoundingBox& box);
+
+    /// Rebuilds the tree if its quality degraded too much since the last rebuild.
+    /// Returns whether it rebuilt.
+    bool rebuild_if_degraded();
+
+    /// Rebuilds the tree top-down by splitting at the median along the longest axis.
+    void rebuild();
+
+    /// Appends user data of all leaves intersecting the frustum to `results`.
+    /// Subtrees entirely inside the frustum are accepted without testing their leaves.
+    void query_frustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+
+    /// Appends user data of all leaves intersecting `box` to `results`.
+    void query_aabb(const BoundingBox& box, std::vector<uint32_t>& results) const;
+
+    /// The closest leaf hit by the ray, `direction` does not need to be normalized.
+    std::optional<BvhRaycastHit> raycast(
+        glm::vec3 origin,
+        glm::vec3 direction,
+        float max_distance = std::numeric_limits<float>::infinity()
+    ) const;
+
+    size_t leaf_count() const;
+
+    /// Height of the tree, for diagnostics. O(n).
+    size_t height() const;
+};
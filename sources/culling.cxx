@@ -0,0 +1,204 @@
+#include "culling.hxx"
+
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+
+#if defined(__x86_64__) && !defined(__EMSCRIPTEN__)
+#include <immintrin.h>
+#endif
+
+BoundingBox BoundingBox::transformed(const glm::mat4x4& matrix) const {
+    auto center = (this->min + this->max) * 0.5f;
+    auto extent = (this->max - this->min) * 0.5f;
+    auto new_center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+    // Half-extents along each world axis are the sums of the absolute projections of the box's
+    // transformed axes.
+    auto new_extent = glm::abs(glm::vec3(matrix[0])) * extent.x +
+                      glm::abs(glm::vec3(matrix[1])) * extent.y +
+                      glm::abs(glm::vec3(matrix[2])) * extent.z;
+    return BoundingBox {
+        .min = new_center - new_extent,
+        .max = new_center + new_extent,
+    };
+}
+
+BoundingBox BoundingBox::merged(const BoundingBox& other) const {
+    return BoundingBox {
+        .min = glm::min(this->min, other.min),
+        .max = glm::max(this->max, other.max),
+    };
+}
+
+bool BoundingBox::contains(const BoundingBox& other) const {
+    return glm::all(glm::lessThanEqual(this->min, other.min)) &&
+           glm::all(glm::greaterThanEqual(this->max, other.max));
+}
+
+bool BoundingBox::intersects(const BoundingBox& other) const {
+    return glm::all(glm::lessThanEqual(this->min, other.max)) &&
+           glm::all(glm::greaterThanEqual(this->max, other.min));
+}
+
+float BoundingBox::surface_area() const {
+    auto size = this->max - this->min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+Frustum Frustum::from_view_projection(const glm::mat4x4& m) {
+    // Gribb-Hartmann plane extraction. glm matrices are column-major, `row(i)` is the i-th row.
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    // Planes are not normalized, as only the sign of the distances is used.
+    return Frustum {
+        .planes = {
+            row(3) + row(0), // left
+            row(3) - row(0), // right
+            row(3) + row(1), // bottom
+            row(3) - row(1), // top
+            row(3) + row(2), // near
+            row(3) - row(2), // far
+        },
+    };
+}
+
+FrustumTest Frustum::test(const BoundingBox& box) const {
+    auto center = (box.min + box.max) * 0.5f;
+    auto extent = (box.max - box.min) * 0.5f;
+    auto result = FrustumTest::Inside;
+    for (const auto& plane : this->planes) {
+        auto normal = glm::vec3(plane);
+        auto distance = glm::dot(normal, center) + plane.w;
+        auto radius = glm::dot(glm::abs(normal), extent);
+        if (distance + radius < 0.0f) {
+            return FrustumTest::Outside;
+        }
+        if (distance - radius < 0.0f) {
+            result = FrustumTest::Intersecting;
+        }
+    }
+    return result;
+}
+
+void FrustumCuller::clear() {
+    this->center_x.clear();
+    this->center_y.clear();
+    this->center_z.clear();
+    this->extent_x.clear();
+    this->extent_y.clear();
+    this->extent_z.clear();
+    this->visible.clear();
+}
+
+uint32_t FrustumCuller::push(const BoundingBox& box) {
+    auto center = (box.min + box.max) * 0.5f;
+    auto extent = (box.max - box.min) * 0.5f;
+    auto index = (uint32_t)this->center_x.size();
+    this->center_x.push_back(center.x);
+    this->center_y.push_back(center.y);
+    this->center_z.push_back(center.z);
+    this->extent_x.push_back(extent.x);
+    this->extent_y.push_back(extent.y);
+    this->extent_z.push_back(extent.z);
+    return index;
+}
+
+#if defined(__x86_64__) && !defined(__EMSCRIPTEN__)
+#define HAS_AVX2_KERNEL 1
+
+/// Compiled for AVX2 and FMA alone, so that the rest of the app runs on any x86-64 CPU. Only called
+/// if the CPU supports them. Returns the number of boxes tested, a multiple of 8.
+__attribute__((target("avx2,fma"))) static size_t cull_avx2(
+    const Frustum& frustum,
+    const float* centers_x,
+    const float* centers_y,
+    const float* centers_z,
+    const float* extents_x,
+    const float* extents_y,
+    const float* extents_z,
+    uint8_t* visible,
+    size_t n
+) {
+    __m256 plane_x[6];
+    __m256 plane_y[6];
+    __m256 plane_z[6];
+    __m256 plane_w[6];
+    __m256 plane_abs_x[6];
+    __m256 plane_abs_y[6];
+    __m256 plane_abs_z[6];
+    for (size_t p = 0; p < 6; ++p) {
+        const auto& plane = frustum.planes[p];
+        plane_x[p] = _mm256_set1_ps(plane.x);
+        plane_y[p] = _mm256_set1_ps(plane.y);
+        plane_z[p] = _mm256_set1_ps(plane.z);
+        plane_w[p] = _mm256_set1_ps(plane.w);
+        plane_abs_x[p] = _mm256_set1_ps(std::abs(plane.x));
+        plane_abs_y[p] = _mm256_set1_ps(std::abs(plane.y));
+        plane_abs_z[p] = _mm256_set1_ps(std::abs(plane.z));
+    }
+    auto zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto center_x = _mm256_loadu_ps(&centers_x[i]);
+        auto center_y = _mm256_loadu_ps(&centers_y[i]);
+        auto center_z = _mm256_loadu_ps(&centers_z[i]);
+        auto extent_x = _mm256_loadu_ps(&extents_x[i]);
+        auto extent_y = _mm256_loadu_ps(&extents_y[i]);
+        auto extent_z = _mm256_loadu_ps(&extents_z[i]);
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        // Same test as `Frustum::test`, 8 boxes at a time.
+        for (size_t p = 0; p < 6; ++p) {
+            auto distance = _mm256_fmadd_ps(plane_z[p], center_z, plane_w[p]);
+            distance = _mm256_fmadd_ps(plane_y[p], center_y, distance);
+            distance = _mm256_fmadd_ps(plane_x[p], center_x, distance);
+            auto radius = _mm256_mul_ps(plane_abs_z[p], extent_z);
+            radius = _mm256_fmadd_ps(plane_abs_y[p], extent_y, radius);
+            radius = _mm256_fmadd_ps(plane_abs_x[p], extent_x, radius);
+            auto in_front = _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ);
+            inside = _mm256_and_ps(inside, in_front);
+        }
+        auto mask = (uint32_t)_mm256_movemask_ps(inside);
+        for (size_t j = 0; j < 8; ++j) {
+            visible[i + j] = (uint8_t)((mask >> j) & 1);
+        }
+    }
+    return i;
+}
+#endif
+
+void FrustumCuller::cull(const Frustum& frustum) {
+    auto n = this->center_x.size();
+    this->visible.resize(n);
+    size_t i = 0;
+
+#if defined(HAS_AVX2_KERNEL)
+    static const auto has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (has_avx2) {
+        i = cull_avx2(
+            frustum,
+            this->center_x.data(),
+            this->center_y.data(),
+            this->center_z.data(),
+            this->extent_x.data(),
+            this->extent_y.data(),
+            this->extent_z.data(),
+            this->visible.data(),
+            n
+        );
+    }
+#endif
+
+    for (; i < n; ++i) {
+        auto center = glm::vec3(this->center_x[i], this->center_y[i], this->center_z[i]);
+        auto extent = glm::vec3(this->extent_x[i], this->extent_y[i], this->extent_z[i]);
+        auto box = BoundingBox {
+            .min = center - extent,
+            .max = center + extent,
+        };
+        this->visible[i] = (uint8_t)(frustum.test(box) != FrustumTest::Outside);
+    }
+}
+
+std::span<const uint8_t> FrustumCuller::get_visibility() const {
+    return this->visible;
+}
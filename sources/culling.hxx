@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/// Axis-aligned bounding box.
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    /// Axis-aligned box enclosing this box transformed by `matrix`.
+    BoundingBox transformed(const glm::mat4x4& matrix) const;
+
+    BoundingBox merged(const BoundingBox& other) const;
+
+    bool contains(const BoundingBox& other) const;
+
+    bool intersects(const BoundingBox& other) const;
+
+    float surface_area() const;
+};
+
+enum class FrustumTest {
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+/// Six planes of a view frustum, in world space.
+struct Frustum {
+    /// `xyz` is the normal pointing inwards and `w` is the distance, i.e. a point `p` is inside a
+    /// plane if `dot(plane.xyz, p) + plane.w >= 0`.
+    std::array<glm::vec4, 6> planes;
+
+    /// The near plane is taken at clip depth -1 (the convention of the cameras, see
+    /// `PerspectiveCamera`), which is conservative for projections with depth from 0 to 1.
+    static Frustum from_view_projection(const glm::mat4x4& view_projection);
+
+    FrustumTest test(const BoundingBox& box) const;
+};
+
+struct CullingStats {
+    size_t tested_count = 0;
+    size_t culled_count = 0;
+    double seconds = 0;
+};
+
+/// World-space bounding boxes in SoA layout, tested against a frustum 8 at a time with AVX2 on CPUs
+/// supporting it, detected at runtime (with a scalar fallback on other CPUs and targets).
+class FrustumCuller {
+    // Boxes are stored as center and half-extents.
+    std::vector<float> center_x = {};
+    std::vector<float> center_y = {};
+    std::vector<float> center_z = {};
+    std::vector<float> extent_x = {};
+    std::vector<float> extent_y = {};
+    std::vector<float> extent_z = {};
+
+    std::vector<uint8_t> visible = {};
+
+  public:
+    void clear();
+
+    /// Returns the index of the box.
+    uint32_t push(const BoundingBox& box);
+
+    void cull(const Frustum& frustum);
+
+    /// 1 for boxes intersecting the frustum and 0 for the others, in the order pushed.
+    /// Only valid after `cull`.
+    std::span<const uint8_t> get_visibility() const;
+};
@@ -2,117 +2,250 @@
 
 Entity::Entity(nullptr_t) {}
 
-bool Entity::operator==(nullptr_t) {
-    return this->pipeline == nullptr;
+bool Entity::operator==(nullptr_t) const {
+    return this->geometry == nullptr;
 }
 
 Entity::Entity(
     const wgpu::Device& device,
-    const wgpu::Queue& queue,
-    wgpu::TextureFormat surface_color_format,
-    wgpu::TextureFormat surface_depth_stencil_format,
-    wgpu::BindGroupLayout camera_bind_group_layout,
+    PipelineCache& pipeline_cache,
+    const InstanceBuffer& instances,
     std::shared_ptr<GeometryBase> geometry,
-    std::shared_ptr<MaterialBase> material
+    std::shared_ptr<MaterialBase> material,
+    const std::shared_ptr<MaterialBase>& fallback_material
 )
-    : geometry(geometry)
-    , material(material) {
-    (void)queue;
-    // Bind group layouts.
-    auto geometry_bind_group_layout = geometry->create_bind_group_layout(device);
-    auto material_bind_group_layout = material->create_bind_group_layout(device);
-    auto bind_group_layouts = std::array {
-        camera_bind_group_layout,
-        geometry_bind_group_layout,
-        material_bind_group_layout,
-    };
-
-    // Pipeline Layout.
-    auto pipeline_layout_descriptor = wgpu::PipelineLayoutDescriptor {
-        .bindGroupLayoutCount = bind_group_layouts.size(),
-        .bindGroupLayouts = bind_group_layouts.data(),
-    };
-    auto pipeline_layout = device.CreatePipelineLayout(&pipeline_layout_descriptor);
-
-    // Pipeline.
-    auto vertex_shader = geometry->create_vertex_shader(device);
-    auto vertex_buffer_layouts = geometry->vertex_buffer_layouts();
-    auto vertex_state = wgpu::VertexState {
-        .module = vertex_shader.shader_module,
-        .entryPoint = wgpu::StringView(vertex_shader.entry_point),
-        .constantCount = vertex_shader.constants.size(),
-        .constants = vertex_shader.constants.data(),
-        .bufferCount = vertex_buffer_layouts.size(),
-        .buffers = vertex_buffer_layouts.data(),
-    };
-    auto color_target_state = wgpu::ColorTargetState {
-        .format = surface_color_format,
-        .blend = nullptr,
-        .writeMask = wgpu::ColorWriteMask::All,
-    };
-    auto depth_stencil_state = wgpu::DepthStencilState {
-        .format = surface_depth_stencil_format,
-        .depthWriteEnabled = true,
-        .depthCompare = wgpu::CompareFunction::Less,
-    };
-    auto fragment_shader = material->create_fragment_shader(device);
-    auto fragment_state = wgpu::FragmentState {
-        .module = fragment_shader.shader_module,
-        .entryPoint = wgpu::StringView(fragment_shader.entry_point),
-        .constantCount = fragment_shader.constants.size(),
-        .constants = fragment_shader.constants.data(),
-        .targetCount = 1,
-        .targets = &color_target_state,
-    };
-    auto pipeline_descriptor = wgpu::RenderPipelineDescriptor {
-        .layout = pipeline_layout,
-        .vertex = vertex_state,
-        .primitive = geometry->primitive_state(),
-        .depthStencil = &depth_stencil_state,
-        .fragment = &fragment_state,
-    };
-
-    this->pipeline = device.CreateRenderPipeline(&pipeline_descriptor);
-    this->geometry_bind_group = geometry->create_bind_group(device, geometry_bind_group_layout);
-    this->material_bind_group = material->create_bind_group(device, material_bind_group_layout);
-}
-
-void Entity::set_model(glm::mat4x4 model_matrix) {
-    this->model_matrix = model_matrix;
-}
-
-void Entity::prepare_for_drawing(const wgpu::Queue& queue, glm::vec3 view_position, glm::mat4x4 view_matrix) {
-    this->material->update_view_position(queue, view_position);
-    this->geometry->set_model_view(queue, this->model_matrix, view_matrix);
-}
-
-void Entity::draw_commands(wgpu::RenderPassEncoder& render_pass) {
-    render_pass.SetPipeline(this->pipeline);
-    render_pass.SetBindGroup(1, this->geometry_bind_group);
-    render_pass.SetBindGroup(2, this->material_bind_group);
+    : geometry(std::move(geometry)) {
+    this->use_material(device, pipeline_cache, std::move(material), fallback_material);
+    // Geometry bind group layouts only depend on the geometry, with or without fallback.
+    this->geometry_bind_group = this->geometry->create_bind_group(
+        device,
+        this->pipeline.geometry_bind_group_layout,
+        instances.get_buffer()
+    );
+    this->geometry_bind_group_generation = instances.get_generation();
+}
+
+void Entity::set_material(
+    const wgpu::Device& device,
+    PipelineCache& pipeline_cache,
+    std::shared_ptr<MaterialBase> material,
+    const std::shared_ptr<MaterialBase>& fallback_material
+) {
+    this->use_material(device, pipeline_cache, std::move(material), fallback_material);
+}
+
+bool Entity::update_pending_pipeline(const wgpu::Device& device, PipelineCache& pipeline_cache) {
+    if (this->pending_material == nullptr) {
+        return false;
+    }
+    // By ID rather than with `get_or_create`, so that waiting does not count as cache hits.
+    auto pending_pipeline = pipeline_cache.get(this->pending_pipeline_id);
+    if (pending_pipeline.pipeline == nullptr) {
+        return false;
+    }
+    this->pipeline = std::move(pending_pipeline);
+    this->material = std::move(this->pending_material);
+    this->pending_material = nullptr;
+    this->create_material_bind_group(device);
+    return true;
+}
+
+void Entity::use_material(
+    const wgpu::Device& device,
+    PipelineCache& pipeline_cache,
+    std::shared_ptr<MaterialBase> material,
+    const std::shared_ptr<MaterialBase>& fallback_material
+) {
+    this->pipeline = pipeline_cache.get_or_create(*this->geometry, *material, true);
+    this->material = std::move(material);
+    this->pending_material = nullptr;
+    if (this->pipeline.pipeline == nullptr) {
+        this->pending_material = this->material;
+        this->pending_pipeline_id = this->pipeline.id;
+        // Fallback pipelines are compiled synchronously, once per geometry type.
+        if (fallback_material != nullptr) {
+            this->pipeline = pipeline_cache.get_or_create(*this->geometry, *fallback_material);
+            this->material = fallback_material;
+        }
+    }
+    this->create_material_bind_group(device);
+}
+
+void Entity::create_material_bind_group(const wgpu::Device& device) {
+    this->material_bind_group =
+        this->material->create_bind_group(device, this->pipeline.material_bind_group_layout);
+}
+
+const std::shared_ptr<GeometryBase>& Entity::get_geometry() const {
+    return this->geometry;
+}
+
+const std::shared_ptr<MaterialBase>& Entity::get_material() const {
+    return this->material;
+}
+
+uint32_t Entity::get_pipeline_id() const {
+    return this->pipeline.id;
+}
+
+void Entity::set_static(bool is_static) {
+    this->is_static_ = is_static;
+}
+
+bool Entity::is_static() const {
+    return this->is_static_;
+}
+
+void Entity::set_hidden(bool is_hidden) {
+    this->is_hidden_ = is_hidden;
+}
+
+bool Entity::is_hidden() const {
+    return this->is_hidden_;
+}
+
+bool Entity::is_pipeline_pending() const {
+    return this->pending_material != nullptr;
+}
+
+bool Entity::is_drawn() const {
+    return !this->is_hidden_ && this->pipeline.pipeline != nullptr;
+}
+
+std::optional<BoundingBox> Entity::world_bounds(const glm::mat4x4& model_matrix) const {
+    auto bounds = this->geometry->local_bounds();
+    if (!bounds.has_value()) {
+        return std::nullopt;
+    }
+    return bounds->transformed(model_matrix);
+}
+
+uint64_t Entity::sort_key(
+    const glm::mat4x4& view_matrix,
+    const glm::mat4x4& model_matrix
+) const {
+    // View space looks towards -Z.
+    auto view_depth = -(view_matrix * model_matrix[3]).z;
+    return RenderQueue::make_key(
+        this->pipeline.id,
+        this->material.get(),
+        this->geometry.get(),
+        view_depth
+    );
+}
+
+void Entity::prepare_for_drawing(InstanceBuffer& instances) {
+    this->instance_index = instances.reserve();
+}
+
+bool Entity::can_draw_instanced_with(const Entity& other) const {
+    return this->pipeline.pipeline.Get() == other.pipeline.pipeline.Get() &&
+           this->geometry == other.geometry && this->material == other.material &&
+           this->instance_index + 1 == other.instance_index;
+}
+
+template <RenderCommandEncoder E>
+void Entity::set_pipeline_and_material(E& encoder, RenderPassState& render_pass_state) {
+    render_pass_state.set_pipeline(encoder, this->pipeline.pipeline);
+    render_pass_state.set_bind_group(encoder, 2, this->material_bind_group);
+}
+
+template <RenderCommandEncoder E>
+void Entity::draw_commands(
+    const wgpu::Device& device,
+    const InstanceBuffer& instances,
+    E& render_pass,
+    RenderPassState& render_pass_state,
+    uint32_t instance_count
+) {
+    if (this->geometry_bind_group_generation != instances.get_generation()) {
+        this->geometry_bind_group = this->geometry->create_bind_group(
+            device,
+            this->pipeline.geometry_bind_group_layout,
+            instances.get_buffer()
+        );
+        this->geometry_bind_group_generation = instances.get_generation();
+    }
+    this->set_pipeline_and_material(render_pass, render_pass_state);
+    render_pass_state.set_bind_group(render_pass, 1, this->geometry_bind_group);
     auto draw_parameters = geometry->draw_parameters();
     if (const auto* parameters = std::get_if<DrawParametersIndexless>(&draw_parameters)) {
         if (parameters->vertex_buffer != nullptr) {
-            render_pass.SetVertexBuffer(0, parameters->vertex_buffer);
+            render_pass_state.set_vertex_buffer(render_pass, parameters->vertex_buffer);
         }
+        assert(parameters->instance_count == 1 && parameters->first_instance == 0);
         render_pass.Draw(
             parameters->vertex_count,
-            parameters->instance_count,
+            instance_count,
             parameters->first_vertex,
-            parameters->first_instance
+            this->instance_index
         );
     } else if (const auto* parameters = std::get_if<DrawParametersIndexed>(&draw_parameters)) {
         assert(parameters->index_buffer != nullptr);
-        render_pass.SetIndexBuffer(parameters->index_buffer, parameters->index_format);
+        render_pass_state
+            .set_index_buffer(render_pass, parameters->index_buffer, parameters->index_format);
         if (parameters->vertex_buffer != nullptr) {
-            render_pass.SetVertexBuffer(0, parameters->vertex_buffer);
+            render_pass_state.set_vertex_buffer(render_pass, parameters->vertex_buffer);
         }
+        assert(parameters->instance_count == 1 && parameters->first_instance == 0);
         render_pass.DrawIndexed(
             parameters->index_count,
-            parameters->instance_count,
+            instance_count,
             parameters->first_index,
             parameters->base_vertex,
-            parameters->first_instance
+            this->instance_index
         );
     }
 }
+
+template void Entity::draw_commands(
+    const wgpu::Device&,
+    const InstanceBuffer&,
+    wgpu::RenderPassEncoder&,
+    RenderPassState&,
+    uint32_t
+);
+
+template void Entity::draw_commands(
+    const wgpu::Device&,
+    const InstanceBuffer&,
+    wgpu::RenderBundleEncoder&,
+    RenderPassState&,
+    uint32_t
+);
+
+void Entity::draw_indirect_commands(
+    const wgpu::Device& device,
+    const GpuCuller& culler,
+    uint32_t group,
+    wgpu::RenderPassEncoder& render_pass,
+    RenderPassState& render_pass_state
+) {
+    if (this->culled_geometry_bind_group == nullptr ||
+        this->culled_geometry_bind_group_generation != culler.get_generation()) {
+        this->culled_geometry_bind_group = this->geometry->create_bind_group(
+            device,
+            this->pipeline.geometry_bind_group_layout,
+            culler.get_visible_instances()
+        );
+        this->culled_geometry_bind_group_generation = culler.get_generation();
+    }
+    this->set_pipeline_and_material(render_pass, render_pass_state);
+    render_pass_state.set_bind_group(render_pass, 1, this->culled_geometry_bind_group);
+    auto draw_parameters = geometry->draw_parameters();
+    auto offset = GpuCuller::draw_arguments_offset(group);
+    if (const auto* parameters = std::get_if<DrawParametersIndexless>(&draw_parameters)) {
+        if (parameters->vertex_buffer != nullptr) {
+            render_pass_state.set_vertex_buffer(render_pass, parameters->vertex_buffer);
+        }
+        render_pass.DrawIndirect(culler.get_draw_arguments(), offset);
+    } else if (const auto* parameters = std::get_if<DrawParametersIndexed>(&draw_parameters)) {
+        assert(parameters->index_buffer != nullptr);
+        render_pass_state
+            .set_index_buffer(render_pass, parameters->index_buffer, parameters->index_format);
+        if (parameters->vertex_buffer != nullptr) {
+            render_pass_state.set_vertex_buffer(render_pass, parameters->vertex_buffer);
+        }
+        render_pass.DrawIndexedIndirect(culler.get_draw_arguments(), offset);
+    }
+}
@@ -2,39 +2,157 @@
 
 #include <glm/ext.hpp>
 
+#include "bvh.hxx"
 #include "geometry/base.hxx"
+#include "gpu_culling.hxx"
+#include "instance_buffer.hxx"
 #include "material/base.hxx"
+#include "pipeline_cache.hxx"
+#include "render_queue.hxx"
 
 class Entity {
     std::shared_ptr<GeometryBase> geometry = nullptr;
+    /// Material drawn, the fallback material while the pipeline of `pending_material` compiles.
     std::shared_ptr<MaterialBase> material = nullptr;
+    /// Material set on the entity while its pipeline compiles, null once it is drawn.
+    std::shared_ptr<MaterialBase> pending_material = nullptr;
+    /// ID of the pipeline of `pending_material` in the scene's `PipelineCache`.
+    uint32_t pending_pipeline_id = 0;
 
-    wgpu::RenderPipeline pipeline = nullptr;
+    /// Of `material`, with a null pipeline while compiling if there is no fallback material.
+    CachedRenderPipeline pipeline = {};
     wgpu::BindGroup geometry_bind_group = nullptr;
     wgpu::BindGroup material_bind_group = nullptr;
 
-    glm::mat4x4 model_matrix = glm::identity<glm::mat4x4>();
+    /// Generation of the instance buffer that the geometry bind group was created against.
+    uint64_t geometry_bind_group_generation = 0;
+
+    /// Geometry bind group over the visible instances of `GpuCuller`, created on first use.
+    wgpu::BindGroup culled_geometry_bind_group = nullptr;
+    uint64_t culled_geometry_bind_group_generation = 0;
+
+    /// Set in `prepare_for_drawing`.
+    uint32_t instance_index = 0;
+
+    /// Static entities are drawn from render bundles recorded once, see `Scene::set_entity_static`.
+    bool is_static_ = false;
+
+    /// Hidden entities are not drawn, see `Scene::set_entity_hidden`.
+    bool is_hidden_ = false;
+
+    /// Slot of this entity in the scene's `SlotMap`, also the index of its transform in the scene's
+    /// `TransformSystem`. Set by `Scene`.
+    uint32_t slot_index = 0;
+    /// Proxy in the scene's `DynamicBvh`, `DynamicBvh::NULL_NODE` if the geometry has no bounds.
+    uint32_t bvh_proxy = DynamicBvh::NULL_NODE;
 
   public:
     Entity() = default;
 
     Entity(nullptr_t);
 
-    bool operator==(nullptr_t);
+    bool operator==(nullptr_t) const;
 
+    /// Compiles the pipeline asynchronously, drawing with `fallback_material` until it is ready,
+    /// or not at all if null, see `update_pending_pipeline`.
     Entity(
         const wgpu::Device& device,
-        const wgpu::Queue& queue,
-        wgpu::TextureFormat surface_color_format,
-        wgpu::TextureFormat surface_depth_stencil_format,
-        wgpu::BindGroupLayout camera_bind_group_layout,
+        PipelineCache& pipeline_cache,
+        const InstanceBuffer& instances,
         std::shared_ptr<GeometryBase> geometry,
-        std::shared_ptr<MaterialBase> material
+        std::shared_ptr<MaterialBase> material,
+        const std::shared_ptr<MaterialBase>& fallback_material
     );
 
-    void set_model(glm::mat4x4 model_matrix);
+    const std::shared_ptr<GeometryBase>& get_geometry() const;
+
+    /// Material drawn, which is the fallback material while the pipeline of the material set on
+    /// the entity compiles.
+    const std::shared_ptr<MaterialBase>& get_material() const;
+
+    uint32_t get_pipeline_id() const;
+
+    bool is_static() const;
+
+    bool is_hidden() const;
+
+    /// Whether the pipeline of the material set on the entity is still compiling.
+    bool is_pipeline_pending() const;
+
+    /// Not hidden, and with a compiled pipeline, of its material or of the fallback material.
+    bool is_drawn() const;
+
+    /// World-space bounds, `std::nullopt` if the geometry has no bounds.
+    std::optional<BoundingBox> world_bounds(const glm::mat4x4& model_matrix) const;
+
+    /// Key of this entity in `RenderQueue`.
+    uint64_t sort_key(const glm::mat4x4& view_matrix, const glm::mat4x4& model_matrix) const;
+
+    /// Reserves this entity's instance in `instances`. The instance transforms are written in a
+    /// batch by `TransformSystem::write_instances`.
+    void prepare_for_drawing(InstanceBuffer& instances);
+
+    /// Whether `other` can be drawn in the same instanced draw call right after this entity.
+    bool can_draw_instanced_with(const Entity& other) const;
+
+    /// Draws `instance_count` instances starting from this entity's instance, i.e. this entity and
+    /// the `instance_count - 1` entities prepared right after it.
+    ///
+    /// Must be called after `instances` is uploaded for this frame.
+    template <RenderCommandEncoder E>
+    void draw_commands(
+        const wgpu::Device& device,
+        const InstanceBuffer& instances,
+        E& encoder,
+        RenderPassState& render_pass_state,
+        uint32_t instance_count = 1
+    );
+
+    /// Draws group `group` of `culler` with one indirect draw call, with the pipeline, material and
+    /// geometry of this entity, which must be in the group.
+    ///
+    /// Must be called after `culler` encoded its culling pass for this frame.
+    void draw_indirect_commands(
+        const wgpu::Device& device,
+        const GpuCuller& culler,
+        uint32_t group,
+        wgpu::RenderPassEncoder& render_pass,
+        RenderPassState& render_pass_state
+    );
+
+  private:
+    // These go through `Scene`, which needs to invalidate its static render bundles.
+    friend class Scene;
+
+    /// Changes the material, which may change the pipeline.
+    void set_material(
+        const wgpu::Device& device,
+        PipelineCache& pipeline_cache,
+        std::shared_ptr<MaterialBase> material,
+        const std::shared_ptr<MaterialBase>& fallback_material
+    );
+
+    /// Switches to the pipeline of the material set on the entity once it is compiled. Returns
+    /// whether the entity changed pipeline.
+    bool update_pending_pipeline(const wgpu::Device& device, PipelineCache& pipeline_cache);
+
+    /// Uses the pipeline of `material` if compiled, of `fallback_material` otherwise, and creates
+    /// the material bind group for it.
+    void use_material(
+        const wgpu::Device& device,
+        PipelineCache& pipeline_cache,
+        std::shared_ptr<MaterialBase> material,
+        const std::shared_ptr<MaterialBase>& fallback_material
+    );
+
+    /// Creates the material bind group of `material` for the layout of `pipeline`.
+    void create_material_bind_group(const wgpu::Device& device);
+
+    void set_static(bool is_static);
 
-    void prepare_for_drawing(const wgpu::Queue& queue, glm::vec3 view_position, glm::mat4x4 view_matrix);
+    void set_hidden(bool is_hidden);
 
-    void draw_commands(wgpu::RenderPassEncoder& render_pass);
+    /// Sets the pipeline and the material bind group, skipping them if already set.
+    template <RenderCommandEncoder E>
+    void set_pipeline_and_material(E& encoder, RenderPassState& render_pass_state);
 };
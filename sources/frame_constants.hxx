@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <string>
+
+#include "wgsl_layout.hxx"
+
+/// Maximum number of lights in `FrameConstants`.
+static constexpr size_t MAX_LIGHTS = 4;
+
+/// Point light.
+struct Light {
+    alignas(16) glm::vec3 position = glm::vec3(0, 0, 0);
+    alignas(16) glm::vec3 color = glm::vec3(1, 1, 1);
+};
+
+inline constexpr auto LIGHT_LAYOUT = wgsl::struct_layout<Light, wgsl::Uniform>(
+    "Light",
+    WGSL_FIELD(Light, position),
+    WGSL_FIELD(Light, color)
+);
+
+template <>
+struct wgsl::TypeOf<Light> : wgsl::StructType<LIGHT_LAYOUT> {};
+
+/// Data shared by all shaders of a frame, written once per frame by the scene into a uniform buffer
+/// at `@group(0) @binding(0)`, visible to vertex and fragment stages. Shaders declare it with
+/// `frame_constants_wgsl`.
+struct FrameConstants {
+    glm::mat4x4 projection;
+    glm::mat4x4 view;
+    glm::mat4x4 view_projection;
+    glm::vec3 view_position;
+    /// Seconds since the scene was created.
+    float time;
+    uint32_t light_count;
+    alignas(16) std::array<Light, MAX_LIGHTS> lights;
+};
+
+inline constexpr auto FRAME_CONSTANTS_LAYOUT = wgsl::struct_layout<FrameConstants, wgsl::Uniform>(
+    "FrameConstants",
+    WGSL_FIELD(FrameConstants, projection),
+    WGSL_FIELD(FrameConstants, view),
+    WGSL_FIELD(FrameConstants, view_projection),
+    WGSL_FIELD(FrameConstants, view_position),
+    WGSL_FIELD(FrameConstants, time),
+    WGSL_FIELD(FrameConstants, light_count),
+    WGSL_FIELD(FrameConstants, lights)
+);
+
+/// Declarations of `Light`, `FrameConstants` and `frame`, the binding at group 0.
+inline std::string frame_constants_wgsl() {
+    return LIGHT_LAYOUT.declaration() + FRAME_CONSTANTS_LAYOUT.declaration() +
+           "@group(0) @binding(0) var<uniform> frame: FrameConstants;\n";
+}
@@ -14,33 +14,59 @@ ShaderInfo GeometryBase::create_vertex_shader(const wgpu::Device&) const {
     std::abort();
 }
 
+std::vector<wgpu::ConstantEntry> GeometryBase::vertex_shader_constants() const {
+    return std::vector<wgpu::ConstantEntry> {};
+}
+
 std::vector<wgpu::VertexBufferLayout> GeometryBase::vertex_buffer_layouts() const {
     return std::vector<wgpu::VertexBufferLayout> {};
 }
 
 wgpu::BindGroupLayout GeometryBase::create_bind_group_layout(const wgpu::Device& device) const {
+    auto entries = std::array {
+        wgpu::BindGroupLayoutEntry {
+            .binding = 0,
+            .visibility = wgpu::ShaderStage::Vertex,
+            .buffer =
+                wgpu::BufferBindingLayout {
+                    .type = wgpu::BufferBindingType::ReadOnlyStorage,
+                    .hasDynamicOffset = false,
+                    .minBindingSize = INSTANCE_TRANSFORMS_LAYOUT.size,
+                },
+        },
+    };
     auto descriptor = wgpu::BindGroupLayoutDescriptor {
-        .entryCount = 0,
-        .entries = nullptr,
+        .entryCount = entries.size(),
+        .entries = entries.data(),
     };
     return device.CreateBindGroupLayout(&descriptor);
 }
 
 wgpu::BindGroup GeometryBase::create_bind_group(
     const wgpu::Device& device,
-    wgpu::BindGroupLayout layout
+    wgpu::BindGroupLayout layout,
+    wgpu::Buffer instances
 ) const {
+    auto entries = std::array {
+        wgpu::BindGroupEntry {
+            .binding = 0,
+            .buffer = instances,
+            .offset = 0,
+        },
+    };
     auto descriptor = wgpu::BindGroupDescriptor {
         .layout = layout,
-        .entryCount = 0,
-        .entries = nullptr,
+        .entryCount = entries.size(),
+        .entries = entries.data(),
     };
     return device.CreateBindGroup(&descriptor);
 }
 
-void GeometryBase::set_model_view(const wgpu::Queue&, glm::mat4x4, glm::mat4x4) {}
-
 DrawParameters GeometryBase::draw_parameters() const {
     log_error("unimplemented: {}", __PRETTY_FUNCTION__);
     std::abort();
 }
+
+std::optional<BoundingBox> GeometryBase::local_bounds() const {
+    return std::nullopt;
+}
@@ -4,8 +4,10 @@
 #include <glm/matrix.hpp>
 #include <webgpu/webgpu_cpp.h>
 
+#include "../culling.hxx"
 #include "../object.hxx"
 #include "../shader_info.hxx"
+#include "../wgsl_layout.hxx"
 
 struct DrawParametersIndexed {
     wgpu::Buffer index_buffer;
@@ -30,21 +32,56 @@ struct DrawParametersIndexless {
 
 using DrawParameters = std::variant<DrawParametersIndexed, DrawParametersIndexless>;
 
+/// Per-instance data of every geometry, in a storage buffer at `@group(1) @binding(0)` declared
+/// with `instances_wgsl`.
+///
+/// Shaders index it with `@builtin(instance_index)`, `first_instance` and `instance_count` of the
+/// draw parameters are overridden by the scene. Camera matrices are in `FrameConstants`, at
+/// group 0.
+struct InstanceTransforms {
+    glm::mat4x4 model;
+    glm::mat4x4 normal_transform;
+};
+
+inline constexpr auto INSTANCE_TRANSFORMS_LAYOUT =
+    wgsl::struct_layout<InstanceTransforms, wgsl::Storage>(
+        "Instance",
+        WGSL_FIELD(InstanceTransforms, model),
+        WGSL_FIELD(InstanceTransforms, normal_transform)
+    );
+
+template <>
+struct wgsl::TypeOf<InstanceTransforms> : wgsl::StructType<INSTANCE_TRANSFORMS_LAYOUT> {};
+
+/// Declarations of `Instance` and `instances`, the binding at group 1.
+inline std::string instances_wgsl() {
+    return INSTANCE_TRANSFORMS_LAYOUT.declaration() +
+           "@group(1) @binding(0) var<storage, read> instances: array<Instance>;\n";
+}
+
+/// Render pipelines are cached per device (see `PipelineCache`), so the vertex shader module,
+/// vertex buffer layouts, bind group layout and primitive state of a geometry must depend only on
+/// its dynamic type. Per-instance variation goes through `vertex_shader_constants`.
 struct GeometryBase : public ObjectBase {
     virtual ShaderInfo create_vertex_shader(const wgpu::Device& device) const;
 
+    virtual std::vector<wgpu::ConstantEntry> vertex_shader_constants() const;
+
     virtual std::vector<wgpu::VertexBufferLayout> vertex_buffer_layouts() const;
 
     virtual wgpu::BindGroupLayout create_bind_group_layout(const wgpu::Device& device) const;
 
     virtual wgpu::PrimitiveState primitive_state() const;
 
+    /// `instances` is the buffer of `InstanceBuffer`, see `InstanceTransforms`.
     virtual wgpu::BindGroup create_bind_group(
         const wgpu::Device& device,
-        wgpu::BindGroupLayout layout
+        wgpu::BindGroupLayout layout,
+        wgpu::Buffer instances
     ) const;
 
-    virtual void set_model_view(const wgpu::Queue& queue, glm::mat4x4 model, glm::mat4x4 view);
-
     virtual DrawParameters draw_parameters() const;
+
+    /// Object-space bounds for frustum culling, `std::nullopt` (the default) for never culling.
+    virtual std::optional<BoundingBox> local_bounds() const;
 };
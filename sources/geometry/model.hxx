@@ -4,28 +4,24 @@
 #include <fastgltf/math.hpp>
 #include <fastgltf/tools.hpp>
 #include <filesystem>
+#include <limits>
+#include <memory>
+#include <type_traits>
 #include <glm/ext.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <webgpu/webgpu_cpp.h>
 
+#include "../frame_constants.hxx"
 #include "../log.hxx"
 #include "base.hxx"
+#include "pool.hxx"
 
 using std::string_view_literals::operator""sv;
 
 template <class T>
 wgpu::IndexFormat index_format_of() {}
 
-struct alignas(16) Vertex {
-    std::array<float, 3> position;
-    float padding_0;
-    std::array<float, 3> normal;
-    float padding_1;
-    std::array<float, 2> uv;
-    float padding_2[2];
-};
-
 template <>
 inline wgpu::IndexFormat index_format_of<uint16_t>() {
     return wgpu::IndexFormat::Uint16;
@@ -45,6 +41,8 @@ template <IndexType I>
 struct Model {
     std::vector<Vertex> vertices;
     std::vector<I> indices;
+    /// Bounds of all vertex positions.
+    BoundingBox bounds;
 
     inline bool check_indices_all_in_bounds() const {
         for (uint32_t index : this->indices) {
@@ -143,6 +141,10 @@ struct Model {
         auto vertices = std::vector<Vertex>(position_accessor.count);
 
         size_t i_position = 0;
+        auto bounds = BoundingBox {
+            .min = glm::vec3(std::numeric_limits<float>::infinity()),
+            .max = glm::vec3(-std::numeric_limits<float>::infinity()),
+        };
         fastgltf::iterateAccessor<fastgltf::math::fvec3>(
             asset,
             position_accessor,
@@ -150,6 +152,9 @@ struct Model {
                 vertices[i_position].position[0] = position[0];
                 vertices[i_position].position[1] = position[1];
                 vertices[i_position].position[2] = position[2];
+                auto p = glm::vec3(position[0], position[1], position[2]);
+                bounds.min = glm::min(bounds.min, p);
+                bounds.max = glm::max(bounds.max, p);
                 ++i_position;
             }
         );
@@ -173,7 +178,6 @@ struct Model {
             [&](fastgltf::math::fvec2 uv) {
                 vertices[i_uv].uv[0] = uv[0];
                 vertices[i_uv].uv[1] = uv[1];
-                vertices[i_uv].uv[2] = uv[2];
                 ++i_uv;
             }
         );
@@ -181,22 +185,13 @@ struct Model {
         return Model<I> {
             .vertices = vertices,
             .indices = indices,
+            .bounds = bounds,
         };
     }
 };
 
 constexpr std::string_view SHADER_CODE = R"(
 
-@group(0) @binding(0) var<uniform> projection: mat4x4<f32>;
-
-struct GeometryUniforms {
-    model: mat4x4<f32>,
-    model_view: mat4x4<f32>,
-    normal_transform: mat4x4<f32>,
-};
-
-@group(1) @binding(0) var<uniform> geometry: GeometryUniforms;
-
 struct VertexIn {
     @location(0) position: vec3<f32>,
     @location(1) uv: vec2<f32>,
@@ -210,12 +205,15 @@ struct VertexOut {
     @location(2) normal: vec3<f32>,
 };
 
-@vertex fn main(input: VertexIn) -> VertexOut {
+@vertex fn main(input: VertexIn, @builtin(instance_index) instance_index: u32) -> VertexOut {
+    let instance = instances[instance_index];
+
     var output: VertexOut;
-    output.position_clip = projection * geometry.model_view * vec4(input.position, 1.0);
-    output.position_world = (geometry.model * vec4(input.position, 1.0)).xyz;
+    let position_world = instance.model * vec4(input.position, 1.0);
+    output.position_clip = frame.view_projection * position_world;
+    output.position_world = position_world.xyz;
     output.uv = input.uv;
-    output.normal = (geometry.normal_transform * vec4(input.normal, 1.0)).xyz;
+    output.normal = (instance.normal_transform * vec4(input.normal, 1.0)).xyz;
 
     return output;
 }
@@ -240,66 +238,42 @@ static auto VERTEX_ATTRIBUTES = std::array {
     },
 };
 
+/// Mesh resident in a `GeometryPool`, freed from it on destruction.
 class ModelGeometry : public GeometryBase {
-    wgpu::Buffer vertex_buffer;
-    wgpu::Buffer index_buffer;
-    wgpu::Buffer uniform_buffer;
-    wgpu::IndexFormat index_format;
-    uint32_t index_count;
-
-    struct Uniforms {
-        glm::mat4x4 model = glm::identity<glm::mat4x4>();
-        glm::mat4x4 model_view = glm::identity<glm::mat4x4>();
-        glm::mat4x4 normal_transform = glm::identity<glm::mat4x4>();
-    };
+    std::shared_ptr<GeometryPool> pool = nullptr;
+    GeometryPoolAllocation allocation = {};
+    BoundingBox bounds;
 
   public:
     ModelGeometry() = default;
 
+    /// 16-bit indices are widened, as pools only hold 32-bit indices.
     template <IndexType I>
-    ModelGeometry(const wgpu::Device& device, const wgpu::Queue& queue, const Model<I>& model)
-        : index_format(index_format_of<I>())
-        , index_count(model.indices.size()) {
-        auto vertex_buffer_descriptor = wgpu::BufferDescriptor {
-            .label = "ModelGeometry::vertex_buffer"sv,
-            .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex,
-            .size = (uint64_t)model.vertices.size() * sizeof(model.vertices[0]),
-        };
-        this->vertex_buffer = device.CreateBuffer(&vertex_buffer_descriptor);
-        queue.WriteBuffer(
-            this->vertex_buffer,
-            0,
-            model.vertices.data(),
-            model.vertices.size() * sizeof(model.vertices[0])
-        );
+    ModelGeometry(std::shared_ptr<GeometryPool> pool, const Model<I>& model)
+        : pool(std::move(pool))
+        , bounds(model.bounds) {
+        if constexpr (std::is_same_v<I, uint32_t>) {
+            this->allocation = this->pool->allocate(model.vertices, model.indices);
+        } else {
+            auto indices = std::vector<uint32_t>(model.indices.begin(), model.indices.end());
+            this->allocation = this->pool->allocate(model.vertices, indices);
+        }
+    }
 
-        auto index_buffer_descriptor = wgpu::BufferDescriptor {
-            .label = "ModelGeometry::index_buffer"sv,
-            .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Index,
-            .size = (uint64_t)model.indices.size() * sizeof(model.indices[0]),
-        };
-        this->index_buffer = device.CreateBuffer(&index_buffer_descriptor);
-        queue.WriteBuffer(
-            this->index_buffer,
-            0,
-            model.indices.data(),
-            model.indices.size() * sizeof(model.indices[0])
-        );
+    ModelGeometry(const ModelGeometry&) = delete;
+    ModelGeometry& operator=(const ModelGeometry&) = delete;
 
-        auto uniform_buffer_descriptor = wgpu::BufferDescriptor {
-            .label = "ModelGeometry::uniform_buffer"sv,
-            .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Uniform,
-            .size = sizeof(Uniforms),
-        };
-        this->uniform_buffer = device.CreateBuffer(&uniform_buffer_descriptor);
-        auto uniforms = Uniforms {};
-        queue.WriteBuffer(this->uniform_buffer, 0, &uniforms, sizeof(uniforms));
+    ~ModelGeometry() override {
+        if (this->pool != nullptr) {
+            this->pool->free(this->allocation);
+        }
     }
 
     ShaderInfo create_vertex_shader(const wgpu::Device& device) const override {
+        auto code = frame_constants_wgsl() + instances_wgsl() + std::string(SHADER_CODE);
         auto wgsl = wgpu::ShaderSourceWGSL({
             .nextInChain = nullptr,
-            .code = wgpu::StringView(SHADER_CODE),
+            .code = wgpu::StringView(code),
         });
         auto shader_module_descriptor = wgpu::ShaderModuleDescriptor {
             .nextInChain = &wgsl,
@@ -308,7 +282,6 @@ class ModelGeometry : public GeometryBase {
         auto shader_module = device.CreateShaderModule(&shader_module_descriptor);
         return ShaderInfo {
             .shader_module = shader_module,
-            .constants = {},
         };
     }
 
@@ -323,65 +296,11 @@ class ModelGeometry : public GeometryBase {
         };
     }
 
-    wgpu::BindGroupLayout create_bind_group_layout(const wgpu::Device& device) const override {
-        auto entries = std::array {
-            wgpu::BindGroupLayoutEntry {
-                .binding = 0,
-                .visibility = wgpu::ShaderStage::Vertex,
-                .buffer =
-                    wgpu::BufferBindingLayout {
-                        .type = wgpu::BufferBindingType::Uniform,
-                        .hasDynamicOffset = false,
-                        .minBindingSize = sizeof(Uniforms),
-                    },
-            },
-        };
-        auto descriptor = wgpu::BindGroupLayoutDescriptor {
-            .label = "ModelGeometry"sv,
-            .entryCount = entries.size(),
-            .entries = entries.data(),
-        };
-        return device.CreateBindGroupLayout(&descriptor);
-    }
-
-    wgpu::BindGroup create_bind_group(const wgpu::Device& device, wgpu::BindGroupLayout layout)
-        const override {
-        auto entries = std::array {
-            wgpu::BindGroupEntry {
-                .binding = 0,
-                .buffer = this->uniform_buffer,
-                .offset = 0,
-                .size = sizeof(Uniforms),
-            },
-        };
-        auto descriptor = wgpu::BindGroupDescriptor {
-            .label = "ModelGeometry"sv,
-            .layout = layout,
-            .entryCount = entries.size(),
-            .entries = entries.data(),
-        };
-        return device.CreateBindGroup(&descriptor);
-    }
-
-    void set_model_view(const wgpu::Queue& queue, glm::mat4x4 model, glm::mat4x4 view) override {
-        auto uniforms = Uniforms {
-            .model = model,
-            .model_view = view * model,
-            .normal_transform = glm::transpose(glm::inverse(model)),
-        };
-        queue.WriteBuffer(this->uniform_buffer, 0, &uniforms, sizeof(uniforms));
+    DrawParameters draw_parameters() const override {
+        return this->pool->draw_parameters(this->allocation);
     }
 
-    DrawParameters draw_parameters() const override {
-        return DrawParametersIndexed {
-            .index_buffer = this->index_buffer,
-            .index_format = this->index_format,
-            .vertex_buffer = this->vertex_buffer,
-            .index_count = this->index_count,
-            .instance_count = 1,
-            .first_index = 0,
-            .base_vertex = 0,
-            .first_instance = 0,
-        };
+    std::optional<BoundingBox> local_bounds() const override {
+        return this->bounds;
     }
 };
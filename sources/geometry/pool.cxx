@@ -0,0 +1,232 @@
+#include "pool.hxx"
+#include "../log.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std::literals;
+
+static inline wgpu::Buffer create_pool_buffer(
+    const wgpu::Device& device,
+    std::string_view label,
+    wgpu::BufferUsage usage,
+    uint64_t size
+) {
+    auto descriptor = wgpu::BufferDescriptor {
+        .label = label,
+        .usage = usage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc,
+        .size = size,
+        .mappedAtCreation = false,
+    };
+    return device.CreateBuffer(&descriptor);
+}
+
+/// Compacts `allocator` and encodes copies of its live ranges from `source` to `destination`,
+/// merging ranges that stay contiguous.
+static inline void encode_compacted_copies(
+    wgpu::CommandEncoder& encoder,
+    RangeAllocator& allocator,
+    const wgpu::Buffer& source,
+    const wgpu::Buffer& destination,
+    uint64_t stride
+) {
+    uint32_t run_from = 0;
+    uint32_t run_to = 0;
+    uint32_t run_size = 0;
+    auto flush = [&]() {
+        if (run_size != 0) {
+            encoder.CopyBufferToBuffer(
+                source,
+                run_from * stride,
+                destination,
+                run_to * stride,
+                run_size * stride
+            );
+        }
+    };
+    allocator.compact([&](uint32_t from, uint32_t to, uint32_t size) {
+        if (run_size != 0 && run_from + run_size == from && run_to + run_size == to) {
+            run_size += size;
+            return;
+        }
+        flush();
+        run_from = from;
+        run_to = to;
+        run_size = size;
+    });
+    flush();
+}
+
+GeometryPool::GeometryPool(
+    wgpu::Device device,
+    wgpu::Queue queue,
+    uint32_t vertex_capacity,
+    uint32_t index_capacity
+)
+    : device(std::move(device))
+    , queue(std::move(queue))
+    , vertices(vertex_capacity)
+    , indices(index_capacity) {
+    this->vertex_buffer = create_pool_buffer(
+        this->device,
+        "GeometryPool::vertex_buffer"sv,
+        wgpu::BufferUsage::Vertex,
+        (uint64_t)vertex_capacity * sizeof(Vertex)
+    );
+    this->index_buffer = create_pool_buffer(
+        this->device,
+        "GeometryPool::index_buffer"sv,
+        wgpu::BufferUsage::Index,
+        (uint64_t)index_capacity * sizeof(uint32_t)
+    );
+}
+
+GeometryPoolAllocation GeometryPool::allocate(
+    std::span<const Vertex> vertices,
+    std::span<const uint32_t> indices
+) {
+    assert(!vertices.empty() && !indices.empty());
+    auto vertex_count = (uint32_t)vertices.size();
+    auto index_count = (uint32_t)indices.size();
+
+    auto vertex_range = this->vertices.allocate(vertex_count);
+    auto index_range = this->indices.allocate(index_count);
+    if (!vertex_range.has_value() || !index_range.has_value()) {
+        if (vertex_range.has_value()) {
+            this->vertices.free(vertex_range->node);
+        }
+        if (index_range.has_value()) {
+            this->indices.free(index_range->node);
+        }
+        // Grow pools more than half full, only compact the others.
+        auto capacity_for = [](const RangeAllocator& allocator, uint32_t count) {
+            auto stats = allocator.stats();
+            auto required = (uint64_t)stats.used + count;
+            if (required <= stats.capacity / 2) {
+                return stats.capacity;
+            }
+            return (uint32_t)std::min(
+                std::max((uint64_t)stats.capacity * 2, required * 2),
+                (uint64_t)UINT32_MAX
+            );
+        };
+        this->reallocate(
+            capacity_for(this->vertices, vertex_count),
+            capacity_for(this->indices, index_count)
+        );
+        vertex_range = this->vertices.allocate(vertex_count);
+        index_range = this->indices.allocate(index_count);
+        if (!vertex_range.has_value() || !index_range.has_value()) {
+            log_error(
+                "geometry pool out of space for {} vertices and {} indices",
+                vertex_count,
+                index_count
+            );
+            abort();
+        }
+    }
+
+    this->queue.WriteBuffer(
+        this->vertex_buffer,
+        (uint64_t)vertex_range->offset * sizeof(Vertex),
+        vertices.data(),
+        vertices.size_bytes()
+    );
+    this->queue.WriteBuffer(
+        this->index_buffer,
+        (uint64_t)index_range->offset * sizeof(uint32_t),
+        indices.data(),
+        indices.size_bytes()
+    );
+    return GeometryPoolAllocation {
+        .vertex_node = vertex_range->node,
+        .index_node = index_range->node,
+    };
+}
+
+void GeometryPool::free(const GeometryPoolAllocation& allocation) {
+    this->vertices.free(allocation.vertex_node);
+    this->indices.free(allocation.index_node);
+}
+
+DrawParametersIndexed GeometryPool::draw_parameters(
+    const GeometryPoolAllocation& allocation
+) const {
+    auto vertex_range = this->vertices.get(allocation.vertex_node);
+    auto index_range = this->indices.get(allocation.index_node);
+    return DrawParametersIndexed {
+        .index_buffer = this->index_buffer,
+        .index_format = wgpu::IndexFormat::Uint32,
+        .vertex_buffer = this->vertex_buffer,
+        .index_count = index_range.size,
+        .instance_count = 1,
+        .first_index = index_range.offset,
+        .base_vertex = (int32_t)vertex_range.offset,
+        .first_instance = 0,
+    };
+}
+
+void GeometryPool::defragment() {
+    this->reallocate(this->vertices.get_capacity(), this->indices.get_capacity());
+}
+
+uint64_t GeometryPool::get_generation() const {
+    return this->generation;
+}
+
+GeometryPool::Stats GeometryPool::stats() const {
+    return Stats {
+        .vertices = this->vertices.stats(),
+        .indices = this->indices.stats(),
+    };
+}
+
+void GeometryPool::reallocate(uint32_t vertex_capacity, uint32_t index_capacity) {
+    auto previous_stats = this->stats();
+
+    // Buffer copies within the same buffer are not allowed, so live ranges are compacted into new
+    // buffers. Writes already queued to the old buffers land before the copies, and writes after
+    // this to the new buffers land after them.
+    auto vertex_buffer = create_pool_buffer(
+        this->device,
+        "GeometryPool::vertex_buffer"sv,
+        wgpu::BufferUsage::Vertex,
+        (uint64_t)vertex_capacity * sizeof(Vertex)
+    );
+    auto index_buffer = create_pool_buffer(
+        this->device,
+        "GeometryPool::index_buffer"sv,
+        wgpu::BufferUsage::Index,
+        (uint64_t)index_capacity * sizeof(uint32_t)
+    );
+    auto encoder = this->device.CreateCommandEncoder();
+    encode_compacted_copies(
+        encoder,
+        this->vertices,
+        this->vertex_buffer,
+        vertex_buffer,
+        sizeof(Vertex)
+    );
+    encode_compacted_copies(
+        encoder,
+        this->indices,
+        this->index_buffer,
+        index_buffer,
+        sizeof(uint32_t)
+    );
+    auto command_buffer = encoder.Finish();
+    this->queue.Submit(1, &command_buffer);
+
+    this->vertices.grow(vertex_capacity);
+    this->indices.grow(index_capacity);
+    this->vertex_buffer = vertex_buffer;
+    this->index_buffer = index_buffer;
+    ++this->generation;
+    log_verbose(
+        "reallocated geometry pool to {} vertices and {} indices, fragmentation was {:.2f}/{:.2f}",
+        vertex_capacity,
+        index_capacity,
+        previous_stats.vertices.fragmentation(),
+        previous_stats.indices.fragmentation()
+    );
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <span>
+#include <webgpu/webgpu_cpp.h>
+
+#include "../range_allocator.hxx"
+#include "../wgsl_layout.hxx"
+#include "base.hxx"
+
+/// Vertex of meshes in a `GeometryPool`, also laid out for reading from storage buffers.
+struct Vertex {
+    alignas(16) glm::vec3 position;
+    alignas(16) glm::vec3 normal;
+    alignas(8) glm::vec2 uv;
+};
+
+inline constexpr auto VERTEX_LAYOUT = wgsl::struct_layout<Vertex, wgsl::Storage>(
+    "Vertex",
+    WGSL_FIELD(Vertex, position),
+    WGSL_FIELD(Vertex, normal),
+    WGSL_FIELD(Vertex, uv)
+);
+
+/// Ranges of a mesh in a `GeometryPool`, valid until freed.
+struct GeometryPoolAllocation {
+    uint32_t vertex_node = RangeAllocator::NULL_NODE;
+    uint32_t index_node = RangeAllocator::NULL_NODE;
+};
+
+/// Vertices and 32-bit indices of many meshes, sub-allocated out of one vertex buffer and one index
+/// buffer with `RangeAllocator`s. Meshes are addressed with `first_index` and `base_vertex` of
+/// their draw parameters, so consecutive draws of pooled meshes share buffer bindings.
+///
+/// When an allocation does not fit, the buffers are re-created, larger if the pool is more than
+/// half full, and live ranges are copied into them compacted. This moves meshes, so draw
+/// parameters of pooled meshes must not be kept across a change of `get_generation`.
+class GeometryPool {
+    wgpu::Device device = nullptr;
+    wgpu::Queue queue = nullptr;
+
+    wgpu::Buffer vertex_buffer = nullptr;
+    wgpu::Buffer index_buffer = nullptr;
+    RangeAllocator vertices = {};
+    RangeAllocator indices = {};
+
+    /// Bumped every time buffers are re-created.
+    uint64_t generation = 0;
+
+  public:
+    struct Stats {
+        /// In vertices.
+        RangeAllocator::Stats vertices;
+        /// In indices.
+        RangeAllocator::Stats indices;
+    };
+
+    GeometryPool() = default;
+
+    GeometryPool(
+        wgpu::Device device,
+        wgpu::Queue queue,
+        uint32_t vertex_capacity = 1 << 16,
+        uint32_t index_capacity = 1 << 18
+    );
+
+    /// Uploads a mesh. Indices are relative to the first vertex of the mesh.
+    GeometryPoolAllocation allocate(
+        std::span<const Vertex> vertices,
+        std::span<const uint32_t> indices
+    );
+
+    void free(const GeometryPoolAllocation& allocation);
+
+    /// Draws all indices of the mesh, once.
+    DrawParametersIndexed draw_parameters(const GeometryPoolAllocation& allocation) const;
+
+    /// Compacts live ranges to the start of the buffers, leaving free space in one block.
+    void defragment();
+
+    uint64_t get_generation() const;
+
+    Stats stats() const;
+
+  private:
+    /// Re-creates buffers with the given capacities and copies live ranges into them, compacted.
+    void reallocate(uint32_t vertex_capacity, uint32_t index_capacity);
+};
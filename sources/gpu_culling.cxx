@@ -0,0 +1,369 @@
+#include "gpu_culling.hxx"
+#include "log.hxx"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+
+using namespace std::literals;
+
+static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+/// After the declarations of `Instance`, `GpuCullEntity` and `GpuCullUniforms`.
+static constexpr std::string_view SHADER_CODE = R"(
+
+struct DrawArguments {
+    word_0: u32,
+    instance_count: atomic<u32>,
+    word_2: u32,
+    word_3: u32,
+    word_4: u32,
+};
+
+@group(0) @binding(0) var<uniform> uniforms: GpuCullUniforms;
+@group(0) @binding(1) var<storage, read> entities: array<GpuCullEntity>;
+@group(0) @binding(2) var<storage, read> instances: array<Instance>;
+@group(0) @binding(3) var<storage, read> group_first_instances: array<u32>;
+@group(0) @binding(4) var<storage, read_write> draw_arguments: array<DrawArguments>;
+@group(0) @binding(5) var<storage, read_write> visible_instances: array<Instance>;
+
+// Same test as `Frustum::test` on the world-space bounding box.
+fn is_visible(entity: GpuCullEntity, model: mat4x4<f32>) -> bool {
+    if (entity.always_visible != 0u) {
+        return true;
+    }
+    let local_center = 0.5 * (entity.local_min + entity.local_max);
+    let local_extent = 0.5 * (entity.local_max - entity.local_min);
+    let center = (model * vec4(local_center, 1.0)).xyz;
+    let extent = abs(model[0].xyz) * local_extent.x + abs(model[1].xyz) * local_extent.y +
+                 abs(model[2].xyz) * local_extent.z;
+    for (var i = 0u; i < 6u; i++) {
+        let plane = uniforms.planes[i];
+        let distance = dot(plane.xyz, center) + plane.w;
+        let radius = dot(abs(plane.xyz), extent);
+        if (distance + radius < 0.0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+@compute @workgroup_size(64) fn main(@builtin(global_invocation_id) id: vec3<u32>) {
+    let i = id.x;
+    if (i >= uniforms.entity_count) {
+        return;
+    }
+    let entity = entities[i];
+    let instance = instances[i];
+    if (!is_visible(entity, instance.model)) {
+        return;
+    }
+    let slot = atomicAdd(&draw_arguments[entity.group].instance_count, 1u);
+    visible_instances[group_first_instances[entity.group] + slot] = instance;
+}
+
+)";
+
+struct GpuCullUniforms {
+    std::array<glm::vec4, 6> planes;
+    uint32_t entity_count;
+    uint32_t padding[3];
+};
+
+static constexpr auto GPU_CULL_UNIFORMS_LAYOUT =
+    wgsl::struct_layout<GpuCullUniforms, wgsl::Uniform>(
+        "GpuCullUniforms",
+        WGSL_FIELD(GpuCullUniforms, planes),
+        WGSL_FIELD(GpuCullUniforms, entity_count)
+    );
+
+static inline wgpu::Buffer create_buffer(
+    const wgpu::Device& device,
+    std::string_view label,
+    wgpu::BufferUsage usage,
+    uint64_t size
+) {
+    auto descriptor = wgpu::BufferDescriptor {
+        .label = label,
+        .usage = usage | wgpu::BufferUsage::CopyDst,
+        .size = size,
+        .mappedAtCreation = false,
+    };
+    return device.CreateBuffer(&descriptor);
+}
+
+static inline wgpu::BindGroupLayoutEntry storage_entry(uint32_t binding, bool read_only) {
+    return wgpu::BindGroupLayoutEntry {
+        .binding = binding,
+        .visibility = wgpu::ShaderStage::Compute,
+        .buffer =
+            wgpu::BufferBindingLayout {
+                .type = read_only ? wgpu::BufferBindingType::ReadOnlyStorage
+                                  : wgpu::BufferBindingType::Storage,
+                .hasDynamicOffset = false,
+                .minBindingSize = 0,
+            },
+    };
+}
+
+GpuCuller::GpuCuller(wgpu::Device device) : device(std::move(device)) {
+    auto layout_entries = std::array {
+        wgpu::BindGroupLayoutEntry {
+            .binding = 0,
+            .visibility = wgpu::ShaderStage::Compute,
+            .buffer =
+                wgpu::BufferBindingLayout {
+                    .type = wgpu::BufferBindingType::Uniform,
+                    .hasDynamicOffset = false,
+                    .minBindingSize = GPU_CULL_UNIFORMS_LAYOUT.size,
+                },
+        },
+        storage_entry(1, true),
+        storage_entry(2, true),
+        storage_entry(3, true),
+        storage_entry(4, false),
+        storage_entry(5, false),
+    };
+    auto layout_descriptor = wgpu::BindGroupLayoutDescriptor {
+        .label = "GPU Culling"sv,
+        .entryCount = layout_entries.size(),
+        .entries = layout_entries.data(),
+    };
+    this->bind_group_layout = this->device.CreateBindGroupLayout(&layout_descriptor);
+
+    auto pipeline_layout_descriptor = wgpu::PipelineLayoutDescriptor {
+        .label = "GPU Culling"sv,
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = &this->bind_group_layout,
+    };
+    auto pipeline_layout = this->device.CreatePipelineLayout(&pipeline_layout_descriptor);
+
+    auto code = INSTANCE_TRANSFORMS_LAYOUT.declaration() + GPU_CULL_ENTITY_LAYOUT.declaration() +
+                GPU_CULL_UNIFORMS_LAYOUT.declaration() + std::string(SHADER_CODE);
+    auto shader_source = wgpu::ShaderSourceWGSL({
+        .nextInChain = nullptr,
+        .code = wgpu::StringView(code),
+    });
+    auto shader_module_descriptor = wgpu::ShaderModuleDescriptor {
+        .nextInChain = &shader_source,
+        .label = "GPU Culling"sv,
+    };
+    auto shader_module = this->device.CreateShaderModule(&shader_module_descriptor);
+
+    auto pipeline_descriptor = wgpu::ComputePipelineDescriptor {
+        .label = "GPU Culling"sv,
+        .layout = pipeline_layout,
+        .compute =
+            wgpu::ComputeState {
+                .module = shader_module,
+                .entryPoint = "main"sv,
+                .constantCount = 0,
+                .constants = nullptr,
+            },
+    };
+    this->pipeline = this->device.CreateComputePipeline(&pipeline_descriptor);
+
+    this->uniforms = create_buffer(
+        this->device,
+        "GPU Culling Uniforms"sv,
+        wgpu::BufferUsage::Uniform,
+        sizeof(GpuCullUniforms)
+    );
+}
+
+void GpuCuller::set_entities(
+    const wgpu::Queue& queue,
+    std::span<const GpuCullEntity> entities,
+    std::span<const DrawParameters> group_parameters
+) {
+    this->entity_count = (uint32_t)entities.size();
+    this->bind_group = nullptr;
+    this->bound_instances = nullptr;
+    if (entities.empty()) {
+        this->initial_draw_arguments.clear();
+        return;
+    }
+
+    // Each group gets a range of visible instances as large as the group.
+    auto group_first_instances = std::vector<uint32_t>(group_parameters.size() + 1, 0);
+    for (const auto& entity : entities) {
+        assert(entity.group < group_parameters.size());
+        ++group_first_instances[entity.group + 1];
+    }
+    for (size_t i = 1; i < group_first_instances.size(); ++i) {
+        group_first_instances[i] += group_first_instances[i - 1];
+    }
+    group_first_instances.pop_back();
+
+    this->initial_draw_arguments.assign(group_parameters.size() * DRAW_ARGUMENTS_WORDS, 0);
+    for (size_t i = 0; i < group_parameters.size(); ++i) {
+        auto* arguments = &this->initial_draw_arguments[i * DRAW_ARGUMENTS_WORDS];
+        if (const auto* parameters = std::get_if<DrawParametersIndexed>(&group_parameters[i])) {
+            arguments[0] = parameters->index_count;
+            arguments[2] = parameters->first_index;
+            arguments[3] = (uint32_t)parameters->base_vertex;
+            arguments[4] = group_first_instances[i];
+        } else {
+            const auto& indexless = std::get<DrawParametersIndexless>(group_parameters[i]);
+            arguments[0] = indexless.vertex_count;
+            arguments[2] = indexless.first_vertex;
+            arguments[3] = group_first_instances[i];
+        }
+    }
+
+    auto entities_size = entities.size_bytes();
+    auto instances_size = entities.size() * sizeof(InstanceTransforms);
+    auto draw_arguments_size = this->initial_draw_arguments.size() * sizeof(uint32_t);
+    if (this->entities == nullptr || this->entities.GetSize() < entities_size) {
+        this->entities = create_buffer(
+            this->device,
+            "GPU Culling Entities"sv,
+            wgpu::BufferUsage::Storage,
+            entities_size
+        );
+    }
+    if (this->visible_instances == nullptr || this->visible_instances.GetSize() < instances_size) {
+        this->visible_instances = create_buffer(
+            this->device,
+            "Visible Instances"sv,
+            wgpu::BufferUsage::Storage,
+            instances_size
+        );
+        ++this->generation;
+    }
+    if (this->group_first_instances == nullptr ||
+        this->group_first_instances.GetSize() < group_first_instances.size() * sizeof(uint32_t)) {
+        this->group_first_instances = create_buffer(
+            this->device,
+            "GPU Culling Group First Instances"sv,
+            wgpu::BufferUsage::Storage,
+            group_first_instances.size() * sizeof(uint32_t)
+        );
+    }
+    if (this->draw_arguments == nullptr || this->draw_arguments.GetSize() < draw_arguments_size) {
+        this->draw_arguments = create_buffer(
+            this->device,
+            "GPU Culling Draw Arguments"sv,
+            wgpu::BufferUsage::Storage | wgpu::BufferUsage::Indirect,
+            draw_arguments_size
+        );
+    }
+
+    queue.WriteBuffer(this->entities, 0, entities.data(), entities_size);
+    queue.WriteBuffer(
+        this->group_first_instances,
+        0,
+        group_first_instances.data(),
+        group_first_instances.size() * sizeof(uint32_t)
+    );
+    log_verbose(
+        "GPU culling of {} entities in {} draw groups",
+        entities.size(),
+        group_parameters.size()
+    );
+}
+
+void GpuCuller::stage(StagingBelt& belt, const Frustum& frustum, const wgpu::Buffer& instances) {
+    if (this->entity_count == 0) {
+        return;
+    }
+    assert(instances.GetSize() >= this->entity_count * sizeof(InstanceTransforms));
+
+    if (this->bind_group == nullptr || this->bound_instances != instances.Get()) {
+        auto entries = std::array {
+            wgpu::BindGroupEntry {
+                .binding = 0,
+                .buffer = this->uniforms,
+                .offset = 0,
+                .size = sizeof(GpuCullUniforms),
+            },
+            wgpu::BindGroupEntry {
+                .binding = 1,
+                .buffer = this->entities,
+                .offset = 0,
+                .size = this->entity_count * sizeof(GpuCullEntity),
+            },
+            wgpu::BindGroupEntry {
+                .binding = 2,
+                .buffer = instances,
+                .offset = 0,
+                .size = this->entity_count * sizeof(InstanceTransforms),
+            },
+            wgpu::BindGroupEntry {
+                .binding = 3,
+                .buffer = this->group_first_instances,
+                .offset = 0,
+                .size = this->group_first_instances.GetSize(),
+            },
+            wgpu::BindGroupEntry {
+                .binding = 4,
+                .buffer = this->draw_arguments,
+                .offset = 0,
+                .size = this->initial_draw_arguments.size() * sizeof(uint32_t),
+            },
+            wgpu::BindGroupEntry {
+                .binding = 5,
+                .buffer = this->visible_instances,
+                .offset = 0,
+                .size = this->entity_count * sizeof(InstanceTransforms),
+            },
+        };
+        auto descriptor = wgpu::BindGroupDescriptor {
+            .label = "GPU Culling"sv,
+            .layout = this->bind_group_layout,
+            .entryCount = entries.size(),
+            .entries = entries.data(),
+        };
+        this->bind_group = this->device.CreateBindGroup(&descriptor);
+        this->bound_instances = instances.Get();
+    }
+
+    auto uniforms = GpuCullUniforms {
+        .planes = frustum.planes,
+        .entity_count = this->entity_count,
+        .padding = {},
+    };
+    std::memcpy(
+        belt.write(this->uniforms, 0, sizeof(uniforms)).data(),
+        &uniforms,
+        sizeof(uniforms)
+    );
+    // Reset instance counts.
+    auto draw_arguments_size = this->initial_draw_arguments.size() * sizeof(uint32_t);
+    std::memcpy(
+        belt.write(this->draw_arguments, 0, draw_arguments_size).data(),
+        this->initial_draw_arguments.data(),
+        draw_arguments_size
+    );
+}
+
+void GpuCuller::cull(wgpu::CommandEncoder& encoder) const {
+    if (this->entity_count == 0) {
+        return;
+    }
+
+    auto compute_pass_descriptor = wgpu::ComputePassDescriptor {
+        .label = "GPU Culling"sv,
+    };
+    auto compute_pass = encoder.BeginComputePass(&compute_pass_descriptor);
+    compute_pass.SetPipeline(this->pipeline);
+    compute_pass.SetBindGroup(0, this->bind_group);
+    compute_pass.DispatchWorkgroups((this->entity_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+    compute_pass.End();
+}
+
+wgpu::Buffer GpuCuller::get_visible_instances() const {
+    return this->visible_instances;
+}
+
+uint64_t GpuCuller::get_generation() const {
+    return this->generation;
+}
+
+wgpu::Buffer GpuCuller::get_draw_arguments() const {
+    return this->draw_arguments;
+}
+
+uint64_t GpuCuller::draw_arguments_offset(uint32_t group) {
+    return (uint64_t)group * DRAW_ARGUMENTS_WORDS * sizeof(uint32_t);
+}
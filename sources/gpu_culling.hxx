@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+#include "culling.hxx"
+#include "geometry/base.hxx"
+#include "staging_belt.hxx"
+#include "wgsl_layout.hxx"
+
+/// Per-entity data of `GpuCuller`.
+struct GpuCullEntity {
+    /// Object-space bounds, transformed on the GPU by the entity's model matrix.
+    glm::vec3 local_min;
+    /// Index of the draw group of the entity.
+    uint32_t group;
+    glm::vec3 local_max;
+    /// Non-zero for entities without bounds.
+    uint32_t always_visible;
+};
+
+inline constexpr auto GPU_CULL_ENTITY_LAYOUT = wgsl::struct_layout<GpuCullEntity, wgsl::Storage>(
+    "GpuCullEntity",
+    WGSL_FIELD(GpuCullEntity, local_min),
+    WGSL_FIELD(GpuCullEntity, group),
+    WGSL_FIELD(GpuCullEntity, local_max),
+    WGSL_FIELD(GpuCullEntity, always_visible)
+);
+
+/// GPU-driven frustum culling.
+///
+/// Entities are partitioned into draw groups, each drawn with one indirect draw call. Every frame,
+/// a compute pass tests the bounds of every entity against the frustum and copies the transforms of
+/// visible ones into their group's range of `get_visible_instances`, counting them into the
+/// group's draw arguments with an atomic. Render passes then bind the visible instances in place of
+/// the scene's instance buffer and draw each group with `DrawIndirect` or `DrawIndexedIndirect`,
+/// without reading anything back to the CPU.
+///
+/// Draw arguments are 5 words per group: the layout of `DrawIndexedIndirect`, or of `DrawIndirect`
+/// followed by an unused word, as both have the instance count in the second word. Their first
+/// instance is the start of the group's range, so the device needs
+/// `wgpu::FeatureName::IndirectFirstInstance`.
+class GpuCuller {
+    wgpu::Device device = nullptr;
+
+    wgpu::BindGroupLayout bind_group_layout = nullptr;
+    wgpu::ComputePipeline pipeline = nullptr;
+
+    wgpu::Buffer uniforms = nullptr;
+    wgpu::Buffer entities = nullptr;
+    wgpu::Buffer group_first_instances = nullptr;
+    wgpu::Buffer draw_arguments = nullptr;
+    wgpu::Buffer visible_instances = nullptr;
+
+    /// Bound to `instances`, re-created along with buffers or when the instance buffer changes.
+    wgpu::BindGroup bind_group = nullptr;
+    WGPUBuffer bound_instances = nullptr;
+
+    /// Draw arguments with zero instances, written before each culling pass.
+    std::vector<uint32_t> initial_draw_arguments = {};
+    uint32_t entity_count = 0;
+
+    /// Bumped every time `visible_instances` is re-created.
+    uint64_t generation = 0;
+
+  public:
+    static constexpr uint32_t DRAW_ARGUMENTS_WORDS = 5;
+
+    GpuCuller() = default;
+
+    GpuCuller(wgpu::Device device);
+
+    /// Replaces all entities and draw groups. `GpuCullEntity::group` indexes `group_parameters`.
+    /// Entity `i` must be instance `i` of the buffer passed to `cull`.
+    void set_entities(
+        const wgpu::Queue& queue,
+        std::span<const GpuCullEntity> entities,
+        std::span<const DrawParameters> group_parameters
+    );
+
+    /// Stages uniforms and reset draw arguments of the next `cull` in `belt`, whose copies must be
+    /// recorded before it. `instances` is an instance buffer (see `InstanceTransforms`) with one
+    /// instance per entity.
+    void stage(StagingBelt& belt, const Frustum& frustum, const wgpu::Buffer& instances);
+
+    /// Encodes the culling compute pass, which must come before render passes using the results.
+    void cull(wgpu::CommandEncoder& encoder) const;
+
+    /// Instance buffer of visible entities, grouped by draw group.
+    wgpu::Buffer get_visible_instances() const;
+
+    uint64_t get_generation() const;
+
+    /// Indirect buffer of draw arguments, `DRAW_ARGUMENTS_WORDS` words per group.
+    wgpu::Buffer get_draw_arguments() const;
+
+    static uint64_t draw_arguments_offset(uint32_t group);
+};
@@ -0,0 +1,51 @@
+#include "instance_buffer.hxx"
+#include "log.hxx"
+
+using namespace std::literals;
+
+static inline wgpu::Buffer create_storage_buffer(const wgpu::Device& device, size_t capacity) {
+    auto descriptor = wgpu::BufferDescriptor {
+        .label = "Instances"sv,
+        .usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst,
+        .size = (uint64_t)capacity * sizeof(InstanceTransforms),
+        .mappedAtCreation = false,
+    };
+    return device.CreateBuffer(&descriptor);
+}
+
+InstanceBuffer::InstanceBuffer(wgpu::Device device, size_t initial_capacity)
+    : device(std::move(device))
+    , capacity(initial_capacity) {
+    this->buffer = create_storage_buffer(this->device, initial_capacity);
+}
+
+void InstanceBuffer::begin_frame() {
+    this->count = 0;
+}
+
+uint32_t InstanceBuffer::reserve() {
+    return (uint32_t)this->count++;
+}
+
+std::span<InstanceTransforms> InstanceBuffer::stage(StagingBelt& belt) {
+    if (this->count == 0) {
+        return {};
+    }
+    if (this->count > this->capacity) {
+        auto capacity = std::max(this->capacity * 2, this->count);
+        log_verbose("growing instance buffer from {} to {} instances", this->capacity, capacity);
+        this->buffer = create_storage_buffer(this->device, capacity);
+        this->capacity = capacity;
+        ++this->generation;
+    }
+    auto staging = belt.write(this->buffer, 0, this->count * sizeof(InstanceTransforms));
+    return std::span((InstanceTransforms*)staging.data(), this->count);
+}
+
+wgpu::Buffer InstanceBuffer::get_buffer() const {
+    return this->buffer;
+}
+
+uint64_t InstanceBuffer::get_generation() const {
+    return this->generation;
+}
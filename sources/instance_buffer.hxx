@@ -0,0 +1,46 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+#include "geometry/base.hxx"
+#include "staging_belt.hxx"
+
+/// Per-instance transforms of every entity drawn in a frame, in a storage buffer that vertex shaders
+/// index with `@builtin(instance_index)`.
+///
+/// Instances are reserved in draw order, so that entities drawn together with one instanced draw
+/// call occupy a contiguous range. Their transforms are then written straight into the mapped
+/// memory of a `StagingBelt`.
+class InstanceBuffer {
+    wgpu::Device device = nullptr;
+    wgpu::Buffer buffer = nullptr;
+
+    /// In instances.
+    size_t capacity = 0;
+    size_t count = 0;
+
+    /// Bumped every time `buffer` is re-created, so that bind groups can be re-created lazily.
+    uint64_t generation = 0;
+
+  public:
+    InstanceBuffer() = default;
+
+    InstanceBuffer(wgpu::Device device, size_t initial_capacity = 1024);
+
+    /// Clears all instances, must be called before any `reserve` of a frame.
+    void begin_frame();
+
+    /// Returns the index of the instance.
+    uint32_t reserve();
+
+    /// Staging memory of all instances reserved this frame, to be written before `belt` is
+    /// finished. Instances left unwritten have undefined transforms.
+    /// If the buffer had to grow, this bumps the generation.
+    std::span<InstanceTransforms> stage(StagingBelt& belt);
+
+    wgpu::Buffer get_buffer() const;
+
+    uint64_t get_generation() const;
+};
@@ -0,0 +1,124 @@
+#include "job_system.hxx"
+
+#include <cassert>
+
+/// Set on worker threads, to push jobs they submit to their own deque.
+static thread_local const JobSystem* this_thread_system = nullptr;
+static thread_local uint32_t this_thread_worker = 0;
+
+JobSystem::JobSystem(uint32_t worker_count) {
+    for (uint32_t i = 0; i < worker_count + 1; ++i) {
+        this->queues.push_back(std::make_unique<Queue>());
+    }
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        this->workers.emplace_back([this, i] { this->worker_main(i); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        auto lock = std::lock_guard(this->sleep_mutex);
+        this->stopping = true;
+    }
+    this->wake_up.notify_all();
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+    // Without workers, nothing ran jobs that nobody waited for.
+    while (this->run_one(this->queue_index_of_this_thread())) {
+    }
+}
+
+uint32_t JobSystem::get_worker_count() const {
+    return (uint32_t)this->workers.size();
+}
+
+uint32_t JobSystem::get_thread_count() const {
+    return (uint32_t)this->workers.size() + 1;
+}
+
+void JobSystem::submit(Counter& counter, Job job) {
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    auto& queue = *this->queues[this->queue_index_of_this_thread()];
+    {
+        auto lock = std::lock_guard(queue.mutex);
+        queue.tasks.push_back(Task {
+            .job = std::move(job),
+            .counter = &counter,
+        });
+    }
+    this->queued_count.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders the increment before the predicate check of a worker going to sleep,
+    // so that the notification is not lost.
+    {
+        auto lock = std::lock_guard(this->sleep_mutex);
+    }
+    this->wake_up.notify_one();
+}
+
+void JobSystem::wait(Counter& counter) {
+    auto index = this->queue_index_of_this_thread();
+    while (counter.pending.load(std::memory_order_acquire) != 0) {
+        if (!this->run_one(index)) {
+            // The remaining jobs are running on other threads.
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::worker_main(uint32_t index) {
+    this_thread_system = this;
+    this_thread_worker = index;
+    while (true) {
+        if (this->run_one(index)) {
+            continue;
+        }
+        auto lock = std::unique_lock(this->sleep_mutex);
+        this->wake_up.wait(lock, [&] {
+            return this->stopping || this->queued_count.load(std::memory_order_acquire) != 0;
+        });
+        if (this->stopping && this->queued_count.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+bool JobSystem::run_one(uint32_t index) {
+    auto task = Task {
+        .job = nullptr,
+        .counter = nullptr,
+    };
+    // Own jobs last in first out, as they are the most likely to be in cache.
+    {
+        auto& queue = *this->queues[index];
+        auto lock = std::lock_guard(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+    // Stolen jobs first in first out, as the oldest are the largest with recursive splitting.
+    for (size_t i = 1; task.counter == nullptr && i < this->queues.size(); ++i) {
+        auto& queue = *this->queues[(index + i) % this->queues.size()];
+        auto lock = std::lock_guard(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (task.counter == nullptr) {
+        return false;
+    }
+    this->queued_count.fetch_sub(1, std::memory_order_relaxed);
+    task.job();
+    assert(task.counter->pending.load(std::memory_order_relaxed) > 0);
+    task.counter->pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+uint32_t JobSystem::queue_index_of_this_thread() const {
+    if (this_thread_system == this) {
+        return this_thread_worker;
+    }
+    return (uint32_t)this->workers.size();
+}
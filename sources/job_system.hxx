@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed pool of worker threads running short jobs, with work stealing.
+///
+/// Each worker has its own deque: it pushes and pops jobs at the back, and idle threads steal from
+/// the front of the others. Jobs submitted from other threads go to a shared queue that is stolen
+/// from like the deques of workers. A thread waiting for jobs (see `wait`) runs queued jobs in the
+/// meantime, so jobs may submit and wait for jobs of their own.
+///
+/// With no worker threads, jobs only run in `wait`, on the waiting thread.
+class JobSystem {
+  public:
+    /// Number of unfinished jobs submitted with it. Must outlive those jobs.
+    struct Counter {
+        std::atomic<uint32_t> pending = 0;
+    };
+
+    using Job = std::function<void()>;
+
+  private:
+    struct Task {
+        Job job;
+        Counter* counter;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /// One per worker, and the shared queue last.
+    std::vector<std::unique_ptr<Queue>> queues = {};
+    std::vector<std::thread> workers = {};
+
+    /// Tasks in all queues, for workers to sleep when there are none.
+    std::atomic<size_t> queued_count = 0;
+    std::mutex sleep_mutex = {};
+    std::condition_variable wake_up = {};
+    bool stopping = false;
+
+  public:
+    /// `worker_count` may be 0.
+    explicit JobSystem(uint32_t worker_count);
+
+    /// Waits for queued jobs to finish.
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t get_worker_count() const;
+
+    /// Threads running jobs while a thread waits, workers and the waiting thread.
+    uint32_t get_thread_count() const;
+
+    void submit(Counter& counter, Job job);
+
+    /// Runs queued jobs on the calling thread until all jobs of `counter` are finished.
+    void wait(Counter& counter);
+
+    /// Calls `f(chunk, begin, end)` for consecutive chunks of at most `chunk_size` indices covering
+    /// `[0, count)`, on all threads, and returns once all calls are done. The calling thread runs
+    /// the first chunk.
+    template <class F>
+    void parallel_for(size_t count, size_t chunk_size, F&& f) {
+        auto chunk_count = (count + chunk_size - 1) / chunk_size;
+        if (chunk_count == 0) {
+            return;
+        }
+        auto counter = Counter {};
+        for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+            auto begin = chunk * chunk_size;
+            auto end = std::min(begin + chunk_size, count);
+            this->submit(counter, [&f, chunk, begin, end] { f(chunk, begin, end); });
+        }
+        f((size_t)0, (size_t)0, std::min(chunk_size, count));
+        this->wait(counter);
+    }
+
+  private:
+    void worker_main(uint32_t index);
+
+    /// Pops a task of the queue of `index` or steals one from the other queues, and runs it.
+    /// Returns false if all queues are empty.
+    bool run_one(uint32_t index);
+
+    /// Index of the queue of the calling thread, the shared queue for threads that are not
+    /// workers of this system.
+    uint32_t queue_index_of_this_thread() const;
+};
@@ -3,20 +3,30 @@
 #include <fmt/ostream.h>
 #include <glm/ext.hpp>
 #include <glm/gtc/color_space.hpp>
+#include <atomic>
+#include <chrono>
 #include <span>
+#include <thread>
 #include <webgpu/webgpu_cpp.h>
 #include <webgpu/webgpu_glfw.h>
 
+#include "asset_loader.hxx"
+#include "benchmark.hxx"
+#include "blob_cache.hxx"
 #include "camera/perspective.hxx"
 #include "entity.hxx"
 #include "geometry/box.hxx"
 #include "geometry/model.hxx"
+#include "job_system.hxx"
 #include "log.hxx"
 #include "material/color.hxx"
 #include "material/uv_debug.hxx"
+#include "render_graph.hxx"
 #include "scene.hxx"
 #include "swapchain.hxx"
 #include "texture_blitter.hxx"
+#include "triple_buffer.hxx"
+#include "utils.hxx"
 
 using namespace std::literals;
 
@@ -42,107 +52,141 @@ static inline T div_ceil(T x, T y) {
     return (x + y - 1) / y;
 }
 
+/// Shading of one pixel, shared by the compute and the fragment paths of `Postprocessor`.
 const std::string_view POSTPROCESS_SHADER_CODE = R"(
 
 @group(0) @binding(0) var input_texture_color: texture_2d<f32>;
 @group(0) @binding(1) var input_texture_depth: texture_depth_2d;
 
-@group(1) @binding(0) var output_texture: texture_storage_2d<rgba8unorm, write>;
+@group(1) @binding(0) var<uniform> screen_extend: vec2<u32>;
+@group(1) @binding(1) var<uniform> srgb_output: u32;
 
-@group(2) @binding(0) var<uniform> screen_extend: vec2<u32>;
-@group(2) @binding(1) var<uniform> srgb_output: u32;
-
-@compute @workgroup_size(16, 16, 1) fn main(@builtin(global_invocation_id) id: vec3<u32>) {
-    let input_depth: f32 = textureLoad(input_texture_depth, id.xy, 0);
-    let input_color: vec4<f32> = textureLoad(input_texture_color, id.xy, 0);
+fn postprocess(coordinate: vec2<u32>) -> vec4<f32> {
+    let input_depth: f32 = textureLoad(input_texture_depth, coordinate, 0);
+    let input_color: vec4<f32> = textureLoad(input_texture_color, coordinate, 0);
 
     let bottom_color = vec4<f32>(0.08021982031446832, 0.11697066775851084, 0.21586050011389926, 1.0);
     let top_color = vec4<f32>(0.05126945837404324, 0.11697066775851084, 0.35153259950043936, 1.0);
     let background_color: vec4<f32> = mix(
         top_color,
         bottom_color,
-        f32(id.y) / f32(screen_extend.y),
+        f32(coordinate.y) / f32(screen_extend.y),
     );
     let output_color: vec4<f32> = select(input_color, background_color, input_depth == 1.0);
 
     if (srgb_output == 1) {
-        textureStore(output_texture, id.xy, output_color);
-    } else {
-        textureStore(
-            output_texture,
-            id.xy,
-            vec4<f32>(
-                pow(output_color.r, 1.0 / 2.2),
-                pow(output_color.g, 1.0 / 2.2),
-                pow(output_color.b, 1.0 / 2.2),
-                output_color.a,
-            ),
-        );
+        return output_color;
     }
+    return vec4<f32>(
+        pow(output_color.r, 1.0 / 2.2),
+        pow(output_color.g, 1.0 / 2.2),
+        pow(output_color.b, 1.0 / 2.2),
+        output_color.a,
+    );
 }
 
 )";
 
+/// Entry point of the compute paths of `Postprocessor`, `OUTPUT_FORMAT` is replaced with the WGSL
+/// texel format of the output texture.
+const std::string_view POSTPROCESS_COMPUTE_SHADER_CODE = R"(
+
+@group(2) @binding(0) var output_texture: texture_storage_2d<OUTPUT_FORMAT, write>;
+
+@compute @workgroup_size(16, 16, 1) fn main(@builtin(global_invocation_id) id: vec3<u32>) {
+    if (any(id.xy >= screen_extend)) {
+        return;
+    }
+    textureStore(output_texture, id.xy, postprocess(id.xy));
+}
+
+)";
+
+/// Entry points of the fragment path of `Postprocessor`, drawing one triangle over the target.
+const std::string_view POSTPROCESS_FRAGMENT_SHADER_CODE = R"(
+
+@vertex fn vs_main(@builtin(vertex_index) i: u32) -> @builtin(position) vec4<f32> {
+    let uv = vec2<f32>(f32((i << 1u) & 2u), f32(i & 2u));
+    return vec4<f32>(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+
+@fragment fn fs_main(@builtin(position) position: vec4<f32>) -> @location(0) vec4<f32> {
+    return postprocess(vec2<u32>(position.xy));
+}
+
+)";
+
+/// Shades the scene drawn onto `Input` textures, with the background where nothing was drawn, and
+/// writes the result onto the target of the frame, usually the swapchain texture.
+///
+/// The result is written in one full-screen pass, by the first path the target supports:
+/// - `Path::Storage`: a compute pass writing the target as a storage texture, if it has
+///   `wgpu::TextureUsage::StorageBinding` and a format writable as a storage texture.
+/// - `Path::Fragment`: a fragment pass rendering straight into the target.
+/// - `Path::Blit`: a compute pass writing an intermediate RGBA8 texture, blitted onto the target by
+///   a second pass. Only used if the fused paths are disabled with `set_fused`.
 class Postprocessor {
+  public:
+    enum class Path {
+        Storage,
+        Fragment,
+        Blit,
+    };
+
+  private:
     wgpu::Device device;
     wgpu::Queue queue;
 
-    Canvas input_canvas;
-    Canvas output_canvas;
+    uint32_t width = 0;
+    uint32_t height = 0;
 
     /// Input textures.
-    wgpu::BindGroup bind_group_0;
-    /// Output textures.
-    wgpu::BindGroup bind_group_1;
-    /// Other bindings.
-    wgpu::BindGroup bind_group_2;
+    wgpu::BindGroupLayout input_bind_group_layout;
+    wgpu::BindGroup input_bind_group;
+    /// Uniforms.
+    wgpu::BindGroupLayout uniform_bind_group_layout;
+    wgpu::BindGroup uniform_bind_group;
+    /// Output storage texture of the compute paths.
+    wgpu::BindGroupLayout output_bind_group_layout;
+    wgpu::BindGroup output_bind_group;
+
+    /// Views that bind groups were created with, re-created when the render graph backs the
+    /// textures with other pooled textures, or with the next swapchain texture.
+    wgpu::TextureView bound_input_color;
+    wgpu::TextureView bound_input_depth;
+    wgpu::TextureView bound_output;
 
     wgpu::Buffer uniform_screen_extend;
     wgpu::Buffer uniform_srgb_output;
 
-    wgpu::ComputePipeline pipeline;
-
+    bool fused = true;
+    Path path = Path::Blit;
+    /// Format of the target that the pipeline of `path` was created for.
+    wgpu::TextureFormat target_format = wgpu::TextureFormat::Undefined;
+    wgpu::ComputePipeline compute_pipeline;
+    wgpu::RenderPipeline render_pipeline;
     TextureBlitter blitter;
-    wgpu::TextureFormat previous_output_format = wgpu::TextureFormat::Undefined;
 
   public:
+    /// Formats of the textures that the scene is drawn onto.
+    static constexpr auto INPUT_FORMAT = CanvasFormat {
+        .color_format = wgpu::TextureFormat::RGBA16Float,
+        .depth_stencil_format = wgpu::TextureFormat::Depth32Float,
+    };
+
+    /// Transient textures of a frame that the scene is drawn onto.
+    struct Input {
+        RenderGraphResource color;
+        RenderGraphResource depth;
+    };
+
     Postprocessor() = default;
 
-    Postprocessor(
-        wgpu::Device device,
-        wgpu::Queue queue,
-        uint32_t width,
-        uint32_t height,
-        bool srgb_output
-    )
+    Postprocessor(wgpu::Device device, wgpu::Queue queue, uint32_t width, uint32_t height)
         : device(std::move(device))
-        , queue(std::move(queue)) {
-        this->input_canvas = Canvas(
-            this->device,
-            {
-                .width = width,
-                .height = height,
-                .color_format = wgpu::TextureFormat::RGBA16Float,
-                .create_depth_stencil_texture = true,
-                .depth_stencil_format = wgpu::TextureFormat::Depth32Float,
-                .texture_usages = wgpu::TextureUsage::CopySrc | wgpu::TextureUsage::CopyDst |
-                                  wgpu::TextureUsage::RenderAttachment |
-                                  wgpu::TextureUsage::TextureBinding,
-            }
-        );
-        this->output_canvas = Canvas(
-            this->device,
-            {
-                .width = width,
-                .height = height,
-                .color_format = wgpu::TextureFormat::RGBA8Unorm,
-                .create_depth_stencil_texture = false,
-                .texture_usages = wgpu::TextureUsage::CopySrc | wgpu::TextureUsage::CopyDst |
-                                  wgpu::TextureUsage::StorageBinding |
-                                  wgpu::TextureUsage::TextureBinding,
-            }
-        );
-
+        , queue(std::move(queue))
+        , width(width)
+        , height(height) {
         auto uniform_screen_extend_descriptor = wgpu::BufferDescriptor {
             .label = "screen_extend",
             .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
@@ -150,10 +194,11 @@ class Postprocessor {
         };
         this->uniform_screen_extend = this->device.CreateBuffer(&uniform_screen_extend_descriptor);
 
-        auto screen_extend = glm::uvec2(this->output_canvas.width, this->output_canvas.height);
+        auto screen_extend = glm::uvec2(this->width, this->height);
         this->queue
             .WriteBuffer(this->uniform_screen_extend, 0, &screen_extend, sizeof(screen_extend));
 
+        // Written once the format of the target is known.
         auto uniform_srgb_output_descriptor = wgpu::BufferDescriptor {
             .label = "srgb_output",
             .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
@@ -161,56 +206,21 @@ class Postprocessor {
         };
         this->uniform_srgb_output = this->device.CreateBuffer(&uniform_srgb_output_descriptor);
 
-        auto srgb_output_ = (uint32_t)srgb_output;
-        this->queue
-            .WriteBuffer(this->uniform_screen_extend, 0, &srgb_output_, sizeof(srgb_output_));
-
         auto input_texture_formats = std::array {
-            this->input_canvas.format.color_format,
-            this->input_canvas.format.depth_stencil_format,
+            INPUT_FORMAT.color_format,
+            INPUT_FORMAT.depth_stencil_format,
         };
-        auto bind_group_0_layout = create_texture_bind_group_layout(
+        this->input_bind_group_layout = create_texture_bind_group_layout(
             this->device,
             input_texture_formats,
             true,
             "Postprocessor input"sv
         );
-        auto input_texture_views = std::array {
-            this->input_canvas.color_texture_view,
-            this->input_canvas.depth_stencil_texture_view,
-        };
-        assert(this->input_canvas.color_texture_view != nullptr);
-        assert(this->input_canvas.depth_stencil_texture_view != nullptr);
-        this->bind_group_0 = create_texture_bind_group(
-            this->device,
-            bind_group_0_layout,
-            input_texture_views,
-            "Postprocessor input"sv
-        );
 
-        auto output_texture_formats = std::array {
-            this->output_canvas.format.color_format,
-        };
-        auto output_texture_views = std::array {
-            this->output_canvas.color_texture_view,
-        };
-        auto bind_group_1_layout = create_texture_bind_group_layout(
-            this->device,
-            output_texture_formats,
-            false,
-            "Postprocessor output"sv
-        );
-        this->bind_group_1 = create_texture_bind_group(
-            this->device,
-            bind_group_1_layout,
-            output_texture_views,
-            "Postprocessor output"sv
-        );
-
-        auto bind_group_2_layout_entries = std::array {
+        auto uniform_bind_group_layout_entries = std::array {
             wgpu::BindGroupLayoutEntry {
                 .binding = 0,
-                .visibility = wgpu::ShaderStage::Compute,
+                .visibility = wgpu::ShaderStage::Compute | wgpu::ShaderStage::Fragment,
                 .buffer =
                     wgpu::BufferBindingLayout {
                         .type = wgpu::BufferBindingType::Uniform,
@@ -220,7 +230,7 @@ class Postprocessor {
             },
             wgpu::BindGroupLayoutEntry {
                 .binding = 1,
-                .visibility = wgpu::ShaderStage::Compute,
+                .visibility = wgpu::ShaderStage::Compute | wgpu::ShaderStage::Fragment,
                 .buffer =
                     wgpu::BufferBindingLayout {
                         .type = wgpu::BufferBindingType::Uniform,
@@ -229,14 +239,14 @@ class Postprocessor {
                     },
             },
         };
-        auto bind_group_2_layout_descriptor = wgpu::BindGroupLayoutDescriptor {
+        auto uniform_bind_group_layout_descriptor = wgpu::BindGroupLayoutDescriptor {
             .label = "Postprocessor uniforms"sv,
-            .entryCount = bind_group_2_layout_entries.size(),
-            .entries = bind_group_2_layout_entries.data(),
+            .entryCount = uniform_bind_group_layout_entries.size(),
+            .entries = uniform_bind_group_layout_entries.data(),
         };
-        auto bind_group_2_layout =
-            this->device.CreateBindGroupLayout(&bind_group_2_layout_descriptor);
-        auto bind_group_2_entries = std::array {
+        this->uniform_bind_group_layout =
+            this->device.CreateBindGroupLayout(&uniform_bind_group_layout_descriptor);
+        auto uniform_bind_group_entries = std::array {
             wgpu::BindGroupEntry {
                 .binding = 0,
                 .buffer = this->uniform_screen_extend,
@@ -250,18 +260,220 @@ class Postprocessor {
                 .size = this->uniform_srgb_output.GetSize(),
             },
         };
-        auto bind_group_2_descriptor = wgpu::BindGroupDescriptor {
+        auto uniform_bind_group_descriptor = wgpu::BindGroupDescriptor {
             .label = "Postprocessor uniforms"sv,
-            .layout = bind_group_2_layout,
-            .entryCount = bind_group_2_entries.size(),
-            .entries = bind_group_2_entries.data(),
+            .layout = this->uniform_bind_group_layout,
+            .entryCount = uniform_bind_group_entries.size(),
+            .entries = uniform_bind_group_entries.data(),
+        };
+        this->uniform_bind_group = this->device.CreateBindGroup(&uniform_bind_group_descriptor);
+    }
+
+    /// With `false`, results go through the intermediate texture of `Path::Blit`. `true` by
+    /// default.
+    void set_fused(bool fused) {
+        this->fused = fused;
+        this->target_format = wgpu::TextureFormat::Undefined;
+    }
+
+    /// Keeps pipelines and layouts. Bind groups follow the render targets backing the textures of
+    /// the next frame.
+    void resize(uint32_t width, uint32_t height) {
+        this->width = width;
+        this->height = height;
+        auto screen_extend = glm::uvec2(this->width, this->height);
+        this->queue
+            .WriteBuffer(this->uniform_screen_extend, 0, &screen_extend, sizeof(screen_extend));
+        if (this->blitter != nullptr) {
+            this->blitter.resize(this->width, this->height);
+        }
+    }
+
+    Input create_input_textures(RenderGraph& graph) const {
+        auto usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::TextureBinding;
+        auto color = graph.create_texture(
+            "Scene Color"sv,
+            {
+                .width = this->width,
+                .height = this->height,
+                .format = INPUT_FORMAT.color_format,
+                .usage = usage,
+            }
+        );
+        auto depth = graph.create_texture(
+            "Scene Depth"sv,
+            {
+                .width = this->width,
+                .height = this->height,
+                .format = INPUT_FORMAT.depth_stencil_format,
+                .usage = usage,
+            }
+        );
+        return Input {
+            .color = color,
+            .depth = depth,
         };
-        this->bind_group_2 = this->device.CreateBindGroup(&bind_group_2_descriptor);
+    }
+
+    /// Adds the passes shading `input` onto `result`, a texture of the same size.
+    void add_passes(RenderGraph& graph, const Input& input, RenderGraphResource result) {
+        const auto& result_info = graph.get_texture_info(result);
+        if (this->target_format != result_info.format) {
+            this->create_pipelines(result_info);
+        }
+
+        switch (this->path) {
+        case Path::Storage: {
+            auto postprocess = [this, input, result](
+                                   wgpu::CommandEncoder& encoder,
+                                   const RenderGraph& graph
+                               ) {
+                this->update_input_bind_group(graph, input);
+                this->update_output_bind_group(graph.get_texture_view(result));
+                this->encode_compute_pass(encoder);
+            };
+            graph.add_pass({
+                .name = "Postprocess"sv,
+                .reads = {input.color, input.depth},
+                .writes = {result},
+                .execute = postprocess,
+            });
+        } break;
+        case Path::Fragment: {
+            auto postprocess = [this, input, result](
+                                   wgpu::CommandEncoder& encoder,
+                                   const RenderGraph& graph
+                               ) {
+                this->update_input_bind_group(graph, input);
+                // Every texel is drawn over, so the previous content is not loaded.
+                auto color_attachment = wgpu::RenderPassColorAttachment {
+                    .view = graph.get_texture_view(result),
+                    .loadOp = wgpu::LoadOp::Clear,
+                    .storeOp = wgpu::StoreOp::Store,
+                    .clearValue = wgpu::Color {0.0, 0.0, 0.0, 0.0},
+                };
+                auto render_pass_descriptor = wgpu::RenderPassDescriptor {
+                    .label = "Postprocess"sv,
+                    .colorAttachmentCount = 1,
+                    .colorAttachments = &color_attachment,
+                };
+                auto render_pass = encoder.BeginRenderPass(&render_pass_descriptor);
+                render_pass.SetPipeline(this->render_pipeline);
+                render_pass.SetBindGroup(0, this->input_bind_group);
+                render_pass.SetBindGroup(1, this->uniform_bind_group);
+                render_pass.Draw(3);
+                render_pass.End();
+            };
+            graph.add_pass({
+                .name = "Postprocess"sv,
+                .reads = {input.color, input.depth},
+                .writes = {result},
+                .execute = postprocess,
+            });
+        } break;
+        case Path::Blit: {
+            // Every texel is written by the compute pass, so the output does not need a clear.
+            auto output = graph.create_texture(
+                "Postprocessor Output"sv,
+                {
+                    .width = this->width,
+                    .height = this->height,
+                    .format = wgpu::TextureFormat::RGBA8Unorm,
+                    .usage =
+                        wgpu::TextureUsage::StorageBinding | wgpu::TextureUsage::TextureBinding,
+                }
+            );
+            auto postprocess = [this, input, output](
+                                   wgpu::CommandEncoder& encoder,
+                                   const RenderGraph& graph
+                               ) {
+                this->update_input_bind_group(graph, input);
+                this->update_output_bind_group(graph.get_texture_view(output));
+                this->encode_compute_pass(encoder);
+            };
+            graph.add_pass({
+                .name = "Postprocess"sv,
+                .reads = {input.color, input.depth},
+                .writes = {output},
+                .execute = postprocess,
+            });
+
+            auto blit = [this, output, result](
+                            wgpu::CommandEncoder& encoder,
+                            const RenderGraph& graph
+                        ) {
+                this->blitter
+                    .blit(encoder, graph.get_texture_view(output), graph.get_texture_view(result));
+            };
+            graph.add_pass({
+                .name = "Blit"sv,
+                .reads = {output},
+                .writes = {result},
+                .execute = blit,
+            });
+        } break;
+        }
+    }
+
+    /// Must be called once per frame, after the passes of `add_passes` are executed.
+    void end_frame() {
+        if (this->blitter != nullptr) {
+            this->blitter.trim();
+        }
+    }
+
+  private:
+    /// Picks the path for targets of `target_info`, and creates its pipeline.
+    void create_pipelines(const RenderTargetInfo& target_info) {
+        this->target_format = target_info.format;
+        auto srgb_output = (uint32_t)format_is_srgb(target_info.format);
+        this->queue.WriteBuffer(this->uniform_srgb_output, 0, &srgb_output, sizeof(srgb_output));
+
+        auto storage_format = storage_texel_format(this->device, target_info.format);
+        if (this->fused && !storage_format.empty() &&
+            (target_info.usage & wgpu::TextureUsage::StorageBinding)) {
+            this->path = Path::Storage;
+            this->create_compute_pipeline(target_info.format, storage_format);
+        } else if (this->fused && (target_info.usage & wgpu::TextureUsage::RenderAttachment)) {
+            this->path = Path::Fragment;
+            this->create_render_pipeline(target_info.format);
+        } else {
+            this->path = Path::Blit;
+            this->create_compute_pipeline(wgpu::TextureFormat::RGBA8Unorm, "rgba8unorm"sv);
+            this->blitter = TextureBlitter(
+                this->device,
+                this->queue,
+                {
+                    .src_format = wgpu::TextureFormat::RGBA8Unorm,
+                    .dst_format = target_info.format,
+                    .width = this->width,
+                    .height = this->height,
+                }
+            );
+        }
+        auto path_names = std::array {"storage"sv, "fragment"sv, "blit"sv};
+        log_verbose(
+            "postprocessing onto {} with the {} path",
+            fmt::streamed(target_info.format),
+            path_names[(size_t)this->path]
+        );
+    }
+
+    void create_compute_pipeline(wgpu::TextureFormat output_format, std::string_view wgsl_format) {
+        auto output_texture_formats = std::array {output_format};
+        this->output_bind_group_layout = create_texture_bind_group_layout(
+            this->device,
+            output_texture_formats,
+            false,
+            "Postprocessor output"sv
+        );
+        this->output_bind_group = nullptr;
+        this->bound_output = nullptr;
 
         auto bind_group_layouts = std::array {
-            bind_group_0_layout,
-            bind_group_1_layout,
-            bind_group_2_layout,
+            this->input_bind_group_layout,
+            this->uniform_bind_group_layout,
+            this->output_bind_group_layout,
         };
         auto pipeline_layout_descriptor = wgpu::PipelineLayoutDescriptor {
             .label = "Postprocessor"sv,
@@ -270,9 +482,13 @@ class Postprocessor {
         };
         auto pipeline_layout = this->device.CreatePipelineLayout(&pipeline_layout_descriptor);
 
+        auto entry_point = std::string(POSTPROCESS_COMPUTE_SHADER_CODE);
+        auto format_position = entry_point.find("OUTPUT_FORMAT");
+        entry_point.replace(format_position, "OUTPUT_FORMAT"sv.size(), wgsl_format);
+        auto code = std::string(POSTPROCESS_SHADER_CODE) + entry_point;
         auto shader_source = wgpu::ShaderSourceWGSL({
             .nextInChain = nullptr,
-            .code = wgpu::StringView(POSTPROCESS_SHADER_CODE),
+            .code = wgpu::StringView(code),
         });
         auto shader_module_descriptor = wgpu::ShaderModuleDescriptor {
             .nextInChain = &shader_source,
@@ -280,10 +496,6 @@ class Postprocessor {
         };
         auto shader_module = this->device.CreateShaderModule(&shader_module_descriptor);
 
-        auto bind_groups = std::array {
-            this->bind_group_0,
-            this->bind_group_1,
-        };
         auto compute_state = wgpu::ComputeState {
             .module = shader_module,
             .entryPoint = "main"sv,
@@ -295,52 +507,109 @@ class Postprocessor {
             .layout = pipeline_layout,
             .compute = compute_state,
         };
-        this->pipeline = this->device.CreateComputePipeline(&pipeline_descriptor);
+        this->compute_pipeline = this->device.CreateComputePipeline(&pipeline_descriptor);
     }
 
-    Canvas get_input_canvas() const {
-        return this->input_canvas;
-    }
+    void create_render_pipeline(wgpu::TextureFormat target_format) {
+        auto bind_group_layouts = std::array {
+            this->input_bind_group_layout,
+            this->uniform_bind_group_layout,
+        };
+        auto pipeline_layout_descriptor = wgpu::PipelineLayoutDescriptor {
+            .label = "Postprocessor"sv,
+            .bindGroupLayoutCount = bind_group_layouts.size(),
+            .bindGroupLayouts = bind_group_layouts.data(),
+        };
+        auto pipeline_layout = this->device.CreatePipelineLayout(&pipeline_layout_descriptor);
 
-    void run_postprocess_onto(Canvas result_canvas) {
-        if (this->previous_output_format != result_canvas.format.color_format) {
-            this->blitter = TextureBlitter(
-                this->device,
-                this->queue,
-                {
-                    .src_format = wgpu::TextureFormat::RGBA8Unorm,
-                    .dst_format = result_canvas.format.color_format,
-                    .width = this->output_canvas.width,
-                    .height = this->output_canvas.height,
-                }
-            );
-            this->previous_output_format = result_canvas.format.color_format;
-        }
+        auto code =
+            std::string(POSTPROCESS_SHADER_CODE) + std::string(POSTPROCESS_FRAGMENT_SHADER_CODE);
+        auto shader_source = wgpu::ShaderSourceWGSL({
+            .nextInChain = nullptr,
+            .code = wgpu::StringView(code),
+        });
+        auto shader_module_descriptor = wgpu::ShaderModuleDescriptor {
+            .nextInChain = &shader_source,
+            .label = "Postprocessor"sv,
+        };
+        auto shader_module = this->device.CreateShaderModule(&shader_module_descriptor);
 
-        auto encoder = this->device.CreateCommandEncoder();
+        auto color_target = wgpu::ColorTargetState {
+            .format = target_format,
+            .writeMask = wgpu::ColorWriteMask::All,
+        };
+        auto fragment_state = wgpu::FragmentState {
+            .module = shader_module,
+            .entryPoint = "fs_main"sv,
+            .targetCount = 1,
+            .targets = &color_target,
+        };
+        auto pipeline_descriptor = wgpu::RenderPipelineDescriptor {
+            .label = "Postprocessor"sv,
+            .layout = pipeline_layout,
+            .vertex =
+                wgpu::VertexState {
+                    .module = shader_module,
+                    .entryPoint = "vs_main"sv,
+                    .bufferCount = 0,
+                },
+            .primitive =
+                wgpu::PrimitiveState {
+                    .topology = wgpu::PrimitiveTopology::TriangleList,
+                    .frontFace = wgpu::FrontFace::CCW,
+                    .cullMode = wgpu::CullMode::None,
+                },
+            .multisample = wgpu::MultisampleState {.count = 1},
+            .fragment = &fragment_state,
+        };
+        this->render_pipeline = this->device.CreateRenderPipeline(&pipeline_descriptor);
+    }
 
-        auto compute_pass = encoder.BeginComputePass();
-        compute_pass.SetPipeline(this->pipeline);
-        compute_pass.SetBindGroup(0, this->bind_group_0);
-        compute_pass.SetBindGroup(1, this->bind_group_1);
-        compute_pass.SetBindGroup(2, this->bind_group_2);
-        compute_pass.DispatchWorkgroups(
-            div_ceil(this->output_canvas.width, 16u),
-            div_ceil(this->output_canvas.height, 16u)
+    void update_input_bind_group(const RenderGraph& graph, const Input& input) {
+        auto input_color = graph.get_texture_view(input.color);
+        auto input_depth = graph.get_texture_view(input.depth);
+        if (this->bound_input_color.Get() == input_color.Get() &&
+            this->bound_input_depth.Get() == input_depth.Get()) {
+            return;
+        }
+        auto input_texture_views = std::array {input_color, input_depth};
+        this->input_bind_group = create_texture_bind_group(
+            this->device,
+            this->input_bind_group_layout,
+            input_texture_views,
+            "Postprocessor input"sv
         );
-        compute_pass.End();
+        this->bound_input_color = input_color;
+        this->bound_input_depth = input_depth;
+    }
 
-        this->blitter.blit(
-            encoder,
-            this->output_canvas.color_texture_view,
-            result_canvas.color_texture_view
+    void update_output_bind_group(const wgpu::TextureView& output) {
+        if (this->bound_output.Get() == output.Get()) {
+            return;
+        }
+        auto output_texture_views = std::array {output};
+        this->output_bind_group = create_texture_bind_group(
+            this->device,
+            this->output_bind_group_layout,
+            output_texture_views,
+            "Postprocessor output"sv
         );
+        this->bound_output = output;
+    }
 
-        auto command_buffer = encoder.Finish();
-        this->queue.Submit(1, &command_buffer);
+    void encode_compute_pass(wgpu::CommandEncoder& encoder) const {
+        auto compute_pass_descriptor = wgpu::ComputePassDescriptor {
+            .label = "Postprocess"sv,
+        };
+        auto compute_pass = encoder.BeginComputePass(&compute_pass_descriptor);
+        compute_pass.SetPipeline(this->compute_pipeline);
+        compute_pass.SetBindGroup(0, this->input_bind_group);
+        compute_pass.SetBindGroup(1, this->uniform_bind_group);
+        compute_pass.SetBindGroup(2, this->output_bind_group);
+        compute_pass.DispatchWorkgroups(div_ceil(this->width, 16u), div_ceil(this->height, 16u));
+        compute_pass.End();
     }
 
-  private:
     static wgpu::BindGroupLayout create_texture_bind_group_layout(
         const wgpu::Device& device,
         std::span<wgpu::TextureFormat> texture_formats,
@@ -378,7 +647,7 @@ class Postprocessor {
                 }
                 layout_entries.push_back(wgpu::BindGroupLayoutEntry {
                     .binding = binding_index,
-                    .visibility = wgpu::ShaderStage::Compute,
+                    .visibility = wgpu::ShaderStage::Compute | wgpu::ShaderStage::Fragment,
                     .texture =
                         wgpu::TextureBindingLayout {
                             .sampleType = sample_type,
@@ -426,15 +695,28 @@ class Postprocessor {
 };
 
 struct Application {
+    /// Holds the blob cache and the pipeline manifest of each adapter.
+    static constexpr auto CACHE_DIRECTORY = "cache"sv;
+
     wgpu::Instance instance;
     wgpu::Adapter adapter;
     wgpu::Device device;
     wgpu::Queue queue;
 
+    /// Compiled shaders and pipelines of previous runs.
+    std::unique_ptr<BlobCache> blob_cache;
+    /// Of `run`, until the first frame is submitted.
+    std::chrono::steady_clock::time_point start_time;
+    bool is_first_frame = true;
+
     Swapchain swapchain;
 
     std::shared_ptr<PerspectiveCamera> camera;
 
+    std::shared_ptr<JobSystem> jobs;
+    /// Parses models on workers of its own.
+    std::unique_ptr<AssetLoader> assets;
+
     Scene scene;
 
     EntityId entity0;
@@ -443,11 +725,34 @@ struct Application {
 
     GLFWwindow* window;
 
-    bool needs_resize = false;
+    /// Set from GLFW callbacks on the main thread, read by the render thread.
+    std::atomic<bool> needs_resize = false;
+    /// Width in the high 32 bits, height in the low 32 bits, so that both are read together.
+    std::atomic<uint64_t> framebuffer_size = 0;
+
+    /// Index of the material whose color is animated by the simulation, see
+    /// `Scene::add_snapshot_color_material`.
+    uint32_t material2 = 0;
+
+    /// Period of the simulation on its own thread.
+    static constexpr auto SIMULATION_TICK =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / 120.0)
+        );
+    /// From the simulation to the render thread.
+    TripleBuffer<SceneSnapshot> snapshots;
+    std::atomic<bool> rendering = false;
+    std::thread render_thread;
 
     Postprocessor postprocessor;
 
+    /// Render targets of the render graph, kept across frames and resizes.
+    std::shared_ptr<RenderTargetPool> render_target_pool;
+    /// Passes of the scene and of the postprocessor, submitted at once every frame.
+    RenderGraph render_graph;
+
     void run() {
+        this->start_time = std::chrono::steady_clock::now();
         this->initialize_wgpu();
         this->initialize_window_and_swapchain();
         this->initialize_postprocessor();
@@ -456,18 +761,59 @@ struct Application {
 #if defined(__EMSCRIPTEN__)
         emscripten_set_main_loop_arg(emscripten_main_loop, this, 0, true);
 #else
+        // The simulation stays on the main thread, where GLFW requires events to be processed, and
+        // hands snapshots of the scene over to the render thread, so that neither waits for the
+        // other: the simulation never blocks on `Submit` or presenting.
+        this->simulate();
+        this->rendering = true;
+        this->render_thread = std::thread([this] { this->render_main(); });
+        auto next_tick = std::chrono::steady_clock::now();
         while (!glfwWindowShouldClose(this->window)) {
-            glfwPollEvents();
-            this->draw_frame();
-            this->swapchain.present();
-            this->instance.ProcessEvents();
+            this->simulate();
+            // Ticks are skipped rather than caught up with if the simulation falls behind.
+            next_tick = std::max(next_tick + SIMULATION_TICK, std::chrono::steady_clock::now());
+            auto timeout = next_tick - std::chrono::steady_clock::now();
+            glfwWaitEventsTimeout(std::chrono::duration<double>(timeout).count());
         }
+        this->rendering = false;
+        this->render_thread.join();
+        this->scene.save_pipeline_manifest(this->pipeline_manifest_path());
 #endif
     }
 
+    std::filesystem::path pipeline_manifest_path() const {
+        return this->blob_cache->get_directory() / "pipelines.manifest";
+    }
+
+    /// Logs the time from `run` to the first submitted frame, telling cold from warm starts.
+    void report_startup() {
+        auto startup_time = std::chrono::steady_clock::now() - this->start_time;
+        auto cache_stats = this->blob_cache->stats();
+        auto pipeline_stats = this->scene.pipeline_cache_stats();
+        log_info(
+            "{} startup took {:.1f} ms: {} of {} blobs loaded, {} stored, {} pipelines warmed up",
+            this->blob_cache->is_warm() ? "warm"sv : "cold"sv,
+            std::chrono::duration<double, std::milli>(startup_time).count(),
+            cache_stats.hit_count,
+            cache_stats.load_count,
+            cache_stats.store_count,
+            pipeline_stats.warmed_up
+        );
+    }
+
     static void emscripten_main_loop(void* arg) {
         auto this_ = (Application*)arg;
+        this_->simulate();
         this_->draw_frame();
+        this_->instance.ProcessEvents();
+    }
+
+    void render_main() {
+        while (this->rendering) {
+            this->draw_frame();
+            this->swapchain.present();
+            this->instance.ProcessEvents();
+        }
     }
 
     void initialize_wgpu() {
@@ -499,8 +845,28 @@ struct Application {
         this->adapter.GetInfo(&adapter_info);
         log_info("GPU: {}", fmt::streamed(adapter_info.description));
 
-        // Device.
+        // Device, with shaders and pipelines cached on disk across runs.
+        this->blob_cache = std::make_unique<BlobCache>(CACHE_DIRECTORY, adapter_info);
         wgpu::DeviceDescriptor device_descriptor {};
+        device_descriptor.nextInChain = this->blob_cache->device_descriptor_chain();
+        auto device_features = std::vector<wgpu::FeatureName>();
+#if !defined(__EMSCRIPTEN__)
+        // Lets `Scene` record render bundles from several threads.
+        if (this->adapter.HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization)) {
+            device_features.push_back(wgpu::FeatureName::ImplicitDeviceSynchronization);
+        }
+#endif
+        // Lets `Scene` draw the groups of `CullingMode::Gpu` with indirect draws starting at their
+        // own first instance.
+        if (this->adapter.HasFeature(wgpu::FeatureName::IndirectFirstInstance)) {
+            device_features.push_back(wgpu::FeatureName::IndirectFirstInstance);
+        }
+        // Lets `Postprocessor` write BGRA8 swapchain textures directly from a compute pass.
+        if (this->adapter.HasFeature(wgpu::FeatureName::BGRA8UnormStorage)) {
+            device_features.push_back(wgpu::FeatureName::BGRA8UnormStorage);
+        }
+        device_descriptor.requiredFeatureCount = device_features.size();
+        device_descriptor.requiredFeatures = device_features.data();
         device_descriptor.SetUncapturedErrorCallback(
             [](const wgpu::Device&, wgpu::ErrorType error_type, wgpu::StringView message) {
                 log_error(
@@ -540,6 +906,9 @@ struct Application {
 
         // Queue.
         this->queue = this->device.GetQueue();
+
+        this->render_target_pool = std::make_shared<RenderTargetPool>(this->device);
+        this->render_graph = RenderGraph(this->device, this->queue, this->render_target_pool);
     }
 
     void initialize_window_and_swapchain() {
@@ -568,6 +937,7 @@ struct Application {
                 .create_depth_stencil_texture = false,
                 .prefer_srgb = false,
                 .prefer_float = false,
+                .allow_storage_binding = true,
             }
         );
 
@@ -577,8 +947,22 @@ struct Application {
     }
 
     void initialize_scene() {
-        this->scene =
-            Scene(this->device, this->queue, this->postprocessor.get_input_canvas().format);
+        this->scene = Scene(this->instance, this->device, this->queue, Postprocessor::INPUT_FORMAT);
+
+        // Workers and the main thread, one per hardware thread. Asset loads take a quarter of the
+        // hardware threads on top, so that they do not starve frames of the render and simulation
+        // threads while loading in the background.
+#if defined(__EMSCRIPTEN__)
+        auto worker_count = 0u;
+        auto asset_worker_count = 0u;
+#else
+        auto hardware_thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        auto worker_count = hardware_thread_count - 1;
+        auto asset_worker_count = std::max(hardware_thread_count / 4, 1u);
+#endif
+        this->jobs = std::make_shared<JobSystem>(worker_count);
+        this->scene.set_job_system(this->jobs);
+        this->assets = std::make_unique<AssetLoader>(asset_worker_count);
 
         this->camera = std::make_shared<PerspectiveCamera>();
         this->camera->position = glm::vec3(0, 0, 100);
@@ -586,25 +970,70 @@ struct Application {
 
         this->scene.set_camera(this->camera);
 
-        auto light_position = glm::vec3(400, 400, -400);
-        auto model0 = Model<uint32_t>::from_glb_file("assets/models/ico_sphere.glb");
-        assert(model0.check_indices_all_in_bounds());
-        auto geometry0 = std::make_shared<ModelGeometry>(this->device, this->queue, model0);
-        auto material0 =
-            std::make_shared<ColorMaterial>(this->device, this->queue, srgb(0.3, 0.6, 0.7));
-        material0->update_light_position(this->queue, light_position);
-        this->entity0 = this->scene.create_entity(geometry0, material0);
+        auto lights = std::array {
+            Light {
+                .position = glm::vec3(400, 400, -400),
+                .color = glm::vec3(1, 1, 1),
+            },
+        };
+        this->scene.set_lights(lights);
 
-        auto geometry1 = std::make_shared<BoxGeometry>(this->device, this->queue);
+        // Drawn while pipelines of new materials compile.
+        this->scene.set_fallback_material(std::make_shared<ColorMaterial>(
+            this->queue,
+            this->scene.get_uniform_arena(),
+            srgb(0.5, 0.5, 0.5)
+        ));
+
+        // Models are parsed on the workers of the loader, and uploaded on this thread, which keeps
+        // processing window events in the meantime.
+        auto load_start = std::chrono::steady_clock::now();
+        std::shared_ptr<ModelGeometry> geometry0;
+        std::shared_ptr<ModelGeometry> geometry2;
+        this->assets->load_model("assets/models/ico_sphere.glb", [&](Model<uint32_t> model) {
+            geometry0 = std::make_shared<ModelGeometry>(this->scene.get_geometry_pool(), model);
+        });
+        this->assets->load_model("assets/models/cat.glb", [&](Model<uint32_t> model) {
+            geometry2 = std::make_shared<ModelGeometry>(this->scene.get_geometry_pool(), model);
+        });
+
+        auto material0 = std::make_shared<ColorMaterial>(
+            this->queue,
+            this->scene.get_uniform_arena(),
+            srgb(0.3, 0.6, 0.7)
+        );
+
+        auto geometry1 = std::make_shared<BoxGeometry>();
         auto material1 = std::make_shared<UvDebugMaterial>();
-        this->entity1 = this->scene.create_entity(geometry1, material1);
 
-        auto model2 = Model<uint32_t>::from_glb_file("assets/models/cat.glb");
-        assert(model2.check_indices_all_in_bounds());
-        auto geometry2 = std::make_shared<ModelGeometry>(this->device, this->queue, model2);
-        auto material2 =
-            std::make_shared<ColorMaterial>(this->device, this->queue, srgb(0.8, 0.8, 0.8));
-        material2->update_light_position(this->queue, light_position);
+        auto material2 = std::make_shared<ColorMaterial>(
+            this->queue,
+            this->scene.get_uniform_arena(),
+            srgb(0.8, 0.8, 0.8)
+        );
+        this->material2 = this->scene.add_snapshot_color_material(material2);
+
+        while (!this->assets->is_idle()) {
+            if (this->assets->dispatch_loaded() == 0) {
+                glfwWaitEventsTimeout(0.005);
+            }
+        }
+        auto load_time = std::chrono::steady_clock::now() - load_start;
+        auto load_stats = this->assets->stats();
+        log_info(
+            "loaded {} models in {:.1f} ms, {:.1f} ms of loading on workers",
+            load_stats.dispatched_count,
+            std::chrono::duration<double, std::milli>(load_time).count(),
+            load_stats.load_seconds * 1e3
+        );
+
+        // Pipelines that the previous run created out of these geometries and materials.
+        auto geometries = std::array<const GeometryBase*, 2> {geometry0.get(), geometry1.get()};
+        auto materials = std::array<const MaterialBase*, 2> {material0.get(), material1.get()};
+        this->scene.warm_up_pipelines(this->pipeline_manifest_path(), geometries, materials);
+
+        this->entity0 = this->scene.create_entity(geometry0, material0);
+        this->entity1 = this->scene.create_entity(geometry1, material1);
         this->entity2 = this->scene.create_entity(geometry2, material2);
     }
 
@@ -613,25 +1042,16 @@ struct Application {
             this->device,
             this->queue,
             this->swapchain.get_width(),
-            this->swapchain.get_height(),
-            format_is_srgb(this->swapchain.get_format().color_format)
+            this->swapchain.get_height()
         );
     }
 
-    void draw_frame() {
-        if (needs_resize) {
-            uint32_t width;
-            uint32_t height;
-            glfwGetFramebufferSize(this->window, (int32_t*)&width, (int32_t*)&height);
-            this->swapchain.reconfigure_for_size(width, height);
-            this->postprocessor = Postprocessor(
-                this->device,
-                this->queue,
-                this->swapchain.get_width(),
-                this->swapchain.get_height(),
-                format_is_srgb(this->swapchain.get_format().color_format)
-            );
-        }
+    /// Writes the state of animated entities at the current time into a snapshot, and publishes
+    /// it to the render thread.
+    void simulate() {
+        auto& snapshot = this->snapshots.get_back();
+        snapshot.entities.clear();
+        snapshot.color_materials.clear();
 
         double tau = glm::tau<double>();
         double t = unix_seconds();
@@ -641,14 +1061,19 @@ struct Application {
 
             auto size = glm::vec3(40, 40, 40);
             auto position = glm::vec3(-70, 0, 0);
-            auto model = glm::identity<glm::mat4x4>();
-
-            model = glm::translate(model, position);
-            model = glm::rotate(model, rotation - glm::pi<float>(), glm::vec3(1, 0, 0));
-            model = glm::rotate(model, rotation, glm::vec3(0, 1, 0));
-            model = glm::scale(model, size);
-
-            this->scene.get_entity(this->entity0).set_model(model);
+            auto orientation = glm::angleAxis(rotation - glm::pi<float>(), glm::vec3(1, 0, 0)) *
+                               glm::angleAxis(rotation, glm::vec3(0, 1, 0));
+
+            snapshot.entities.push_back(SceneSnapshot::EntityState {
+                .id = this->entity0,
+                .transform =
+                    Transform {
+                        .translation = position,
+                        .rotation = orientation,
+                        .scale = size,
+                    },
+                .hidden = false,
+            });
         }
 
         {
@@ -657,15 +1082,20 @@ struct Application {
 
             auto size = glm::vec3(30, 30, 30);
             auto position = glm::vec3(70, 0, 20);
-            auto model = glm::identity<glm::mat4x4>();
-
-            model = glm::translate(model, position);
-            model = glm::rotate(model, rotation - glm::pi<float>(), glm::vec3(1, 0, 0));
-            model = glm::rotate(model, rotation, glm::vec3(0, 1, 0));
-            model = glm::translate(model, -0.5f * size);
-            model = glm::scale(model, size);
-
-            this->scene.get_entity(this->entity1).set_model(model);
+            auto orientation = glm::angleAxis(rotation - glm::pi<float>(), glm::vec3(1, 0, 0)) *
+                               glm::angleAxis(rotation, glm::vec3(0, 1, 0));
+
+            // Rotates around the center of the box.
+            snapshot.entities.push_back(SceneSnapshot::EntityState {
+                .id = this->entity1,
+                .transform =
+                    Transform {
+                        .translation = position + orientation * (-0.5f * size),
+                        .rotation = orientation,
+                        .scale = size,
+                    },
+                .hidden = false,
+            });
         }
 
         {
@@ -674,30 +1104,89 @@ struct Application {
 
             auto size = glm::vec3(8, 8, 8);
             auto position = glm::vec3(0, -24, 0);
-            auto model = glm::identity<glm::mat4x4>();
 
-            model = glm::translate(model, position);
-            model = glm::rotate(model, rotation, glm::vec3(0, 1, 0));
-            model = glm::scale(model, size);
+            snapshot.entities.push_back(SceneSnapshot::EntityState {
+                .id = this->entity2,
+                .transform =
+                    Transform {
+                        .translation = position,
+                        .rotation = glm::angleAxis(rotation, glm::vec3(0, 1, 0)),
+                        .scale = size,
+                    },
+                .hidden = false,
+            });
+
+            // Fades between two colors.
+            double color_period = 8.0;
+            float blend = 0.5f + 0.5f * (float)sin(t * tau / color_period);
+            snapshot.color_materials.push_back(SceneSnapshot::ColorMaterialState {
+                .material = this->material2,
+                .color = glm::mix(srgb(0.8, 0.8, 0.8), srgb(0.9, 0.6, 0.3), blend),
+            });
+        }
 
-            this->scene.get_entity(this->entity2).set_model(model);
+        this->snapshots.publish();
+    }
+
+    /// Applies the latest snapshot of the simulation, and draws the scene.
+    void draw_frame() {
+        if (this->snapshots.consume()) {
+            this->scene.apply_snapshot(this->snapshots.get_front());
         }
+        // Models requested while running are uploaded on the render thread, which owns the scene.
+        this->assets->dispatch_loaded();
 
-        auto input_canvas = this->postprocessor.get_input_canvas();
-        this->scene.draw(input_canvas);
+        if (this->needs_resize.exchange(false)) {
+            auto size = this->framebuffer_size.load();
+            this->swapchain.reconfigure_for_size((uint32_t)(size >> 32), (uint32_t)size);
+            this->postprocessor.resize(this->swapchain.get_width(), this->swapchain.get_height());
+        }
 
-        this->postprocessor.run_postprocess_onto(this->swapchain.get_current_canvas());
+        auto result_canvas = this->swapchain.get_current_canvas();
+        auto result = this->render_graph.import_texture(
+            "Swapchain"sv,
+            result_canvas.get_color_texture(),
+            result_canvas.color_texture_view
+        );
+        auto input = this->postprocessor.create_input_textures(this->render_graph);
+        this->scene.add_passes(this->render_graph, input.color, input.depth);
+        this->postprocessor.add_passes(this->render_graph, input, result);
+        this->render_graph.execute();
+        this->postprocessor.end_frame();
+
+        if (std::exchange(this->is_first_frame, false)) {
+            this->report_startup();
+        }
     }
 
     static void window_resize_callback(GLFWwindow*, int32_t, int32_t) {}
 
-    static void framebuffer_resize_callback(GLFWwindow* window, int32_t, int32_t) {
+    static void framebuffer_resize_callback(GLFWwindow* window, int32_t width, int32_t height) {
         auto this_ = (Application*)glfwGetWindowUserPointer(window);
+        this_->framebuffer_size = ((uint64_t)(uint32_t)width << 32) | (uint32_t)height;
         this_->needs_resize = true;
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
+    // `app --benchmark-bvh [entity_count]`
+    if (argc >= 2 && argv[1] == "--benchmark-bvh"sv) {
+        auto entity_count = argc >= 3 ? (size_t)std::strtoull(argv[2], nullptr, 10) : 100'000;
+        log_level_scope(LogLevel::Info, [&] { run_bvh_benchmark(entity_count); });
+        return 0;
+    }
+    // `app --benchmark-transforms [entity_count]`
+    if (argc >= 2 && argv[1] == "--benchmark-transforms"sv) {
+        auto entity_count = argc >= 3 ? (size_t)std::strtoull(argv[2], nullptr, 10) : 100'000;
+        log_level_scope(LogLevel::Info, [&] { run_transform_benchmark(entity_count); });
+        return 0;
+    }
+    // `app --benchmark-jobs [entity_count]`
+    if (argc >= 2 && argv[1] == "--benchmark-jobs"sv) {
+        auto entity_count = argc >= 3 ? (size_t)std::strtoull(argv[2], nullptr, 10) : 100'000;
+        log_level_scope(LogLevel::Info, [&] { run_job_system_benchmark(entity_count); });
+        return 0;
+    }
     log_level_scope(LogLevel::Verbose, [&] {
         auto application = Application {};
         application.run();
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <glm/vec3.hpp>
+#include <vector>
 #include <webgpu/webgpu_cpp.h>
 
 #include "../object.hxx"
 #include "../shader_info.hxx"
+#include "../wgsl_layout.hxx"
 
-/// alignas(16) to be compatible with WGSL struct of the same topology.
+/// alignas(16) for the size of the WGSL struct, which is rounded up to the alignment of `vec3`.
 struct alignas(16) PhongParameters {
     float ambient_strength = 0.2;
     float diffuse_strength = 0.8;
@@ -15,17 +17,33 @@ struct alignas(16) PhongParameters {
     glm::vec3 light_color = glm::vec3(1.0, 1.0, 1.0);
 };
 
+inline constexpr auto PHONG_PARAMETERS_LAYOUT =
+    wgsl::struct_layout<PhongParameters, wgsl::Uniform>(
+        "PhongParameters",
+        WGSL_FIELD(PhongParameters, ambient_strength),
+        WGSL_FIELD(PhongParameters, diffuse_strength),
+        WGSL_FIELD(PhongParameters, specular_strength),
+        WGSL_FIELD(PhongParameters, specular_intensity),
+        WGSL_FIELD(PhongParameters, light_color)
+    );
+
+template <>
+struct wgsl::TypeOf<PhongParameters> : wgsl::StructType<PHONG_PARAMETERS_LAYOUT> {};
+
+/// Like geometries, the fragment shader module and bind group layout of a material must depend
+/// only on its dynamic type, as they are cached per device (see `PipelineCache`).
+///
+/// Camera, time and lights are in `FrameConstants` at group 0, the material's bind group is at
+/// group 2.
 struct MaterialBase : public ObjectBase {
     virtual ShaderInfo create_fragment_shader(const wgpu::Device& device) const;
 
+    virtual std::vector<wgpu::ConstantEntry> fragment_shader_constants() const;
+
     virtual wgpu::BindGroupLayout create_bind_group_layout(const wgpu::Device& device) const;
 
     virtual wgpu::BindGroup create_bind_group(
         const wgpu::Device& device,
         wgpu::BindGroupLayout layout
     ) const;
-
-    virtual void update_view_position(const wgpu::Queue& queue, glm::vec3 view_position);
-
-    virtual void update_light_position(const wgpu::Queue& queue, glm::vec3 light_position);
 };
@@ -1,53 +1,42 @@
 #include "color.hxx"
+#include "../frame_constants.hxx"
 
 using namespace std::literals;
 
 ColorMaterial::ColorMaterial(
-    const wgpu::Device& device,
     const wgpu::Queue& queue,
+    std::shared_ptr<UniformArena> arena,
     glm::vec3 fill_color
-) {
-    auto mat4x4_buffer_descriptor = wgpu::BufferDescriptor {
-        .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
-        .size = sizeof(float[4][4]),
-        .mappedAtCreation = false,
-    };
-    // They're all 4x4 matrices so can share the same descriptor.
-    this->color = device.CreateBuffer(&mat4x4_buffer_descriptor);
-    this->view_position = device.CreateBuffer(&mat4x4_buffer_descriptor);
-    this->light_position = device.CreateBuffer(&mat4x4_buffer_descriptor);
-
-    auto phong_buffer_descriptor = wgpu::BufferDescriptor {
-        .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
-        .size = sizeof(PhongParameters),
-        .mappedAtCreation = false,
-    };
-    this->phong = device.CreateBuffer(&phong_buffer_descriptor);
+)
+    : arena(std::move(arena)) {
+    this->uniforms = this->arena->allocate(COLOR_MATERIAL_UNIFORMS_LAYOUT.size);
 
-    queue.WriteBuffer(this->color, 0, &fill_color, sizeof(fill_color));
-
-    auto vec3_zero = glm::vec3(0, 0, 0);
-    queue.WriteBuffer(this->view_position, 0, &vec3_zero, sizeof(glm::vec3));
-    queue.WriteBuffer(this->light_position, 0, &vec3_zero, sizeof(glm::vec3));
-
-    auto phong_default = PhongParameters {};
-    queue.WriteBuffer(this->phong, 0, &phong_default, sizeof(phong_default));
+    this->set_color(queue, fill_color);
+    this->set_phong_parameters(queue, PhongParameters {});
 }
 
-void ColorMaterial::set_color(const wgpu::Queue& queue, glm::vec3 value) {
-    queue.WriteBuffer(this->color, 0, &value, sizeof(value));
+ColorMaterial::~ColorMaterial() {
+    if (this->arena != nullptr) {
+        this->arena->free(this->uniforms);
+    }
 }
 
-void ColorMaterial::update_view_position(const wgpu::Queue& queue, glm::vec3 value) {
-    queue.WriteBuffer(this->view_position, 0, &value, sizeof(value));
-}
-
-void ColorMaterial::update_light_position(const wgpu::Queue& queue, glm::vec3 value) {
-    queue.WriteBuffer(this->light_position, 0, &value, sizeof(value));
+void ColorMaterial::set_color(const wgpu::Queue& queue, glm::vec3 value) {
+    queue.WriteBuffer(
+        this->uniforms.buffer,
+        this->uniforms.offset + offsetof(ColorMaterialUniforms, color),
+        &value,
+        sizeof(value)
+    );
 }
 
 void ColorMaterial::set_phong_parameters(const wgpu::Queue& queue, PhongParameters value) {
-    queue.WriteBuffer(this->phong, 0, &value, sizeof(value));
+    queue.WriteBuffer(
+        this->uniforms.buffer,
+        this->uniforms.offset + offsetof(ColorMaterialUniforms, phong),
+        &value,
+        sizeof(value)
+    );
 }
 
 static std::string_view SHADER_CODE = R"(
@@ -59,51 +48,45 @@ struct VertexOut {
     @location(2) normal: vec3<f32>,
 };
 
-struct PhongParameters {
-    ambient_strength: f32,
-    diffuse_strength: f32,
-    specular_strength: f32,
-    specular_intensity: f32,
-    light_color: vec3<f32>,
-};
-
-@group(2) @binding(0) var<uniform> fill_color: vec3<f32>;
-@group(2) @binding(1) var<uniform> view_position: vec3<f32>;
-@group(2) @binding(2) var<uniform> light_position: vec3<f32>;
-@group(2) @binding(3) var<uniform> phong: PhongParameters;
+@group(2) @binding(0) var<uniform> material: ColorMaterialUniforms;
 
 @fragment fn main(input: VertexOut) -> @location(0) vec4<f32> {
     let normal = normalize(input.normal);
-    let light_direction = normalize(light_position - input.position_world);
-    let view_direction = normalize(view_position - input.position_world);
+    let view_direction = normalize(frame.view_position - input.position_world);
 
     // FIXME: parameterize parameters instead of hard coding them.
     let ambient_strength = 0.2;
     let diffuse_strength = 0.8;
     let specular_strength = 0.2;
     let specular_intensity = 64.0;
-    let light_color = vec3<f32>(1.0, 1.0, 1.0);
 
-    let ambient_term = ambient_strength * fill_color;
+    var color = ambient_strength * material.color;
 
-    let diffuse_term = diffuse_strength * (0.5 * dot(normal, light_direction) + 0.5) * fill_color;
+    for (var i = 0u; i < frame.light_count; i++) {
+        let light = frame.lights[i];
+        let light_direction = normalize(light.position - input.position_world);
 
-    let reflection_direction = reflect(-light_direction, normal);
-    var specular_factor = dot(view_direction, reflection_direction);
-    specular_factor = max(specular_factor, 0.0);
-    specular_factor = pow(specular_factor, specular_intensity);
-    let specular_term = specular_strength * specular_factor * light_color;
+        let diffuse_factor = 0.5 * dot(normal, light_direction) + 0.5;
+        color += diffuse_strength * diffuse_factor * material.color * light.color;
+
+        let reflection_direction = reflect(-light_direction, normal);
+        var specular_factor = dot(view_direction, reflection_direction);
+        specular_factor = max(specular_factor, 0.0);
+        specular_factor = pow(specular_factor, specular_intensity);
+        color += specular_strength * specular_factor * light.color;
+    }
 
-    let color = ambient_term + diffuse_term + specular_term;
     return vec4<f32>(color, 1.0);
 }
 
 )";
 
 ShaderInfo ColorMaterial::create_fragment_shader(const wgpu::Device& device) const {
+    auto code = frame_constants_wgsl() + PHONG_PARAMETERS_LAYOUT.declaration() +
+                COLOR_MATERIAL_UNIFORMS_LAYOUT.declaration() + std::string(SHADER_CODE);
     auto shader_source = wgpu::ShaderSourceWGSL({
         .nextInChain = nullptr,
-        .code = wgpu::StringView(SHADER_CODE),
+        .code = wgpu::StringView(code),
     });
     auto shader_module_descriptor = wgpu::ShaderModuleDescriptor {
         .nextInChain = &shader_source,
@@ -113,7 +96,6 @@ ShaderInfo ColorMaterial::create_fragment_shader(const wgpu::Device& device) con
 
     return ShaderInfo {
         .shader_module = shader_module,
-        .constants = {},
     };
 }
 
@@ -126,37 +108,7 @@ wgpu::BindGroupLayout ColorMaterial::create_bind_group_layout(const wgpu::Device
                 wgpu::BufferBindingLayout {
                     .type = wgpu::BufferBindingType::Uniform,
                     .hasDynamicOffset = false,
-                    .minBindingSize = sizeof(glm::vec3),
-                },
-        },
-        wgpu::BindGroupLayoutEntry {
-            .binding = 1,
-            .visibility = wgpu::ShaderStage::Fragment,
-            .buffer =
-                wgpu::BufferBindingLayout {
-                    .type = wgpu::BufferBindingType::Uniform,
-                    .hasDynamicOffset = false,
-                    .minBindingSize = sizeof(glm::vec3),
-                },
-        },
-        wgpu::BindGroupLayoutEntry {
-            .binding = 2,
-            .visibility = wgpu::ShaderStage::Fragment,
-            .buffer =
-                wgpu::BufferBindingLayout {
-                    .type = wgpu::BufferBindingType::Uniform,
-                    .hasDynamicOffset = false,
-                    .minBindingSize = sizeof(glm::vec3),
-                },
-        },
-        wgpu::BindGroupLayoutEntry {
-            .binding = 3,
-            .visibility = wgpu::ShaderStage::Fragment,
-            .buffer =
-                wgpu::BufferBindingLayout {
-                    .type = wgpu::BufferBindingType::Uniform,
-                    .hasDynamicOffset = false,
-                    .minBindingSize = sizeof(PhongParameters),
+                    .minBindingSize = COLOR_MATERIAL_UNIFORMS_LAYOUT.size,
                 },
         },
     };
@@ -175,27 +127,9 @@ wgpu::BindGroup ColorMaterial::create_bind_group(
     auto entries = std::array {
         wgpu::BindGroupEntry {
             .binding = 0,
-            .buffer = this->color,
-            .offset = 0,
-            .size = sizeof(glm::vec3),
-        },
-        wgpu::BindGroupEntry {
-            .binding = 1,
-            .buffer = this->view_position,
-            .offset = 0,
-            .size = sizeof(glm::vec3),
-        },
-        wgpu::BindGroupEntry {
-            .binding = 2,
-            .buffer = this->light_position,
-            .offset = 0,
-            .size = sizeof(glm::vec3),
-        },
-        wgpu::BindGroupEntry {
-            .binding = 3,
-            .buffer = this->phong,
-            .offset = 0,
-            .size = sizeof(PhongParameters),
+            .buffer = this->uniforms.buffer,
+            .offset = this->uniforms.offset,
+            .size = COLOR_MATERIAL_UNIFORMS_LAYOUT.size,
         },
     };
     auto descriptor = wgpu::BindGroupDescriptor {
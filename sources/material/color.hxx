@@ -1,30 +1,45 @@
 #pragma once
 
+#include "../uniform_arena.hxx"
 #include "base.hxx"
 
 #include <glm/vec3.hpp>
+#include <memory>
 #include <webgpu/webgpu_cpp.h>
 
+/// Uniforms of `ColorMaterial`, at `@group(2) @binding(0)`.
+struct ColorMaterialUniforms {
+    glm::vec3 color;
+    PhongParameters phong;
+};
+
+inline constexpr auto COLOR_MATERIAL_UNIFORMS_LAYOUT =
+    wgsl::struct_layout<ColorMaterialUniforms, wgsl::Uniform>(
+        "ColorMaterialUniforms",
+        WGSL_FIELD(ColorMaterialUniforms, color),
+        WGSL_FIELD(ColorMaterialUniforms, phong)
+    );
+
+/// Uniforms are a slot of a `UniformArena`, freed on destruction.
 class ColorMaterial : public MaterialBase {
-    wgpu::Buffer color;          // uniform, binding 0, vec3<f32>
-    wgpu::Buffer view_position;  // uniform, binding 1, vec3<f32>
-    wgpu::Buffer light_position; // uniform, binding 2, vec3<f32>
-    wgpu::Buffer phong;          // uniform, binding 3, PhongParameters
+    std::shared_ptr<UniformArena> arena = nullptr;
+    UniformArena::Slot uniforms = {};
 
   public:
     ColorMaterial() = default;
 
     ColorMaterial(
-        const wgpu::Device& device,
         const wgpu::Queue& queue,
+        std::shared_ptr<UniformArena> arena,
         glm::vec3 fill_color = glm::vec3(1, 1, 1)
     );
 
-    void set_color(const wgpu::Queue& queue, glm::vec3 value);
+    ColorMaterial(const ColorMaterial&) = delete;
+    ColorMaterial& operator=(const ColorMaterial&) = delete;
 
-    void update_view_position(const wgpu::Queue& queue, glm::vec3 view_position) override;
+    ~ColorMaterial() override;
 
-    void update_light_position(const wgpu::Queue& queue, glm::vec3 light_position) override;
+    void set_color(const wgpu::Queue& queue, glm::vec3 value);
 
     void set_phong_parameters(const wgpu::Queue& queue, PhongParameters value);
 
@@ -32,6 +47,8 @@ class ColorMaterial : public MaterialBase {
 
     wgpu::BindGroupLayout create_bind_group_layout(const wgpu::Device& device) const override;
 
-    wgpu::BindGroup create_bind_group(const wgpu::Device& device, wgpu::BindGroupLayout layout)
-        const override;
+    wgpu::BindGroup create_bind_group(
+        const wgpu::Device& device,
+        wgpu::BindGroupLayout layout
+    ) const override;
 };
@@ -37,7 +37,6 @@ ShaderInfo UvDebugMaterial::create_fragment_shader(const wgpu::Device& device) c
 
     return ShaderInfo {
         .shader_module = shader_module,
-        .constants = {},
     };
 }
 
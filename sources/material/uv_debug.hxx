@@ -8,6 +8,8 @@ class UvDebugMaterial : public MaterialBase {
 
     wgpu::BindGroupLayout create_bind_group_layout(const wgpu::Device& device) const override;
 
-    wgpu::BindGroup create_bind_group(const wgpu::Device& device, wgpu::BindGroupLayout layout)
-        const override;
+    wgpu::BindGroup create_bind_group(
+        const wgpu::Device& device,
+        wgpu::BindGroupLayout layout
+    ) const override;
 };
@@ -0,0 +1,373 @@
+#include <fmt/format.h>
+#include <cassert>
+#include <chrono>
+#include <fstream>
+
+#include "pipeline_cache.hxx"
+#include "log.hxx"
+
+using namespace std::literals;
+
+template <class T>
+    requires std::is_trivially_copyable_v<T>
+static inline void append_bytes(std::string& bytes, const T& value) {
+    bytes.append((const char*)&value, sizeof(value));
+}
+
+static inline void append_bytes(std::string& bytes, wgpu::StringView string) {
+    auto string_view = std::string_view(string);
+    append_bytes(bytes, string_view.size());
+    bytes.append(string_view);
+}
+
+static inline void append_constants(
+    std::string& bytes,
+    const std::vector<wgpu::ConstantEntry>& constants
+) {
+    append_bytes(bytes, constants.size());
+    for (const auto& constant : constants) {
+        append_bytes(bytes, constant.key);
+        append_bytes(bytes, constant.value);
+    }
+}
+
+static inline std::string to_hex(std::string_view bytes) {
+    auto hex = std::string();
+    for (auto byte : bytes) {
+        fmt::format_to(std::back_inserter(hex), "{:02x}", (uint8_t)byte);
+    }
+    return hex;
+}
+
+size_t std::hash<RenderPipelineKey>::operator()(const RenderPipelineKey& key) const {
+    auto h = std::hash<std::type_index>()(key.geometry_type);
+    h ^= std::hash<std::type_index>()(key.material_type) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<std::string>()(key.descriptor_bytes) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+}
+
+PipelineCache::PipelineCache(
+    wgpu::Device device,
+    CanvasFormat surface_format,
+    wgpu::BindGroupLayout frame_bind_group_layout
+)
+    : device(std::move(device))
+    , surface_format(surface_format)
+    , frame_bind_group_layout(std::move(frame_bind_group_layout)) {}
+
+RenderPipelineKey PipelineCache::make_key(
+    const GeometryBase& geometry,
+    const MaterialBase& material
+) const {
+    auto bytes = std::string();
+
+    append_bytes(bytes, this->surface_format.color_format);
+    append_bytes(bytes, this->surface_format.depth_stencil_format);
+
+    auto vertex_buffer_layouts = geometry.vertex_buffer_layouts();
+    append_bytes(bytes, vertex_buffer_layouts.size());
+    for (const auto& layout : vertex_buffer_layouts) {
+        append_bytes(bytes, layout.stepMode);
+        append_bytes(bytes, layout.arrayStride);
+        append_bytes(bytes, layout.attributeCount);
+        for (size_t i = 0; i < layout.attributeCount; ++i) {
+            append_bytes(bytes, layout.attributes[i].format);
+            append_bytes(bytes, layout.attributes[i].offset);
+            append_bytes(bytes, layout.attributes[i].shaderLocation);
+        }
+    }
+
+    append_constants(bytes, geometry.vertex_shader_constants());
+    append_constants(bytes, material.fragment_shader_constants());
+
+    auto primitive = geometry.primitive_state();
+    append_bytes(bytes, primitive.topology);
+    append_bytes(bytes, primitive.stripIndexFormat);
+    append_bytes(bytes, primitive.frontFace);
+    append_bytes(bytes, primitive.cullMode);
+    append_bytes(bytes, primitive.unclippedDepth);
+
+    return RenderPipelineKey {
+        .geometry_type = std::type_index(typeid(geometry)),
+        .material_type = std::type_index(typeid(material)),
+        .descriptor_bytes = std::move(bytes),
+    };
+}
+
+const ShaderInfo& PipelineCache::vertex_shader_for(const GeometryBase& geometry) {
+    auto type = std::type_index(typeid(geometry));
+    auto iter = this->vertex_shaders.find(type);
+    if (iter == this->vertex_shaders.end()) {
+        ++this->stats_.shader_modules;
+        iter = this->vertex_shaders.emplace(type, geometry.create_vertex_shader(this->device)).first;
+    }
+    return iter->second;
+}
+
+const ShaderInfo& PipelineCache::fragment_shader_for(const MaterialBase& material) {
+    auto type = std::type_index(typeid(material));
+    auto iter = this->fragment_shaders.find(type);
+    if (iter == this->fragment_shaders.end()) {
+        ++this->stats_.shader_modules;
+        iter = this->fragment_shaders.emplace(type, material.create_fragment_shader(this->device))
+                   .first;
+    }
+    return iter->second;
+}
+
+wgpu::BindGroupLayout PipelineCache::geometry_bind_group_layout_for(const GeometryBase& geometry) {
+    auto type = std::type_index(typeid(geometry));
+    auto iter = this->geometry_bind_group_layouts.find(type);
+    if (iter == this->geometry_bind_group_layouts.end()) {
+        iter = this->geometry_bind_group_layouts
+                   .emplace(type, geometry.create_bind_group_layout(this->device))
+                   .first;
+    }
+    return iter->second;
+}
+
+wgpu::BindGroupLayout PipelineCache::material_bind_group_layout_for(const MaterialBase& material) {
+    auto type = std::type_index(typeid(material));
+    auto iter = this->material_bind_group_layouts.find(type);
+    if (iter == this->material_bind_group_layouts.end()) {
+        iter = this->material_bind_group_layouts
+                   .emplace(type, material.create_bind_group_layout(this->device))
+                   .first;
+    }
+    return iter->second;
+}
+
+CachedRenderPipeline PipelineCache::get_or_create(
+    const GeometryBase& geometry,
+    const MaterialBase& material,
+    bool async
+) {
+    auto key = this->make_key(geometry, material);
+    if (auto iter = this->pipelines.find(key); iter != this->pipelines.end()) {
+        ++this->stats_.hits;
+        // Compiled again rather than waited for, the asynchronous result is then dropped.
+        if (!async && iter->second.pipeline == nullptr) {
+            this->create_pipeline(iter->second, geometry, material, false);
+        }
+        return iter->second;
+    }
+    ++this->stats_.misses;
+    return this->insert_pipeline(std::move(key), geometry, material, async);
+}
+
+CachedRenderPipeline& PipelineCache::insert_pipeline(
+    RenderPipelineKey key,
+    const GeometryBase& geometry,
+    const MaterialBase& material,
+    bool async
+) {
+    auto cached = CachedRenderPipeline {
+        .id = (uint32_t)this->pipelines.size(),
+        .pipeline = nullptr,
+        .geometry_bind_group_layout = this->geometry_bind_group_layout_for(geometry),
+        .material_bind_group_layout = this->material_bind_group_layout_for(material),
+    };
+    log_verbose(
+        "creating render pipeline #{} ({} + {}){}",
+        cached.id,
+        key.geometry_type.name(),
+        key.material_type.name(),
+        async ? " asynchronously"sv : ""sv
+    );
+    this->compile_seconds_.push_back(-1.0);
+    this->create_pipeline(cached, geometry, material, async);
+    auto& inserted = this->pipelines.emplace(std::move(key), cached).first->second;
+    this->pipelines_by_id.push_back(&inserted);
+    return inserted;
+}
+
+void PipelineCache::create_pipeline(
+    CachedRenderPipeline& cached,
+    const GeometryBase& geometry,
+    const MaterialBase& material,
+    bool async
+) {
+    // Pipeline Layout.
+    auto bind_group_layouts = std::array {
+        this->frame_bind_group_layout,
+        cached.geometry_bind_group_layout,
+        cached.material_bind_group_layout,
+    };
+    auto pipeline_layout_descriptor = wgpu::PipelineLayoutDescriptor {
+        .bindGroupLayoutCount = bind_group_layouts.size(),
+        .bindGroupLayouts = bind_group_layouts.data(),
+    };
+    auto pipeline_layout = this->device.CreatePipelineLayout(&pipeline_layout_descriptor);
+
+    // Pipeline.
+    const auto& vertex_shader = this->vertex_shader_for(geometry);
+    auto vertex_constants = geometry.vertex_shader_constants();
+    auto vertex_buffer_layouts = geometry.vertex_buffer_layouts();
+    auto vertex_state = wgpu::VertexState {
+        .module = vertex_shader.shader_module,
+        .entryPoint = wgpu::StringView(vertex_shader.entry_point),
+        .constantCount = vertex_constants.size(),
+        .constants = vertex_constants.data(),
+        .bufferCount = vertex_buffer_layouts.size(),
+        .buffers = vertex_buffer_layouts.data(),
+    };
+    auto color_target_state = wgpu::ColorTargetState {
+        .format = this->surface_format.color_format,
+        .blend = nullptr,
+        .writeMask = wgpu::ColorWriteMask::All,
+    };
+    auto depth_stencil_state = wgpu::DepthStencilState {
+        .format = this->surface_format.depth_stencil_format,
+        .depthWriteEnabled = true,
+        .depthCompare = wgpu::CompareFunction::Less,
+    };
+    const auto& fragment_shader = this->fragment_shader_for(material);
+    auto fragment_constants = material.fragment_shader_constants();
+    auto fragment_state = wgpu::FragmentState {
+        .module = fragment_shader.shader_module,
+        .entryPoint = wgpu::StringView(fragment_shader.entry_point),
+        .constantCount = fragment_constants.size(),
+        .constants = fragment_constants.data(),
+        .targetCount = 1,
+        .targets = &color_target_state,
+    };
+    auto pipeline_descriptor = wgpu::RenderPipelineDescriptor {
+        .layout = pipeline_layout,
+        .vertex = vertex_state,
+        .primitive = geometry.primitive_state(),
+        .depthStencil = &depth_stencil_state,
+        .fragment = &fragment_state,
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    if (!async) {
+        cached.pipeline = this->device.CreateRenderPipeline(&pipeline_descriptor);
+        auto end = std::chrono::steady_clock::now();
+        this->compile_seconds_[cached.id] = std::chrono::duration<double>(end - start).count();
+        return;
+    }
+    ++this->stats_.pending;
+    auto on_compiled = [results = this->compiled_pipelines, id = cached.id, start](
+                           wgpu::CreatePipelineAsyncStatus status,
+                           wgpu::RenderPipeline pipeline,
+                           wgpu::StringView message
+                       ) {
+        if (status == wgpu::CreatePipelineAsyncStatus::ValidationError ||
+            status == wgpu::CreatePipelineAsyncStatus::InternalError) {
+            log_error("error creating render pipeline #{}: {}", id, std::string_view(message));
+            abort();
+        }
+        // Cancelled as the device goes away, still collected to count it as no longer pending.
+        if (status != wgpu::CreatePipelineAsyncStatus::Success) {
+            pipeline = nullptr;
+        }
+        auto end = std::chrono::steady_clock::now();
+        auto lock = std::lock_guard(results->mutex);
+        results->pipelines.push_back(CompiledPipeline {
+            .id = id,
+            .pipeline = std::move(pipeline),
+            .seconds = std::chrono::duration<double>(end - start).count(),
+        });
+    };
+    this->device.CreateRenderPipelineAsync(
+        &pipeline_descriptor,
+        wgpu::CallbackMode::AllowProcessEvents,
+        on_compiled
+    );
+}
+
+bool PipelineCache::collect_compiled() {
+    auto compiled = std::vector<CompiledPipeline>();
+    {
+        auto lock = std::lock_guard(this->compiled_pipelines->mutex);
+        std::swap(compiled, this->compiled_pipelines->pipelines);
+    }
+    for (auto& result : compiled) {
+        --this->stats_.pending;
+        auto& cached = *this->pipelines_by_id[result.id];
+        // Cancelled, or compiled again synchronously in the meantime.
+        if (result.pipeline == nullptr || cached.pipeline != nullptr) {
+            continue;
+        }
+        cached.pipeline = std::move(result.pipeline);
+        this->compile_seconds_[result.id] = result.seconds;
+        ++this->stats_.compiled_async;
+        this->stats_.max_compile_seconds =
+            std::max(this->stats_.max_compile_seconds, result.seconds);
+        log_verbose("compiled render pipeline #{} in {:.1f} ms", result.id, result.seconds * 1e3);
+    }
+    return !compiled.empty();
+}
+
+CachedRenderPipeline PipelineCache::get(uint32_t id) const {
+    assert(id < this->pipelines_by_id.size());
+    return *this->pipelines_by_id[id];
+}
+
+std::span<const double> PipelineCache::compile_seconds() const {
+    return this->compile_seconds_;
+}
+
+void PipelineCache::save_manifest(const std::filesystem::path& path) const {
+    auto keys = std::vector<const RenderPipelineKey*>(this->pipelines.size());
+    for (const auto& [key, cached] : this->pipelines) {
+        keys[cached.id] = &key;
+    }
+    auto stream = std::ofstream(path, std::ios::trunc);
+    for (const auto* key : keys) {
+        stream << key->geometry_type.name() << '\t' << key->material_type.name() << '\t'
+               << to_hex(key->descriptor_bytes) << '\n';
+    }
+    if (!stream) {
+        log_warn("cannot write pipeline manifest {}", path.string());
+        return;
+    }
+    log_verbose("saved {} pipelines into manifest {}", keys.size(), path.string());
+}
+
+void PipelineCache::warm_up(
+    const std::filesystem::path& path,
+    std::span<const GeometryBase* const> geometries,
+    std::span<const MaterialBase* const> materials
+) {
+    auto stream = std::ifstream(path);
+    if (!stream.is_open()) {
+        log_verbose("no pipeline manifest at {}, skipping warmup", path.string());
+        return;
+    }
+    size_t warmed_up = 0;
+    auto line = std::string();
+    while (std::getline(stream, line)) {
+        auto first_tab = line.find('\t');
+        auto second_tab = line.find('\t', first_tab + 1);
+        if (first_tab == std::string::npos || second_tab == std::string::npos) {
+            continue;
+        }
+        auto geometry_name = std::string_view(line).substr(0, first_tab);
+        auto material_name = std::string_view(line).substr(0, second_tab).substr(first_tab + 1);
+        auto descriptor_hex = std::string_view(line).substr(second_tab + 1);
+        for (const auto* geometry : geometries) {
+            if (typeid(*geometry).name() != geometry_name) {
+                continue;
+            }
+            for (const auto* material : materials) {
+                if (typeid(*material).name() != material_name) {
+                    continue;
+                }
+                // Not through `get_or_create`, so that warm-up does not count as hits or misses.
+                auto key = this->make_key(*geometry, *material);
+                if (to_hex(key.descriptor_bytes) == descriptor_hex &&
+                    !this->pipelines.contains(key)) {
+                    this->insert_pipeline(std::move(key), *geometry, *material, true);
+                    ++warmed_up;
+                }
+            }
+        }
+    }
+    this->stats_.warmed_up += warmed_up;
+    log_verbose("warmed up {} pipelines from {}", warmed_up, path.string());
+}
+
+PipelineCache::Stats PipelineCache::stats() const {
+    return this->stats_;
+}
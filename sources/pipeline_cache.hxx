@@ -0,0 +1,167 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+#include "canvas.hxx"
+#include "geometry/base.hxx"
+#include "material/base.hxx"
+
+/// Everything about a render pipeline that is shared between entities of the same geometry and
+/// material types.
+struct CachedRenderPipeline {
+    /// Dense, starting from 0, unique within one `PipelineCache`.
+    uint32_t id = 0;
+    /// Null while compiling asynchronously.
+    wgpu::RenderPipeline pipeline = nullptr;
+    wgpu::BindGroupLayout geometry_bind_group_layout = nullptr;
+    wgpu::BindGroupLayout material_bind_group_layout = nullptr;
+};
+
+/// Key of a render pipeline in `PipelineCache`.
+///
+/// Geometry and material types determine shader modules and bind group layouts, everything else
+/// that goes into the pipeline descriptor (vertex layout, shader constants, primitive state) is
+/// serialized into `descriptor_bytes`.
+struct RenderPipelineKey {
+    std::type_index geometry_type;
+    std::type_index material_type;
+    std::string descriptor_bytes;
+
+    bool operator==(const RenderPipelineKey&) const = default;
+};
+
+template <>
+struct std::hash<RenderPipelineKey> {
+    size_t operator()(const RenderPipelineKey& key) const;
+};
+
+/// Device-scoped cache of render pipelines, pipeline layouts, shader modules and bind group
+/// layouts, so that entities of the same geometry and material types share them instead of
+/// recompiling the same WGSL for every entity.
+///
+/// Pipelines may be compiled asynchronously, without stalling the frame that requests them. Their
+/// ID and bind group layouts are known right away, and the pipeline itself once `collect_compiled`
+/// picks it up after `wgpu::Instance::ProcessEvents` resolved its future.
+class PipelineCache {
+    struct CompiledPipeline {
+        uint32_t id;
+        wgpu::RenderPipeline pipeline;
+        double seconds;
+    };
+
+    /// Written by callbacks of asynchronous compilations, which may outlive a moved-from cache.
+    struct CompiledPipelines {
+        std::mutex mutex;
+        std::vector<CompiledPipeline> pipelines;
+    };
+
+    wgpu::Device device = nullptr;
+
+    CanvasFormat surface_format = {};
+    wgpu::BindGroupLayout frame_bind_group_layout = nullptr;
+
+    std::unordered_map<std::type_index, ShaderInfo> vertex_shaders = {};
+    std::unordered_map<std::type_index, ShaderInfo> fragment_shaders = {};
+    std::unordered_map<std::type_index, wgpu::BindGroupLayout> geometry_bind_group_layouts = {};
+    std::unordered_map<std::type_index, wgpu::BindGroupLayout> material_bind_group_layouts = {};
+    std::unordered_map<RenderPipelineKey, CachedRenderPipeline> pipelines = {};
+    /// Into `pipelines`, whose values do not move.
+    std::vector<CachedRenderPipeline*> pipelines_by_id = {};
+    /// Of each pipeline, -1 while compiling.
+    std::vector<double> compile_seconds_ = {};
+    std::shared_ptr<CompiledPipelines> compiled_pipelines = std::make_shared<CompiledPipelines>();
+
+  public:
+    struct Stats {
+        /// Of `get_or_create`, which entities call once per material change.
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t shader_modules = 0;
+        /// Pipelines created by `warm_up`, not counted in `hits` and `misses`.
+        size_t warmed_up = 0;
+        /// Asynchronous compilations not collected yet.
+        size_t pending = 0;
+        size_t compiled_async = 0;
+        double max_compile_seconds = 0;
+    };
+
+  private:
+    Stats stats_ = {};
+
+  public:
+    PipelineCache() = default;
+
+    PipelineCache(
+        wgpu::Device device,
+        CanvasFormat surface_format,
+        wgpu::BindGroupLayout frame_bind_group_layout
+    );
+
+    /// Returns the cached pipeline for this combination, creating it on first use. With `async`,
+    /// the returned pipeline is null until compiled, see `get`. Without, a pipeline still compiling
+    /// is compiled again synchronously.
+    CachedRenderPipeline get_or_create(
+        const GeometryBase& geometry,
+        const MaterialBase& material,
+        bool async = false
+    );
+
+    /// Pipeline `id` as currently known, with a null pipeline while compiling.
+    CachedRenderPipeline get(uint32_t id) const;
+
+    /// Picks up pipelines compiled asynchronously. Returns whether any was, so that users of
+    /// pending pipelines know to check them again with `get`.
+    bool collect_compiled();
+
+    /// Compile latency of each pipeline by ID, in seconds, -1 while compiling.
+    std::span<const double> compile_seconds() const;
+
+    /// Writes the geometry and material types and the descriptors of the pipelines created so far,
+    /// one per line, to be replayed by `warm_up` in a later run.
+    void save_manifest(const std::filesystem::path& path) const;
+
+    /// Creates the pipelines of the manifest at `path` that `geometries` and `materials` combine
+    /// into, so that entities created later find them compiled. Type names in manifests are only
+    /// stable within one build, other pipelines are skipped.
+    void warm_up(
+        const std::filesystem::path& path,
+        std::span<const GeometryBase* const> geometries,
+        std::span<const MaterialBase* const> materials
+    );
+
+    Stats stats() const;
+
+  private:
+    RenderPipelineKey make_key(const GeometryBase& geometry, const MaterialBase& material) const;
+
+    /// Creates the pipeline of `key`, which must not be cached yet.
+    CachedRenderPipeline& insert_pipeline(
+        RenderPipelineKey key,
+        const GeometryBase& geometry,
+        const MaterialBase& material,
+        bool async
+    );
+
+    /// Compiles the pipeline of `cached`, or starts compiling it with `async`.
+    void create_pipeline(
+        CachedRenderPipeline& cached,
+        const GeometryBase& geometry,
+        const MaterialBase& material,
+        bool async
+    );
+
+    const ShaderInfo& vertex_shader_for(const GeometryBase& geometry);
+
+    const ShaderInfo& fragment_shader_for(const MaterialBase& material);
+
+    wgpu::BindGroupLayout geometry_bind_group_layout_for(const GeometryBase& geometry);
+
+    wgpu::BindGroupLayout material_bind_group_layout_for(const MaterialBase& material);
+};
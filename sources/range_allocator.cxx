@@ -0,0 +1,276 @@
+#include "range_allocator.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+float RangeAllocator::Stats::fragmentation() const {
+    auto free = this->capacity - this->used;
+    if (free == 0) {
+        return 0;
+    }
+    return 1 - (float)this->largest_free_block / (float)free;
+}
+
+/// Bin of free blocks of `size`: the position of the highest bit, and the next bits below it.
+/// Sizes smaller than the second level count all go to the first bin, one per size.
+static inline void bin_of(
+    uint32_t size,
+    uint32_t second_level_bits,
+    uint32_t& first,
+    uint32_t& second
+) {
+    auto second_level_count = 1u << second_level_bits;
+    if (size < second_level_count) {
+        first = 0;
+        second = size;
+        return;
+    }
+    auto highest_bit = (uint32_t)std::bit_width(size) - 1;
+    first = highest_bit - second_level_bits + 1;
+    second = (size >> (highest_bit - second_level_bits)) - second_level_count;
+}
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+    this->grow(capacity);
+}
+
+std::optional<RangeAllocator::Allocation> RangeAllocator::allocate(uint32_t size) {
+    assert(size != 0);
+
+    // Round up to the next bin boundary, so that any block of the bin found is large enough.
+    auto rounded_size = (uint64_t)size;
+    if (size >= SECOND_LEVEL_COUNT) {
+        auto highest_bit = (uint32_t)std::bit_width(size) - 1;
+        rounded_size += (1ull << (highest_bit - SECOND_LEVEL_BITS)) - 1;
+    }
+    uint32_t first;
+    uint32_t second;
+    bin_of(
+        (uint32_t)std::min(rounded_size, (uint64_t)UINT32_MAX),
+        SECOND_LEVEL_BITS,
+        first,
+        second
+    );
+
+    auto second_level_bitmap = this->second_level_bitmaps[first] & (~0u << second);
+    if (second_level_bitmap == 0) {
+        auto first_level_bitmap =
+            first + 1 < 32 ? this->first_level_bitmap & (~0u << (first + 1)) : 0;
+        if (first_level_bitmap == 0) {
+            return std::nullopt;
+        }
+        first = (uint32_t)std::countr_zero(first_level_bitmap);
+        second_level_bitmap = this->second_level_bitmaps[first];
+    }
+    second = (uint32_t)std::countr_zero(second_level_bitmap);
+    auto node = this->free_lists[first * SECOND_LEVEL_COUNT + second];
+    // Only for sizes whose rounding overflowed.
+    if (this->nodes[node].size < size) {
+        return std::nullopt;
+    }
+
+    this->remove_free(node);
+    if (this->nodes[node].size > size) {
+        auto next = this->nodes[node].next_physical;
+        auto rest = this->create_node(Node {
+            .offset = this->nodes[node].offset + size,
+            .size = this->nodes[node].size - size,
+            .previous_physical = node,
+            .next_physical = next,
+            .previous_free = NULL_NODE,
+            .next_free = NULL_NODE,
+            .is_free = true,
+        });
+        if (next != NULL_NODE) {
+            this->nodes[next].previous_physical = rest;
+        } else {
+            this->last_node = rest;
+        }
+        this->nodes[node].next_physical = rest;
+        this->nodes[node].size = size;
+        this->insert_free(rest);
+    }
+    this->nodes[node].is_free = false;
+    this->used += size;
+    ++this->allocation_count;
+    return this->get(node);
+}
+
+void RangeAllocator::free(uint32_t node) {
+    assert(node < this->nodes.size() && !this->nodes[node].is_free);
+    this->used -= this->nodes[node].size;
+    --this->allocation_count;
+
+    auto next = this->nodes[node].next_physical;
+    if (next != NULL_NODE && this->nodes[next].is_free) {
+        this->remove_free(next);
+        this->merge_into_previous(node, next);
+    }
+    auto previous = this->nodes[node].previous_physical;
+    if (previous != NULL_NODE && this->nodes[previous].is_free) {
+        this->remove_free(previous);
+        this->merge_into_previous(previous, node);
+        node = previous;
+    }
+    this->insert_free(node);
+}
+
+RangeAllocator::Allocation RangeAllocator::get(uint32_t node) const {
+    assert(node < this->nodes.size() && !this->nodes[node].is_free);
+    return Allocation {
+        .node = node,
+        .offset = this->nodes[node].offset,
+        .size = this->nodes[node].size,
+    };
+}
+
+void RangeAllocator::grow(uint32_t capacity) {
+    assert(capacity >= this->capacity);
+    auto extra = capacity - this->capacity;
+    if (extra == 0) {
+        return;
+    }
+    if (this->last_node != NULL_NODE && this->nodes[this->last_node].is_free) {
+        this->remove_free(this->last_node);
+        this->nodes[this->last_node].size += extra;
+        this->insert_free(this->last_node);
+    } else {
+        auto node = this->create_node(Node {
+            .offset = this->capacity,
+            .size = extra,
+            .previous_physical = this->last_node,
+            .next_physical = NULL_NODE,
+            .previous_free = NULL_NODE,
+            .next_free = NULL_NODE,
+            .is_free = true,
+        });
+        if (this->last_node != NULL_NODE) {
+            this->nodes[this->last_node].next_physical = node;
+        }
+        this->last_node = node;
+        this->insert_free(node);
+    }
+    this->capacity = capacity;
+}
+
+void RangeAllocator::compact(const std::function<void(uint32_t, uint32_t, uint32_t)>& move) {
+    auto node = this->last_node;
+    while (node != NULL_NODE && this->nodes[node].previous_physical != NULL_NODE) {
+        node = this->nodes[node].previous_physical;
+    }
+
+    uint32_t offset = 0;
+    auto previous = NULL_NODE;
+    while (node != NULL_NODE) {
+        auto next = this->nodes[node].next_physical;
+        if (this->nodes[node].is_free) {
+            this->remove_free(node);
+            this->unused_nodes.push_back(node);
+        } else {
+            move(this->nodes[node].offset, offset, this->nodes[node].size);
+            this->nodes[node].offset = offset;
+            this->nodes[node].previous_physical = previous;
+            if (previous != NULL_NODE) {
+                this->nodes[previous].next_physical = node;
+            }
+            offset += this->nodes[node].size;
+            previous = node;
+        }
+        node = next;
+    }
+    if (previous != NULL_NODE) {
+        this->nodes[previous].next_physical = NULL_NODE;
+    }
+    this->last_node = previous;
+
+    // Everything after the last allocation becomes one free block.
+    auto capacity = this->capacity;
+    this->capacity = offset;
+    this->grow(capacity);
+}
+
+uint32_t RangeAllocator::get_capacity() const {
+    return this->capacity;
+}
+
+RangeAllocator::Stats RangeAllocator::stats() const {
+    auto stats = Stats {
+        .capacity = this->capacity,
+        .used = this->used,
+        .allocation_count = this->allocation_count,
+        .free_block_count = 0,
+        .largest_free_block = 0,
+    };
+    for (auto node = this->last_node; node != NULL_NODE;
+         node = this->nodes[node].previous_physical) {
+        if (this->nodes[node].is_free) {
+            ++stats.free_block_count;
+            stats.largest_free_block = std::max(stats.largest_free_block, this->nodes[node].size);
+        }
+    }
+    return stats;
+}
+
+uint32_t RangeAllocator::create_node(const Node& node) {
+    if (!this->unused_nodes.empty()) {
+        auto index = this->unused_nodes.back();
+        this->unused_nodes.pop_back();
+        this->nodes[index] = node;
+        return index;
+    }
+    this->nodes.push_back(node);
+    return (uint32_t)(this->nodes.size() - 1);
+}
+
+void RangeAllocator::insert_free(uint32_t node) {
+    uint32_t first;
+    uint32_t second;
+    bin_of(this->nodes[node].size, SECOND_LEVEL_BITS, first, second);
+    auto& head = this->free_lists[first * SECOND_LEVEL_COUNT + second];
+    // Heads of empty bins are left stale.
+    auto next = (this->second_level_bitmaps[first] >> second) & 1 ? head : NULL_NODE;
+    this->nodes[node].is_free = true;
+    this->nodes[node].previous_free = NULL_NODE;
+    this->nodes[node].next_free = next;
+    if (next != NULL_NODE) {
+        this->nodes[next].previous_free = node;
+    }
+    head = node;
+    this->second_level_bitmaps[first] |= 1u << second;
+    this->first_level_bitmap |= 1u << first;
+}
+
+void RangeAllocator::remove_free(uint32_t node) {
+    uint32_t first;
+    uint32_t second;
+    bin_of(this->nodes[node].size, SECOND_LEVEL_BITS, first, second);
+    auto previous = this->nodes[node].previous_free;
+    auto next = this->nodes[node].next_free;
+    if (previous != NULL_NODE) {
+        this->nodes[previous].next_free = next;
+    } else {
+        this->free_lists[first * SECOND_LEVEL_COUNT + second] = next;
+        if (next == NULL_NODE) {
+            this->second_level_bitmaps[first] &= ~(1u << second);
+            if (this->second_level_bitmaps[first] == 0) {
+                this->first_level_bitmap &= ~(1u << first);
+            }
+        }
+    }
+    if (next != NULL_NODE) {
+        this->nodes[next].previous_free = previous;
+    }
+}
+
+void RangeAllocator::merge_into_previous(uint32_t previous, uint32_t node) {
+    this->nodes[previous].size += this->nodes[node].size;
+    auto next = this->nodes[node].next_physical;
+    this->nodes[previous].next_physical = next;
+    if (next != NULL_NODE) {
+        this->nodes[next].previous_physical = previous;
+    } else {
+        this->last_node = previous;
+    }
+    this->unused_nodes.push_back(node);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+/// Allocator of ranges of an abstract space of `capacity` units, with the two-level segregated fit
+/// (TLSF) scheme: free blocks are binned by the position of their highest bit and the next 3 bits,
+/// and bitmaps of non-empty bins find a block at least as large as requested in constant time.
+/// Adjacent free blocks are merged when freeing.
+///
+/// Allocations are identified by a node that stays valid until freed, including across `grow` and
+/// `compact`, which may move them.
+class RangeAllocator {
+  public:
+    static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+    struct Allocation {
+        uint32_t node = NULL_NODE;
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    struct Stats {
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+        uint32_t allocation_count = 0;
+        uint32_t free_block_count = 0;
+        uint32_t largest_free_block = 0;
+
+        /// 0 when all free space is one block, approaching 1 as it is split into many small ones.
+        float fragmentation() const;
+    };
+
+  private:
+    static constexpr uint32_t SECOND_LEVEL_BITS = 3;
+    static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+    static constexpr uint32_t FIRST_LEVEL_COUNT = 32 - SECOND_LEVEL_BITS + 1;
+
+    struct Node {
+        uint32_t offset;
+        uint32_t size;
+        /// Neighbors in offset order.
+        uint32_t previous_physical;
+        uint32_t next_physical;
+        /// Neighbors in the free list of the bin, only for free nodes.
+        uint32_t previous_free;
+        uint32_t next_free;
+        bool is_free;
+    };
+
+    std::vector<Node> nodes = {};
+    /// Indices of unused entries of `nodes`.
+    std::vector<uint32_t> unused_nodes = {};
+    /// Node with the highest offset.
+    uint32_t last_node = NULL_NODE;
+
+    uint32_t first_level_bitmap = 0;
+    std::array<uint32_t, FIRST_LEVEL_COUNT> second_level_bitmaps = {};
+    std::array<uint32_t, FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT> free_lists = {};
+
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+    uint32_t allocation_count = 0;
+
+  public:
+    RangeAllocator() = default;
+
+    RangeAllocator(uint32_t capacity);
+
+    /// `std::nullopt` if no free block is large enough. `size` must not be 0.
+    std::optional<Allocation> allocate(uint32_t size);
+
+    void free(uint32_t node);
+
+    /// Current range of the allocation of `node`, which may have moved since allocated.
+    Allocation get(uint32_t node) const;
+
+    /// Adds free space at the end, without moving any allocation.
+    void grow(uint32_t capacity);
+
+    /// Moves all allocations to the start of the space, in offset order, leaving one free block at
+    /// the end. `move(from, to, size)` is called for every allocation, in offset order, with
+    /// `to <= from`.
+    void compact(const std::function<void(uint32_t, uint32_t, uint32_t)>& move);
+
+    uint32_t get_capacity() const;
+
+    Stats stats() const;
+
+  private:
+    uint32_t create_node(const Node& node);
+
+    void insert_free(uint32_t node);
+
+    void remove_free(uint32_t node);
+
+    /// Merges `node` into `previous`, which must be the previous physical node.
+    void merge_into_previous(uint32_t previous, uint32_t node);
+};
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cassert>
+
+#include "log.hxx"
+#include "render_graph.hxx"
+
+using namespace std::literals;
+
+RenderGraph::RenderGraph(
+    wgpu::Device device,
+    wgpu::Queue queue,
+    std::shared_ptr<RenderTargetPool> render_target_pool
+)
+    : device(std::move(device))
+    , queue(std::move(queue))
+    , render_target_pool(std::move(render_target_pool)) {
+    if (this->render_target_pool == nullptr) {
+        this->render_target_pool = std::make_shared<RenderTargetPool>(this->device);
+    }
+}
+
+RenderGraphResource RenderGraph::create_texture(
+    std::string_view name,
+    const RenderTargetInfo& info
+) {
+    return this->add_resource(Resource {
+        .name = name,
+        .kind = ResourceKind::Texture,
+        .is_imported = false,
+        .texture_info = info,
+        .texture = nullptr,
+        .texture_view = nullptr,
+        .buffer = nullptr,
+        .writers = {},
+        .first_use = UINT32_MAX,
+        .last_use = 0,
+    });
+}
+
+RenderGraphResource RenderGraph::import_texture(
+    std::string_view name,
+    wgpu::Texture texture,
+    wgpu::TextureView texture_view
+) {
+    assert(texture != nullptr && texture_view != nullptr);
+    auto info = RenderTargetInfo {
+        .width = texture.GetWidth(),
+        .height = texture.GetHeight(),
+        .format = texture.GetFormat(),
+        .usage = texture.GetUsage(),
+    };
+    return this->add_resource(Resource {
+        .name = name,
+        .kind = ResourceKind::Texture,
+        .is_imported = true,
+        .texture_info = info,
+        .texture = std::move(texture),
+        .texture_view = std::move(texture_view),
+        .buffer = nullptr,
+        .writers = {},
+        .first_use = UINT32_MAX,
+        .last_use = 0,
+    });
+}
+
+RenderGraphResource RenderGraph::import_buffer(std::string_view name, wgpu::Buffer buffer) {
+    assert(buffer != nullptr);
+    return this->add_resource(Resource {
+        .name = name,
+        .kind = ResourceKind::Buffer,
+        .is_imported = true,
+        .texture_info = {},
+        .texture = nullptr,
+        .texture_view = nullptr,
+        .buffer = std::move(buffer),
+        .writers = {},
+        .first_use = UINT32_MAX,
+        .last_use = 0,
+    });
+}
+
+RenderGraphResource RenderGraph::add_resource(Resource resource) {
+    this->resources.push_back(std::move(resource));
+    return RenderGraphResource {.index = (uint32_t)this->resources.size() - 1};
+}
+
+const RenderTargetInfo& RenderGraph::get_texture_info(RenderGraphResource texture) const {
+    assert(texture.index < this->resources.size());
+    assert(this->resources[texture.index].kind == ResourceKind::Texture);
+    return this->resources[texture.index].texture_info;
+}
+
+void RenderGraph::add_pass(PassInfo info) {
+    auto pass_index = (uint32_t)this->passes.size();
+    for (auto resource : info.reads) {
+        assert(resource.index < this->resources.size());
+    }
+    for (auto resource : info.writes) {
+        assert(resource.index < this->resources.size());
+        this->resources[resource.index].writers.push_back(pass_index);
+    }
+    this->passes.push_back(Pass {
+        .info = std::move(info),
+        .is_culled = true,
+    });
+}
+
+void RenderGraph::on_submitted(std::function<void()> callback) {
+    this->submitted_callbacks.push_back(std::move(callback));
+}
+
+void RenderGraph::execute() {
+    this->compile();
+    this->allocate_transient_textures();
+
+    auto encoder_descriptor = wgpu::CommandEncoderDescriptor {
+        .label = "Render Graph"sv,
+    };
+    auto encoder = this->device.CreateCommandEncoder(&encoder_descriptor);
+    for (auto pass_index : this->order) {
+        const auto& pass = this->passes[pass_index];
+        encoder.PushDebugGroup(wgpu::StringView(pass.info.name));
+        pass.info.execute(encoder, *this);
+        encoder.PopDebugGroup();
+    }
+    auto command_buffer = encoder.Finish();
+    this->queue.Submit(1, &command_buffer);
+    for (auto& callback : this->submitted_callbacks) {
+        callback();
+    }
+
+    this->stats_.pass_count = (uint32_t)this->passes.size();
+    this->stats_.culled_pass_count = (uint32_t)(this->passes.size() - this->order.size());
+    this->resources.clear();
+    this->passes.clear();
+    this->submitted_callbacks.clear();
+    this->order.clear();
+}
+
+wgpu::TextureView RenderGraph::get_texture_view(RenderGraphResource texture) const {
+    assert(texture.index < this->resources.size());
+    const auto& resource = this->resources[texture.index];
+    assert(resource.kind == ResourceKind::Texture && resource.texture_view != nullptr);
+    return resource.texture_view;
+}
+
+wgpu::Texture RenderGraph::get_texture(RenderGraphResource texture) const {
+    assert(texture.index < this->resources.size());
+    const auto& resource = this->resources[texture.index];
+    assert(resource.kind == ResourceKind::Texture && resource.texture != nullptr);
+    return resource.texture;
+}
+
+wgpu::Buffer RenderGraph::get_buffer(RenderGraphResource buffer) const {
+    assert(buffer.index < this->resources.size());
+    const auto& resource = this->resources[buffer.index];
+    assert(resource.kind == ResourceKind::Buffer);
+    return resource.buffer;
+}
+
+RenderGraph::Stats RenderGraph::stats() const {
+    return this->stats_;
+}
+
+void RenderGraph::compile() {
+    // Passes writing imported resources are kept, then the writers of everything kept passes read.
+    auto pending = std::vector<uint32_t> {};
+    for (const auto& resource : this->resources) {
+        if (resource.is_imported) {
+            pending.insert(pending.end(), resource.writers.begin(), resource.writers.end());
+        }
+    }
+    while (!pending.empty()) {
+        auto pass_index = pending.back();
+        pending.pop_back();
+        auto& pass = this->passes[pass_index];
+        if (!pass.is_culled) {
+            continue;
+        }
+        pass.is_culled = false;
+        for (auto resource : pass.info.reads) {
+            const auto& writers = this->resources[resource.index].writers;
+            pending.insert(pending.end(), writers.begin(), writers.end());
+        }
+    }
+
+    // A pass depends on all writers of what it only reads, and on the writers added before it of
+    // what it writes. Of the passes whose dependencies are all placed, the first added goes next.
+    auto is_placed = std::vector<uint8_t>(this->passes.size(), 0);
+    auto is_unplaced = [&](uint32_t pass_index) {
+        return !this->passes[pass_index].is_culled && !is_placed[pass_index];
+    };
+    auto depends_on_unplaced = [&](uint32_t pass_index) {
+        const auto& pass = this->passes[pass_index];
+        for (auto resource : pass.info.reads) {
+            auto writes_it = std::ranges::any_of(pass.info.writes, [&](RenderGraphResource write) {
+                return write.index == resource.index;
+            });
+            for (auto writer : this->resources[resource.index].writers) {
+                if (writes_it && writer >= pass_index) {
+                    break;
+                }
+                if (writer != pass_index && is_unplaced(writer)) {
+                    return true;
+                }
+            }
+        }
+        for (auto resource : pass.info.writes) {
+            for (auto writer : this->resources[resource.index].writers) {
+                if (writer >= pass_index) {
+                    break;
+                }
+                if (is_unplaced(writer)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+    auto kept_count = std::ranges::count_if(this->passes, [](const Pass& pass) {
+        return !pass.is_culled;
+    });
+    this->order.clear();
+    while ((ptrdiff_t)this->order.size() < kept_count) {
+        auto next = UINT32_MAX;
+        for (uint32_t i = 0; i < this->passes.size(); ++i) {
+            if (!this->passes[i].is_culled && !is_placed[i] && !depends_on_unplaced(i)) {
+                next = i;
+                break;
+            }
+        }
+        if (next == UINT32_MAX) {
+            log_error("render graph has a cycle of passes reading each other's writes");
+            abort();
+        }
+        is_placed[next] = 1;
+        this->order.push_back(next);
+    }
+
+    for (uint32_t position = 0; position < this->order.size(); ++position) {
+        const auto& pass = this->passes[this->order[position]];
+        for (const auto* accesses : {&pass.info.reads, &pass.info.writes}) {
+            for (auto resource_handle : *accesses) {
+                auto& resource = this->resources[resource_handle.index];
+                resource.first_use = std::min(resource.first_use, position);
+                resource.last_use = std::max(resource.last_use, position);
+            }
+        }
+    }
+}
+
+void RenderGraph::allocate_transient_textures() {
+    auto transient_textures = std::vector<uint32_t> {};
+    for (uint32_t i = 0; i < this->resources.size(); ++i) {
+        const auto& resource = this->resources[i];
+        if (resource.kind == ResourceKind::Texture && !resource.is_imported &&
+            resource.first_use != UINT32_MAX) {
+            transient_textures.push_back(i);
+        }
+    }
+    std::ranges::sort(transient_textures, {}, [&](uint32_t i) {
+        return this->resources[i].first_use;
+    });
+
+    // Swept in the order of their first use, a transient texture gives its render target back once
+    // a later one is first used after its last use.
+    auto acquired = std::vector<std::pair<uint32_t, RenderTargetPool::Target>> {};
+    auto used_textures = std::vector<WGPUTexture> {};
+    for (auto resource_index : transient_textures) {
+        auto& resource = this->resources[resource_index];
+        std::erase_if(acquired, [&](const auto& entry) {
+            auto is_done = this->resources[entry.first].last_use < resource.first_use;
+            if (is_done) {
+                this->render_target_pool->release(entry.second);
+            }
+            return is_done;
+        });
+        auto target = this->render_target_pool->acquire(resource.texture_info);
+        resource.texture = target.texture;
+        resource.texture_view = target.texture_view;
+        if (std::ranges::find(used_textures, target.texture.Get()) == used_textures.end()) {
+            used_textures.push_back(target.texture.Get());
+        }
+        acquired.emplace_back(resource_index, std::move(target));
+    }
+    // Nothing is recorded yet, and submissions are ordered, so render targets can be handed to
+    // the next graph right away.
+    for (const auto& entry : acquired) {
+        this->render_target_pool->release(entry.second);
+    }
+    this->render_target_pool->trim();
+
+    this->stats_.transient_texture_count = (uint32_t)transient_textures.size();
+    this->stats_.used_texture_count = (uint32_t)used_textures.size();
+}
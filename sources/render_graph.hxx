@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+#include "render_target_pool.hxx"
+
+/// Texture or buffer of a `RenderGraph`, valid until the graph is executed.
+struct RenderGraphResource {
+    uint32_t index = UINT32_MAX;
+};
+
+/// Passes of a frame, recorded into one command encoder and submitted at once.
+///
+/// Each frame, passes are added with the textures and buffers they read and write, then `execute`
+/// orders them so that every resource is read after all passes writing it, in the order they were
+/// added otherwise. Passes writing the same resource keep the order they were added in, and a pass
+/// reading and writing a resource only comes after the writers added before it. Passes whose
+/// writes are never read are culled, unless they write an imported resource, such as the swapchain
+/// texture or a buffer of the scene.
+///
+/// Transient textures are created by the graph and only live during the frame. They are backed by
+/// render targets of a `RenderTargetPool` kept across frames, and possibly shared with other
+/// graphs: transient textures whose lifetimes, from the first to the last pass using them, do not
+/// overlap may share the same render target. Their contents are undefined until the first pass
+/// writing them, which must clear them. Render targets may be larger than transient textures, so
+/// passes must limit their viewport to the size of `get_texture_info`.
+class RenderGraph {
+  public:
+    /// Called while recording, resources of the graph are resolved with `get_texture_view` and
+    /// `get_buffer`.
+    using Execute = std::function<void(wgpu::CommandEncoder& encoder, const RenderGraph& graph)>;
+
+    struct PassInfo {
+        std::string_view name;
+        std::vector<RenderGraphResource> reads = {};
+        std::vector<RenderGraphResource> writes = {};
+        Execute execute;
+    };
+
+    struct Stats {
+        /// Of the last executed frame.
+        uint32_t pass_count;
+        uint32_t culled_pass_count;
+        uint32_t transient_texture_count;
+        /// Render targets backing the transient textures, fewer than them when aliased.
+        uint32_t used_texture_count;
+    };
+
+  private:
+    enum class ResourceKind {
+        Texture,
+        Buffer,
+    };
+
+    struct Resource {
+        std::string_view name;
+        ResourceKind kind;
+        bool is_imported;
+        /// Of textures.
+        RenderTargetInfo texture_info;
+        /// Null for transient textures until they are assigned a render target.
+        wgpu::Texture texture;
+        wgpu::TextureView texture_view;
+        wgpu::Buffer buffer;
+        /// Passes writing the resource, in the order they were added.
+        std::vector<uint32_t> writers;
+        /// Positions in the execution order of the first and the last pass using the resource.
+        uint32_t first_use;
+        uint32_t last_use;
+    };
+
+    struct Pass {
+        PassInfo info;
+        bool is_culled;
+    };
+
+    wgpu::Device device = nullptr;
+    wgpu::Queue queue = nullptr;
+
+    std::vector<Resource> resources = {};
+    std::vector<Pass> passes = {};
+    std::vector<std::function<void()>> submitted_callbacks = {};
+
+    /// Indices of passes that are not culled, in execution order.
+    std::vector<uint32_t> order = {};
+
+    std::shared_ptr<RenderTargetPool> render_target_pool = nullptr;
+
+    Stats stats_ = {};
+
+  public:
+    RenderGraph() = default;
+
+    /// Transient textures come from `render_target_pool`, or from a pool of the graph if null.
+    RenderGraph(
+        wgpu::Device device,
+        wgpu::Queue queue,
+        std::shared_ptr<RenderTargetPool> render_target_pool = nullptr
+    );
+
+    /// Transient texture, backed by a render target during `execute`.
+    RenderGraphResource create_texture(std::string_view name, const RenderTargetInfo& info);
+
+    /// Texture living outside of the graph. Passes writing it are never culled.
+    RenderGraphResource import_texture(
+        std::string_view name,
+        wgpu::Texture texture,
+        wgpu::TextureView texture_view
+    );
+
+    /// Buffer living outside of the graph. Passes writing it are never culled.
+    RenderGraphResource import_buffer(std::string_view name, wgpu::Buffer buffer);
+
+    /// Size, format and usage of a transient or imported texture.
+    const RenderTargetInfo& get_texture_info(RenderGraphResource texture) const;
+
+    void add_pass(PassInfo info);
+
+    /// Called once the passes of the frame are submitted, e.g. to map staging buffers again.
+    void on_submitted(std::function<void()> callback);
+
+    /// Orders and culls passes, assigns render targets to transient textures, records the passes
+    /// into one command encoder and submits it. Passes and resources are then cleared for the next
+    /// frame.
+    void execute();
+
+    /// Only valid while recording.
+    wgpu::TextureView get_texture_view(RenderGraphResource texture) const;
+
+    /// Only valid while recording.
+    wgpu::Texture get_texture(RenderGraphResource texture) const;
+
+    wgpu::Buffer get_buffer(RenderGraphResource buffer) const;
+
+    Stats stats() const;
+
+  private:
+    RenderGraphResource add_resource(Resource resource);
+
+    /// Fills `order` with passes contributing to imported resources, each after the passes writing
+    /// what it reads. Aborts on cycles.
+    void compile();
+
+    /// Acquires a render target for each transient texture used by a pass of `order`, releasing
+    /// those of transient textures whose last pass comes before the first pass of the next one.
+    void allocate_transient_textures();
+};
@@ -0,0 +1,78 @@
+#include <bit>
+
+#include "render_queue.hxx"
+
+/// Folds a pointer into 16 bits.
+/// Collisions only make the sorting less effective, draws are still correct.
+static inline uint64_t fold_pointer(const void* pointer) {
+    auto x = (uint64_t)(uintptr_t)pointer;
+    // Low bits are mostly zero due to alignment.
+    x >>= 4;
+    x ^= x >> 16;
+    x ^= x >> 32;
+    return x & 0xFFFF;
+}
+
+uint64_t RenderQueue::make_key(
+    uint32_t pipeline_id,
+    const void* material,
+    const void* geometry,
+    float view_depth
+) {
+    // For non-negative floats the bit pattern is monotonic, so the top bits (excluding the sign bit,
+    // which is always 0) are a logarithmic quantization of the depth.
+    auto depth_bits = (uint64_t)(std::bit_cast<uint32_t>(std::max(view_depth, 0.0f)) >> 11);
+    return ((uint64_t)(pipeline_id & 0xFFF) << 52)  //
+           | (fold_pointer(material) << 36)         //
+           | (fold_pointer(geometry) << 20)         //
+           | (depth_bits & DEPTH_MASK);
+}
+
+void RenderQueue::clear() {
+    this->items.clear();
+}
+
+void RenderQueue::push(uint64_t key, uint32_t entity_index) {
+    this->items.push_back(RenderQueueItem {
+        .key = key,
+        .entity_index = entity_index,
+    });
+}
+
+void RenderQueue::sort() {
+    auto n = this->items.size();
+    if (n < 2) {
+        return;
+    }
+    this->scratch.resize(n);
+
+    auto* source = this->items.data();
+    auto* destination = this->scratch.data();
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        auto counts = std::array<size_t, 256> {};
+        for (size_t i = 0; i < n; ++i) {
+            ++counts[(source[i].key >> shift) & 0xFF];
+        }
+        // All keys have the same digit, this pass would not change anything.
+        if (counts[(source[0].key >> shift) & 0xFF] == n) {
+            continue;
+        }
+        size_t offset = 0;
+        for (auto& count : counts) {
+            auto c = count;
+            count = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            destination[counts[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+    if (source != this->items.data()) {
+        std::swap(this->items, this->scratch);
+    }
+}
+
+std::span<const RenderQueueItem> RenderQueue::get_items() const {
+    return this->items;
+}
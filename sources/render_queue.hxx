@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <span>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+struct RenderQueueItem {
+    uint64_t key;
+    uint32_t entity_index;
+};
+
+struct RenderQueueStats {
+    size_t item_count = 0;
+    double build_seconds = 0;
+    double sort_seconds = 0;
+};
+
+/// Draw order of a frame, sorted by 64-bit keys so that entities sharing GPU states are drawn
+/// next to each other, and front-to-back within the same states.
+///
+/// Key layout, from the most significant bit:
+///
+/// | bits | content                               |
+/// |------|---------------------------------------|
+/// | 12   | pipeline ID                           |
+/// | 16   | material (folded pointer)             |
+/// | 16   | geometry (folded pointer)             |
+/// | 20   | view depth (top bits of the float)    |
+class RenderQueue {
+    std::vector<RenderQueueItem> items = {};
+    std::vector<RenderQueueItem> scratch = {};
+
+  public:
+    static constexpr uint64_t DEPTH_MASK = 0xFFFFF;
+
+    static uint64_t make_key(
+        uint32_t pipeline_id,
+        const void* material,
+        const void* geometry,
+        float view_depth
+    );
+
+    void clear();
+
+    void push(uint64_t key, uint32_t entity_index);
+
+    /// LSD radix sort over the keys, stable.
+    void sort();
+
+    std::span<const RenderQueueItem> get_items() const;
+};
+
+/// `wgpu::RenderPassEncoder` or `wgpu::RenderBundleEncoder`.
+template <class T>
+concept RenderCommandEncoder =
+    std::same_as<T, wgpu::RenderPassEncoder> || std::same_as<T, wgpu::RenderBundleEncoder>;
+
+/// GPU states last set on a render pass or render bundle, for skipping redundant state changes.
+struct RenderPassState {
+    WGPURenderPipeline pipeline = nullptr;
+    std::array<WGPUBindGroup, 3> bind_groups = {};
+    WGPUBuffer vertex_buffer = nullptr;
+    WGPUBuffer index_buffer = nullptr;
+    wgpu::IndexFormat index_format = wgpu::IndexFormat::Undefined;
+
+    template <RenderCommandEncoder E>
+    void set_pipeline(E& encoder, const wgpu::RenderPipeline& pipeline) {
+        if (this->pipeline == pipeline.Get()) {
+            return;
+        }
+        encoder.SetPipeline(pipeline);
+        this->pipeline = pipeline.Get();
+    }
+
+    template <RenderCommandEncoder E>
+    void set_bind_group(E& encoder, uint32_t index, const wgpu::BindGroup& bind_group) {
+        if (this->bind_groups[index] == bind_group.Get()) {
+            return;
+        }
+        encoder.SetBindGroup(index, bind_group);
+        this->bind_groups[index] = bind_group.Get();
+    }
+
+    template <RenderCommandEncoder E>
+    void set_vertex_buffer(E& encoder, const wgpu::Buffer& buffer) {
+        if (this->vertex_buffer == buffer.Get()) {
+            return;
+        }
+        encoder.SetVertexBuffer(0, buffer);
+        this->vertex_buffer = buffer.Get();
+    }
+
+    template <RenderCommandEncoder E>
+    void set_index_buffer(E& encoder, const wgpu::Buffer& buffer, wgpu::IndexFormat format) {
+        if (this->index_buffer == buffer.Get() && this->index_format == format) {
+            return;
+        }
+        encoder.SetIndexBuffer(buffer, format);
+        this->index_buffer = buffer.Get();
+        this->index_format = format;
+    }
+};
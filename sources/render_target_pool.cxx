@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cassert>
+
+#include "log.hxx"
+#include "render_target_pool.hxx"
+
+using namespace std::literals;
+
+/// Approximate, for statistics.
+static uint64_t texel_size(wgpu::TextureFormat format) {
+    switch (format) {
+    case wgpu::TextureFormat::R8Unorm:
+        return 1;
+    case wgpu::TextureFormat::RG8Unorm:
+    case wgpu::TextureFormat::R16Float:
+    case wgpu::TextureFormat::Depth16Unorm:
+        return 2;
+    case wgpu::TextureFormat::RGBA16Float:
+    case wgpu::TextureFormat::RG32Float:
+    case wgpu::TextureFormat::Depth32FloatStencil8:
+        return 8;
+    case wgpu::TextureFormat::RGBA32Float:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+RenderTargetPool::RenderTargetPool(wgpu::Device device)
+    : device(std::move(device)) {}
+
+RenderTargetPool::Target RenderTargetPool::acquire(const RenderTargetInfo& info) {
+    auto bucket_info = RenderTargetInfo {
+        .width = bucket_size(info.width),
+        .height = bucket_size(info.height),
+        .format = info.format,
+        .usage = info.usage,
+    };
+    auto entry = std::ranges::find_if(this->entries, [&](const Entry& entry) {
+        return !entry.is_acquired && entry.info == bucket_info;
+    });
+    if (entry == this->entries.end()) {
+        log_verbose(
+            "creating render target of {}x{} for {}x{}",
+            bucket_info.width,
+            bucket_info.height,
+            info.width,
+            info.height
+        );
+        auto descriptor = wgpu::TextureDescriptor {
+            .label = "Render Target"sv,
+            .usage = bucket_info.usage,
+            .dimension = wgpu::TextureDimension::e2D,
+            .size =
+                wgpu::Extent3D {
+                    .width = bucket_info.width,
+                    .height = bucket_info.height,
+                    .depthOrArrayLayers = 1,
+                },
+            .format = bucket_info.format,
+        };
+        auto texture = this->device.CreateTexture(&descriptor);
+        auto texture_view = texture.CreateView();
+        this->entries.push_back(Entry {
+            .info = bucket_info,
+            .target =
+                Target {
+                    .texture = std::move(texture),
+                    .texture_view = std::move(texture_view),
+                },
+            .is_acquired = false,
+            .last_acquired_frame = 0,
+        });
+        ++this->created_count;
+        entry = this->entries.end() - 1;
+    }
+    entry->is_acquired = true;
+    entry->last_acquired_frame = this->frame;
+    return entry->target;
+}
+
+void RenderTargetPool::release(const Target& target) {
+    auto entry = std::ranges::find_if(this->entries, [&](const Entry& entry) {
+        return entry.target.texture.Get() == target.texture.Get();
+    });
+    assert(entry != this->entries.end() && entry->is_acquired);
+    entry->is_acquired = false;
+}
+
+void RenderTargetPool::trim() {
+    std::erase_if(this->entries, [&](const Entry& entry) {
+        assert(!entry.is_acquired);
+        return this->frame - entry.last_acquired_frame >= MAX_UNUSED_FRAMES;
+    });
+    ++this->frame;
+}
+
+RenderTargetPool::Stats RenderTargetPool::stats() const {
+    uint64_t bytes = 0;
+    for (const auto& entry : this->entries) {
+        bytes += (uint64_t)entry.info.width * entry.info.height * texel_size(entry.info.format);
+    }
+    return Stats {
+        .texture_count = (uint32_t)this->entries.size(),
+        .bytes = bytes,
+        .created_count = this->created_count,
+    };
+}
+
+uint32_t RenderTargetPool::bucket_size(uint32_t size) {
+    return std::max((size + BUCKET_SIZE - 1) / BUCKET_SIZE * BUCKET_SIZE, BUCKET_SIZE);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+/// Size, format and usage of a render target.
+struct RenderTargetInfo {
+    uint32_t width;
+    uint32_t height;
+    wgpu::TextureFormat format;
+    wgpu::TextureUsage usage;
+
+    bool operator==(const RenderTargetInfo&) const = default;
+};
+
+/// 2D textures for render targets, recycled across frames, resizes and the render graphs sharing
+/// the pool.
+///
+/// Sizes are rounded up to multiples of `BUCKET_SIZE`, so that targets of slightly different sizes
+/// share textures: resizing a window by a few pixels reuses the textures of the previous size. A
+/// target may then be larger than requested, and users must only touch its top-left texels of the
+/// requested size, e.g. with a viewport. Textures not acquired during `MAX_UNUSED_FRAMES` calls to
+/// `trim` are released.
+class RenderTargetPool {
+  public:
+    static constexpr uint32_t BUCKET_SIZE = 256;
+    static constexpr uint64_t MAX_UNUSED_FRAMES = 8;
+
+    struct Target {
+        wgpu::Texture texture = nullptr;
+        wgpu::TextureView texture_view = nullptr;
+    };
+
+    struct Stats {
+        uint32_t texture_count;
+        /// Approximate memory of all textures.
+        uint64_t bytes;
+        /// Textures created since the pool was created.
+        uint64_t created_count;
+    };
+
+  private:
+    struct Entry {
+        /// With the size rounded up to its bucket.
+        RenderTargetInfo info;
+        Target target;
+        bool is_acquired;
+        uint64_t last_acquired_frame;
+    };
+
+    wgpu::Device device = nullptr;
+    std::vector<Entry> entries = {};
+    uint64_t frame = 0;
+    uint64_t created_count = 0;
+
+  public:
+    RenderTargetPool() = default;
+
+    explicit RenderTargetPool(wgpu::Device device);
+
+    /// A texture of the format and usage of `info`, of at least its size, which is not acquired
+    /// again until released. Its content is undefined.
+    Target acquire(const RenderTargetInfo& info);
+
+    void release(const Target& target);
+
+    /// Ends a frame, releasing textures unused for `MAX_UNUSED_FRAMES` frames. Textures must not
+    /// be acquired at this point.
+    void trim();
+
+    Stats stats() const;
+
+    /// Size of the textures backing targets of `size`.
+    static uint32_t bucket_size(uint32_t size);
+};
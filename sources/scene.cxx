@@ -1,45 +1,57 @@
 #include "scene.hxx"
 #include "log.hxx"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
 using namespace std::literals;
 
-static inline wgpu::BindGroupLayout create_camera_bind_group_layout(const wgpu::Device& device) {
+/// Entities per chunk of per-frame preparation run in parallel.
+static constexpr size_t PREPARE_CHUNK_SIZE = 4096;
+
+/// Entities per render bundle of dynamic entities recorded in parallel. With fewer than two chunks
+/// of dynamic entities, they are encoded directly into the render pass.
+static constexpr size_t RECORD_CHUNK_SIZE = 1024;
+
+static inline wgpu::BindGroupLayout create_frame_bind_group_layout(const wgpu::Device& device) {
     // Bind group layout.
     auto layout_entries = std::array {
         wgpu::BindGroupLayoutEntry {
             .binding = 0,
-            .visibility = wgpu::ShaderStage::Vertex,
+            .visibility = wgpu::ShaderStage::Vertex | wgpu::ShaderStage::Fragment,
             .buffer =
                 wgpu::BufferBindingLayout {
                     .type = wgpu::BufferBindingType::Uniform,
                     .hasDynamicOffset = false,
-                    .minBindingSize = sizeof(float[4][4]),
+                    .minBindingSize = sizeof(FrameConstants),
                 },
         },
     };
     auto layout_descriptor = wgpu::BindGroupLayoutDescriptor {
-        .label = "Camera"sv,
+        .label = "Frame Constants"sv,
         .entryCount = layout_entries.size(),
         .entries = layout_entries.data(),
     };
     return device.CreateBindGroupLayout(&layout_descriptor);
 }
 
-static inline wgpu::BindGroup create_camera_bind_group(
+static inline wgpu::BindGroup create_frame_bind_group(
     const wgpu::Device& device,
     wgpu::BindGroupLayout layout,
-    wgpu::Buffer projection_uniform
+    wgpu::Buffer frame_constants
 ) {
     auto entries = std::array {
         wgpu::BindGroupEntry {
             .binding = 0,
-            .buffer = projection_uniform,
+            .buffer = frame_constants,
             .offset = 0,
-            .size = sizeof(float[4][4]),
+            .size = sizeof(FrameConstants),
         },
     };
     auto bind_group_descriptor = wgpu::BindGroupDescriptor {
-        .label = "Camera"sv,
+        .label = "Frame Constants"sv,
         .layout = layout,
         .entryCount = entries.size(),
         .entries = entries.data(),
@@ -47,96 +59,367 @@ static inline wgpu::BindGroup create_camera_bind_group(
     return device.CreateBindGroup(&bind_group_descriptor);
 }
 
-Scene::Scene(wgpu::Device device, wgpu::Queue queue, CanvasFormat surface_format)
+Scene::Scene(
+    wgpu::Instance instance,
+    wgpu::Device device,
+    wgpu::Queue queue,
+    CanvasFormat surface_format
+)
     : device(std::move(device))
     , queue(std::move(queue))
     , surface_color_format(surface_format.color_format)
-    , surface_depth_stencil_format(surface_format.depth_stencil_format) {
-    // Projection uniform buffer.
-    auto projection_uniform_buffer_descriptor = wgpu::BufferDescriptor {
+    , surface_depth_stencil_format(surface_format.depth_stencil_format)
+    , start_time(std::chrono::steady_clock::now()) {
+    // Frame constants uniform buffer, written in `add_passes`.
+    auto frame_constants_buffer_descriptor = wgpu::BufferDescriptor {
+        .label = "Frame Constants"sv,
         .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
-        .size = sizeof(float[4][4]),
+        .size = sizeof(FrameConstants),
         .mappedAtCreation = false,
     };
-    this->projection_uniform = this->device.CreateBuffer(&projection_uniform_buffer_descriptor);
+    this->frame_constants_buffer = this->device.CreateBuffer(&frame_constants_buffer_descriptor);
 
-    auto identity4x4 = glm::identity<glm::mat4x4>();
-    this->queue.WriteBuffer(this->projection_uniform, 0, &identity4x4, sizeof(identity4x4));
+    this->frame_bind_group_layout = create_frame_bind_group_layout(this->device);
+    this->frame_bind_group = create_frame_bind_group(
+        this->device,
+        this->frame_bind_group_layout,
+        this->frame_constants_buffer
+    );
 
-    this->camera_bind_group_layout = create_camera_bind_group_layout(this->device);
-    this->camera_bind_group =
-        create_camera_bind_group(this->device, this->camera_bind_group_layout, projection_uniform);
+    this->pipeline_cache =
+        PipelineCache(this->device, surface_format, this->frame_bind_group_layout);
+    this->instances = InstanceBuffer(this->device);
+    this->staging_belt = StagingBelt(std::move(instance), this->device);
+    this->geometry_pool = std::make_shared<GeometryPool>(this->device, this->queue);
+    this->uniform_arena = std::make_shared<UniformArena>(this->device);
+    this->gpu_culler = GpuCuller(this->device);
+#if defined(__EMSCRIPTEN__)
+    this->device_is_thread_safe = false;
+#else
+    this->device_is_thread_safe =
+        this->device.HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization);
+#endif
+    this->device_supports_gpu_culling =
+        this->device.HasFeature(wgpu::FeatureName::IndirectFirstInstance);
 
     this->camera = nullptr;
-    this->entities = std::vector<Entity> {};
 }
 
 void Scene::set_camera(std::shared_ptr<CameraBase> camera) {
     this->camera = camera;
 }
 
+void Scene::set_job_system(std::shared_ptr<JobSystem> jobs) {
+    this->jobs = std::move(jobs);
+}
+
+template <class F>
+void Scene::parallel_for(size_t count, size_t chunk_size, F&& f) {
+    if (this->jobs != nullptr) {
+        this->jobs->parallel_for(count, chunk_size, std::forward<F>(f));
+        return;
+    }
+    for (size_t chunk = 0, begin = 0; begin < count; ++chunk, begin += chunk_size) {
+        f(chunk, begin, std::min(begin + chunk_size, count));
+    }
+}
+
+void Scene::set_lights(std::span<const Light> lights) {
+    if (lights.size() > MAX_LIGHTS) {
+        log_warn("only the first {} of {} lights are used", MAX_LIGHTS, lights.size());
+        lights = lights.first(MAX_LIGHTS);
+    }
+    this->lights.assign(lights.begin(), lights.end());
+}
+
 EntityId Scene::create_entity(
     std::shared_ptr<GeometryBase> geometry,
     std::shared_ptr<MaterialBase> material
 ) {
-    auto entity = Entity(
+    auto id = this->entities.insert(Entity(
         this->device,
-        this->queue,
-        this->surface_color_format,
-        this->surface_depth_stencil_format,
-        this->camera_bind_group_layout,
+        this->pipeline_cache,
+        this->instances,
         std::move(geometry),
-        std::move(material)
-    );
-    this->entities.push_back(std::move(entity));
-    return EntityId(this->entities.size());
+        std::move(material),
+        this->fallback_material
+    ));
+    this->entities.get(id)->slot_index = id.index;
+    // Also inserts the entity into `bvh` on the next update.
+    this->transforms.set(id.index, Transform {});
+    this->gpu_groups_dirty = true;
+    return id;
 }
 
 Entity& Scene::get_entity(EntityId id) {
-    assert(id.index <= this->entities.size());
-    auto& entity = this->entities[id.index - 1];
-    assert(entity != nullptr);
-    return entity;
+    auto* entity = this->entities.get(id);
+    if (entity == nullptr) {
+        log_error(
+            "stale or null entity ID (index: {}, generation: {})",
+            id.index,
+            id.generation
+        );
+        abort();
+    }
+    return *entity;
+}
+
+bool Scene::contains_entity(EntityId id) const {
+    return this->entities.contains(id);
 }
 
 void Scene::delete_entity(EntityId id) {
-    assert(id.index <= this->entities.size());
-    this->entities[id.index - 1] = nullptr;
+    auto* entity = this->entities.get(id);
+    if (entity == nullptr) {
+        log_warn(
+            "deleting stale or null entity ID (index: {}, generation: {})",
+            id.index,
+            id.generation
+        );
+        return;
+    }
+    if (entity->is_static()) {
+        this->static_bundles_dirty = true;
+    }
+    if (entity->bvh_proxy != DynamicBvh::NULL_NODE) {
+        this->bvh.remove(entity->bvh_proxy);
+    }
+    this->transforms.remove(id.index);
+    this->entities.remove(id);
+    this->gpu_groups_dirty = true;
+}
+
+void Scene::set_entity_transform(EntityId id, const Transform& transform) {
+    this->get_entity(id);
+    this->transforms.set(id.index, transform);
+}
+
+Transform Scene::get_entity_transform(EntityId id) {
+    this->get_entity(id);
+    return this->transforms.get(id.index);
+}
+
+void Scene::set_entity_parent(EntityId id, EntityId parent) {
+    this->get_entity(id);
+    auto parent_slot = TransformSystem::NULL_SLOT;
+    if (parent != nullptr) {
+        this->get_entity(parent);
+        parent_slot = parent.index;
+    }
+    if (!this->transforms.set_parent(id.index, parent_slot)) {
+        log_error(
+            "setting entity {} as parent of entity {} would make a cycle",
+            parent.index,
+            id.index
+        );
+        abort();
+    }
+}
+
+EntityId Scene::get_entity_parent(EntityId id) {
+    this->get_entity(id);
+    auto parent_slot = this->transforms.get_parent(id.index);
+    if (parent_slot == TransformSystem::NULL_SLOT) {
+        return EntityId {};
+    }
+    return this->entities.key_at(this->entities.dense_index_of(parent_slot));
+}
+
+void Scene::set_entity_static(EntityId id, bool is_static) {
+    auto& entity = this->get_entity(id);
+    if (entity.is_static() != is_static) {
+        entity.set_static(is_static);
+        this->static_bundles_dirty = true;
+    }
+}
+
+void Scene::set_entity_material(EntityId id, std::shared_ptr<MaterialBase> material) {
+    auto& entity = this->get_entity(id);
+    entity.set_material(
+        this->device,
+        this->pipeline_cache,
+        std::move(material),
+        this->fallback_material
+    );
+    if (entity.is_static()) {
+        this->static_bundles_dirty = true;
+    }
+    this->gpu_groups_dirty = true;
+}
+
+void Scene::set_fallback_material(std::shared_ptr<MaterialBase> material) {
+    this->fallback_material = std::move(material);
+}
+
+void Scene::update_pending_pipelines() {
+    if (!this->pipeline_cache.collect_compiled()) {
+        return;
+    }
+    for (auto& entity : this->entities.values()) {
+        auto changed = entity.update_pending_pipeline(this->device, this->pipeline_cache);
+        if (changed) {
+            if (entity.is_static()) {
+                this->static_bundles_dirty = true;
+            }
+            this->gpu_groups_dirty = true;
+        }
+    }
+}
+
+void Scene::set_entity_hidden(EntityId id, bool is_hidden) {
+    auto& entity = this->get_entity(id);
+    if (entity.is_hidden() != is_hidden) {
+        entity.set_hidden(is_hidden);
+        if (entity.is_static()) {
+            this->static_bundles_dirty = true;
+        }
+        this->gpu_groups_dirty = true;
+    }
+}
+
+uint32_t Scene::add_snapshot_color_material(std::shared_ptr<ColorMaterial> material) {
+    this->snapshot_color_materials.push_back(std::move(material));
+    return (uint32_t)(this->snapshot_color_materials.size() - 1);
+}
+
+void Scene::apply_snapshot(const SceneSnapshot& snapshot) {
+    for (const auto& state : snapshot.entities) {
+        if (!this->contains_entity(state.id)) {
+            continue;
+        }
+        this->set_entity_transform(state.id, state.transform);
+        this->set_entity_hidden(state.id, state.hidden);
+    }
+    for (const auto& state : snapshot.color_materials) {
+        assert(state.material < this->snapshot_color_materials.size());
+        this->snapshot_color_materials[state.material]->set_color(this->queue, state.color);
+    }
+}
+
+const std::shared_ptr<GeometryPool>& Scene::get_geometry_pool() const {
+    return this->geometry_pool;
+}
+
+const std::shared_ptr<UniformArena>& Scene::get_uniform_arena() const {
+    return this->uniform_arena;
+}
+
+PipelineCache::Stats Scene::pipeline_cache_stats() const {
+    return this->pipeline_cache.stats();
+}
+
+std::span<const double> Scene::pipeline_compile_seconds() const {
+    return this->pipeline_cache.compile_seconds();
+}
+
+void Scene::save_pipeline_manifest(const std::filesystem::path& path) const {
+    this->pipeline_cache.save_manifest(path);
+}
+
+void Scene::warm_up_pipelines(
+    const std::filesystem::path& path,
+    std::span<const GeometryBase* const> geometries,
+    std::span<const MaterialBase* const> materials
+) {
+    this->pipeline_cache.warm_up(path, geometries, materials);
+}
+
+GeometryPool::Stats Scene::geometry_pool_stats() const {
+    return this->geometry_pool->stats();
+}
+
+UniformArena::Stats Scene::uniform_arena_stats() const {
+    return this->uniform_arena->stats();
+}
+
+void Scene::set_instancing_enabled(bool enabled) {
+    if (this->instancing_enabled != enabled) {
+        // Static bundles were recorded with the previous draw layout.
+        this->static_bundles_dirty = true;
+    }
+    this->instancing_enabled = enabled;
+}
+
+void Scene::set_culling_mode(CullingMode mode) {
+    if (mode == CullingMode::Gpu && !this->device_supports_gpu_culling) {
+        log_warn("GPU culling needs IndirectFirstInstance, culling with the BVH instead");
+        mode = CullingMode::Bvh;
+    }
+    if (this->culling_mode != mode) {
+        // Instance indices of static entities differ between CPU and GPU culling.
+        this->static_bundles_dirty = true;
+    }
+    this->culling_mode = mode;
+}
+
+std::optional<SceneRaycastHit> Scene::raycast(glm::vec3 origin, glm::vec3 direction) {
+    this->update_spatial_index();
+    auto hit = this->bvh.raycast(origin, direction);
+    if (!hit.has_value()) {
+        return std::nullopt;
+    }
+    return SceneRaycastHit {
+        .entity = this->entities.key_at(this->entities.dense_index_of(hit->user_data)),
+        .distance = hit->distance,
+    };
+}
+
+void Scene::query_aabb(const BoundingBox& box, std::vector<EntityId>& results) {
+    this->update_spatial_index();
+    this->bvh_results.clear();
+    this->bvh.query_aabb(box, this->bvh_results);
+    for (auto slot_index : this->bvh_results) {
+        results.push_back(this->entities.key_at(this->entities.dense_index_of(slot_index)));
+    }
+}
+
+RenderQueueStats Scene::render_queue_stats() const {
+    return this->render_queue_stats_;
+}
+
+CullingStats Scene::culling_stats() const {
+    return this->culling_stats_;
+}
+
+void Scene::set_frames_in_flight(uint32_t frames_in_flight) {
+    this->staging_belt.set_frames_in_flight(frames_in_flight);
+}
+
+StagingBelt::Stats Scene::staging_belt_stats() const {
+    return this->staging_belt.stats();
 }
 
 void Scene::draw(const Canvas& surface) {
-    if (surface.width == 0 || surface.height == 0) {
+    auto graph = RenderGraph(this->device, this->queue);
+    auto color = graph.import_texture(
+        "Surface Color"sv,
+        surface.get_color_texture(),
+        surface.color_texture_view
+    );
+    auto depth = graph.import_texture(
+        "Surface Depth"sv,
+        surface.depth_stencil_texture,
+        surface.depth_stencil_texture_view
+    );
+    this->add_passes(graph, color, depth);
+    graph.execute();
+}
+
+void Scene::add_passes(RenderGraph& graph, RenderGraphResource color, RenderGraphResource depth) {
+    const auto& target = graph.get_texture_info(color);
+    if (target.width == 0 || target.height == 0) {
         log_warn(
-            "Scene::draw called on surface with zero pixels (surface size: {}x{})",
-            surface.width,
-            surface.height
+            "Scene::add_passes called on target with zero pixels (target size: {}x{})",
+            target.width,
+            target.height
         );
         return;
     }
 
-    std::optional<glm::vec3> clear_color_ = glm::vec3(0, 0, 0);
-    auto clear_color = glm::convertSRGBToLinear(clear_color_.value_or(glm::vec3(0, 0, 0)));
+    this->update_pending_pipelines();
 
-    auto encoder = this->device.CreateCommandEncoder();
-    auto color_attachment = wgpu::RenderPassColorAttachment {
-        .view = surface.color_texture_view,
-        .loadOp = clear_color_.has_value() ? wgpu::LoadOp::Clear : wgpu::LoadOp::Load,
-        .storeOp = wgpu::StoreOp::Store,
-        .clearValue = wgpu::Color {clear_color.r, clear_color.g, clear_color.b, 1.0},
-    };
-    auto depth_stencil_attachment = wgpu::RenderPassDepthStencilAttachment {
-        .view = surface.depth_stencil_texture_view,
-        .depthLoadOp = wgpu::LoadOp::Clear,
-        .depthStoreOp = wgpu::StoreOp::Store,
-        .depthClearValue = 1.0,
-        .depthReadOnly = false,
-    };
-    auto render_pass_descriptor = wgpu::RenderPassDescriptor {
-        .colorAttachmentCount = 1,
-        .colorAttachments = &color_attachment,
-        .depthStencilAttachment = &depth_stencil_attachment,
-    };
-    auto render_pass = encoder.BeginRenderPass(&render_pass_descriptor);
+    // Waits for the GPU if it is `frames_in_flight` frames behind.
+    this->staging_belt.begin_frame();
 
     glm::vec3 view_position;
     glm::mat4x4 view_matrix;
@@ -145,27 +428,586 @@ void Scene::draw(const Canvas& surface) {
         view_position = this->camera->view_position();
         view_matrix = this->camera->view_matrix();
         projection_matrix =
-            this->camera->projection_matrix((float)surface.width, (float)surface.height);
+            this->camera->projection_matrix((float)target.width, (float)target.height);
     } else {
         view_position = glm::vec3(0, 0, 0);
         view_matrix = glm::identity<glm::mat4x4>();
         projection_matrix = glm::identity<glm::mat4x4>();
     }
 
-    this->queue
-        .WriteBuffer(this->projection_uniform, 0, &projection_matrix, sizeof(projection_matrix));
+    auto time = std::chrono::steady_clock::now() - this->start_time;
+    auto frame_constants = FrameConstants {
+        .projection = projection_matrix,
+        .view = view_matrix,
+        .view_projection = projection_matrix * view_matrix,
+        .view_position = view_position,
+        .time = std::chrono::duration<float>(time).count(),
+        .light_count = (uint32_t)this->lights.size(),
+        .lights = {},
+    };
+    std::ranges::copy(this->lights, frame_constants.lights.begin());
+    std::memcpy(
+        this->staging_belt.write(this->frame_constants_buffer, 0, sizeof(frame_constants)).data(),
+        &frame_constants,
+        sizeof(frame_constants)
+    );
+
+    this->update_spatial_index();
+    auto frustum = Frustum::from_view_projection(frame_constants.view_projection);
+    auto is_gpu_driven = this->culling_mode == CullingMode::Gpu;
+    if (is_gpu_driven) {
+        this->prepare_gpu_driven(frustum);
+    } else {
+        this->prepare_cpu_culled(frustum, view_matrix);
+    }
+
+    // Everything is staged, the passes only record commands.
+    auto instance_buffer = graph.import_buffer("Instances"sv, this->instances.get_buffer());
+    auto uploaded = std::vector {
+        graph.import_buffer("Frame Constants"sv, this->frame_constants_buffer),
+        instance_buffer,
+    };
+    auto scene_reads = uploaded;
+    auto culls_on_gpu = is_gpu_driven && this->gpu_culler.get_draw_arguments() != nullptr;
+    auto draw_arguments = RenderGraphResource {};
+    auto visible_instances = RenderGraphResource {};
+    if (culls_on_gpu) {
+        draw_arguments =
+            graph.import_buffer("Draw Arguments"sv, this->gpu_culler.get_draw_arguments());
+        visible_instances =
+            graph.import_buffer("Visible Instances"sv, this->gpu_culler.get_visible_instances());
+        // The belt resets instance counts of the draw arguments.
+        uploaded.push_back(draw_arguments);
+        scene_reads.push_back(draw_arguments);
+        scene_reads.push_back(visible_instances);
+    }
+
+    graph.add_pass({
+        .name = "Scene Uploads"sv,
+        .reads = {},
+        .writes = uploaded,
+        .execute = [this](wgpu::CommandEncoder& encoder, const RenderGraph&) {
+            this->staging_belt.finish(encoder);
+        },
+    });
+    graph.on_submitted([this] { this->staging_belt.recycle(); });
+
+    if (culls_on_gpu) {
+        graph.add_pass({
+            .name = "GPU Culling"sv,
+            .reads = {instance_buffer},
+            .writes = {draw_arguments, visible_instances},
+            .execute = [this](wgpu::CommandEncoder& encoder, const RenderGraph&) {
+                this->gpu_culler.cull(encoder);
+            },
+        });
+    }
+
+    auto encode_scene = [this, color, depth, is_gpu_driven](
+                            wgpu::CommandEncoder& encoder,
+                            const RenderGraph& graph
+                        ) {
+        std::optional<glm::vec3> clear_color_ = glm::vec3(0, 0, 0);
+        auto clear_color = glm::convertSRGBToLinear(clear_color_.value_or(glm::vec3(0, 0, 0)));
+
+        auto color_attachment = wgpu::RenderPassColorAttachment {
+            .view = graph.get_texture_view(color),
+            .loadOp = clear_color_.has_value() ? wgpu::LoadOp::Clear : wgpu::LoadOp::Load,
+            .storeOp = wgpu::StoreOp::Store,
+            .clearValue = wgpu::Color {clear_color.r, clear_color.g, clear_color.b, 1.0},
+        };
+        auto depth_stencil_attachment = wgpu::RenderPassDepthStencilAttachment {
+            .view = graph.get_texture_view(depth),
+            .depthLoadOp = wgpu::LoadOp::Clear,
+            .depthStoreOp = wgpu::StoreOp::Store,
+            .depthClearValue = 1.0,
+            .depthReadOnly = false,
+        };
+        auto render_pass_descriptor = wgpu::RenderPassDescriptor {
+            .label = "Scene"sv,
+            .colorAttachmentCount = 1,
+            .colorAttachments = &color_attachment,
+            .depthStencilAttachment = &depth_stencil_attachment,
+        };
+        auto render_pass = encoder.BeginRenderPass(&render_pass_descriptor);
+        // Transient targets may be larger than their info. Bundles keep the viewport of the pass.
+        const auto& target = graph.get_texture_info(color);
+        render_pass.SetViewport(0.0f, 0.0f, (float)target.width, (float)target.height, 0.0f, 1.0f);
+        render_pass.SetScissorRect(0, 0, target.width, target.height);
+        if (is_gpu_driven) {
+            this->encode_gpu_driven(render_pass);
+        } else {
+            this->encode_cpu_culled(render_pass);
+        }
+        render_pass.End();
+    };
+    graph.add_pass({
+        .name = "Scene"sv,
+        .reads = scene_reads,
+        .writes = {color, depth},
+        .execute = encode_scene,
+    });
+}
+
+void Scene::prepare_cpu_culled(const Frustum& frustum, const glm::mat4x4& view_matrix) {
+    this->cull_entities(frustum);
+
+    if (this->static_bundles_dirty) {
+        this->update_static_order();
+    }
+
+    // Render queue of visible dynamic entities.
+    auto queue_build_start = std::chrono::steady_clock::now();
+    auto entities = this->entities.values();
+    this->sort_keys.resize(entities.size());
+    this->parallel_for(entities.size(), PREPARE_CHUNK_SIZE, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto& entity = entities[i];
+            if (!entity.is_static() && this->entity_visibility[i]) {
+                const auto& model_matrix = this->transforms.get_model_matrix(entity.slot_index);
+                this->sort_keys[i] = entity.sort_key(view_matrix, model_matrix);
+            }
+        }
+    });
+    this->render_queue.clear();
+    for (size_t i = 0; i < entities.size(); ++i) {
+        if (!entities[i].is_static() && this->entity_visibility[i]) {
+            this->render_queue.push(this->sort_keys[i], (uint32_t)i);
+        }
+    }
+    auto queue_sort_start = std::chrono::steady_clock::now();
+    this->render_queue.sort();
+    auto queue_sort_end = std::chrono::steady_clock::now();
+    this->render_queue_stats_ = RenderQueueStats {
+        .item_count = this->render_queue.get_items().size(),
+        .build_seconds =
+            std::chrono::duration<double>(queue_sort_start - queue_build_start).count(),
+        .sort_seconds = std::chrono::duration<double>(queue_sort_end - queue_sort_start).count(),
+    };
+    this->dynamic_order.clear();
+    for (const auto& item : this->render_queue.get_items()) {
+        this->dynamic_order.push_back(item.entity_index);
+    }
+
+    // Per-frame data, static entities first.
+    this->instances.begin_frame();
+    this->instance_slots.clear();
+    this->static_dense_order.clear();
+    for (auto slot_index : this->static_order) {
+        this->static_dense_order.push_back(this->entities.dense_index_of(slot_index));
+    }
+    auto static_order = std::span<const uint32_t>(this->static_dense_order);
+    for (auto& batch : this->static_batches) {
+        auto entity_indices = static_order.subspan(batch.begin, batch.end - batch.begin);
+        batch.visible = std::ranges::any_of(entity_indices, [&](uint32_t i) {
+            return this->entity_visibility[i] != 0;
+        });
+        this->prepare_entities(entity_indices, batch.visible);
+    }
+    this->prepare_entities(this->dynamic_order);
+    this->write_instance_transforms(this->instances.stage(this->staging_belt));
+
+    if (this->static_bundles_dirty ||
+        this->static_bundles_instances_generation != this->instances.get_generation() ||
+        this->static_bundles_geometry_pool_generation != this->geometry_pool->get_generation()) {
+        this->record_static_bundles();
+    }
+    this->frame_bundles.clear();
+    for (const auto& batch : this->static_batches) {
+        if (batch.visible) {
+            this->frame_bundles.push_back(batch.bundle);
+        }
+    }
+    this->dynamic_in_bundles = this->jobs != nullptr && this->device_is_thread_safe &&
+                               this->dynamic_order.size() >= 2 * RECORD_CHUNK_SIZE;
+    if (this->dynamic_in_bundles) {
+        this->record_dynamic_bundles();
+    }
+}
+
+void Scene::encode_cpu_culled(wgpu::RenderPassEncoder& render_pass) {
+    if (!this->frame_bundles.empty()) {
+        render_pass.ExecuteBundles(this->frame_bundles.size(), this->frame_bundles.data());
+    }
+
+    if (!this->dynamic_in_bundles) {
+        // `ExecuteBundles` clears all states of the render pass, so this comes after it.
+        render_pass.SetBindGroup(0, this->frame_bind_group);
+        auto render_pass_state = RenderPassState {};
+        this->encode_entities(render_pass, this->dynamic_order, render_pass_state);
+    }
+}
+
+void Scene::prepare_gpu_driven(const Frustum& frustum) {
+    if (this->gpu_groups_dirty ||
+        this->gpu_groups_geometry_pool_generation != this->geometry_pool->get_generation()) {
+        this->update_gpu_groups();
+    }
+
+    // One instance per entity in `gpu_order`, all of them written, as visibility is only known on
+    // the GPU.
+    this->instances.begin_frame();
+    this->instance_slots.clear();
+    this->gpu_dense_order.clear();
+    for (auto slot_index : this->gpu_order) {
+        this->gpu_dense_order.push_back(this->entities.dense_index_of(slot_index));
+    }
+    this->prepare_entities(this->gpu_dense_order);
+    this->write_instance_transforms(this->instances.stage(this->staging_belt));
+
+    this->gpu_culler.stage(this->staging_belt, frustum, this->instances.get_buffer());
+
+    this->render_queue_stats_ = RenderQueueStats {};
+    this->culling_stats_ = CullingStats {
+        .tested_count = this->gpu_order.size(),
+        .culled_count = 0,
+        .seconds = 0,
+    };
+}
+
+void Scene::encode_gpu_driven(wgpu::RenderPassEncoder& render_pass) {
+    render_pass.SetBindGroup(0, this->frame_bind_group);
+    auto render_pass_state = RenderPassState {};
+    auto entities = this->entities.values();
+    for (size_t group = 0; group < this->gpu_group_leaders.size(); ++group) {
+        auto& entity = entities[this->entities.dense_index_of(this->gpu_group_leaders[group])];
+        entity.draw_indirect_commands(
+            this->device,
+            this->gpu_culler,
+            (uint32_t)group,
+            render_pass,
+            render_pass_state
+        );
+    }
+}
+
+void Scene::update_gpu_groups() {
+    // Sorted like static entities, so that entities of a group are contiguous.
+    auto gpu_queue = RenderQueue();
+    auto identity = glm::identity<glm::mat4x4>();
+    for (const auto& entity : this->entities.values()) {
+        if (!entity.is_drawn()) {
+            continue;
+        }
+        auto key = entity.sort_key(identity, identity) & ~RenderQueue::DEPTH_MASK;
+        gpu_queue.push(key, entity.slot_index);
+    }
+    gpu_queue.sort();
+    this->gpu_order.clear();
+    for (const auto& item : gpu_queue.get_items()) {
+        this->gpu_order.push_back(item.entity_index);
+    }
+
+    // One group per run of entities that could be drawn instanced.
+    this->gpu_group_leaders.clear();
+    auto cull_entities = std::vector<GpuCullEntity>();
+    auto group_parameters = std::vector<DrawParameters>();
+    cull_entities.reserve(this->gpu_order.size());
+    auto entities = this->entities.values();
+    const Entity* leader = nullptr;
+    for (auto slot_index : this->gpu_order) {
+        const auto& entity = entities[this->entities.dense_index_of(slot_index)];
+        if (leader == nullptr || leader->get_pipeline_id() != entity.get_pipeline_id() ||
+            leader->get_geometry() != entity.get_geometry() ||
+            leader->get_material() != entity.get_material()) {
+            leader = &entity;
+            this->gpu_group_leaders.push_back(slot_index);
+            group_parameters.push_back(entity.get_geometry()->draw_parameters());
+        }
+        auto bounds = entity.get_geometry()->local_bounds();
+        cull_entities.push_back(GpuCullEntity {
+            .local_min = bounds.has_value() ? bounds->min : glm::vec3(0, 0, 0),
+            .group = (uint32_t)(group_parameters.size() - 1),
+            .local_max = bounds.has_value() ? bounds->max : glm::vec3(0, 0, 0),
+            .always_visible = !bounds.has_value(),
+        });
+    }
+    this->gpu_culler.set_entities(this->queue, cull_entities, group_parameters);
+    this->gpu_groups_dirty = false;
+    this->gpu_groups_geometry_pool_generation = this->geometry_pool->get_generation();
+}
+
+void Scene::update_spatial_index() {
+    this->transforms.update();
+    auto entities = this->entities.values();
+    for (auto slot_index : this->transforms.get_updated()) {
+        // Deleted since it moved.
+        if (!this->entities.slot_is_live(slot_index)) {
+            continue;
+        }
+        auto& entity = entities[this->entities.dense_index_of(slot_index)];
+        auto bounds = entity.world_bounds(this->transforms.get_model_matrix(slot_index));
+        if (!bounds.has_value()) {
+            continue;
+        }
+        if (entity.bvh_proxy == DynamicBvh::NULL_NODE) {
+            entity.bvh_proxy = this->bvh.insert(bounds.value(), slot_index);
+        } else {
+            this->bvh.update(entity.bvh_proxy, bounds.value());
+        }
+    }
+    if (this->bvh.rebuild_if_degraded()) {
+        log_verbose(
+            "rebuilt BVH of {} entities, height {}",
+            this->bvh.leaf_count(),
+            this->bvh.height()
+        );
+    }
+}
+
+void Scene::cull_entities(const Frustum& frustum) {
+    switch (this->culling_mode) {
+    case CullingMode::Disabled:
+    case CullingMode::Gpu: {
+        this->entity_visibility.assign(this->entities.size(), 1);
+        this->culling_stats_ = CullingStats {};
+    } break;
+    case CullingMode::Linear: {
+        this->cull_entities_linear(frustum);
+    } break;
+    case CullingMode::Bvh: {
+        auto start = std::chrono::steady_clock::now();
+        // Entities without bounds are always visible.
+        auto entities = this->entities.values();
+        this->entity_visibility.resize(entities.size());
+        for (size_t i = 0; i < entities.size(); ++i) {
+            this->entity_visibility[i] = (uint8_t)(entities[i].bvh_proxy == DynamicBvh::NULL_NODE);
+        }
+        this->bvh_results.clear();
+        this->bvh.query_frustum(frustum, this->bvh_results);
+        for (auto slot_index : this->bvh_results) {
+            this->entity_visibility[this->entities.dense_index_of(slot_index)] = 1;
+        }
+        auto end = std::chrono::steady_clock::now();
+        this->culling_stats_ = CullingStats {
+            .tested_count = this->bvh.leaf_count(),
+            .culled_count = this->bvh.leaf_count() - this->bvh_results.size(),
+            .seconds = std::chrono::duration<double>(end - start).count(),
+        };
+    } break;
+    }
+
+    auto entities = this->entities.values();
+    for (size_t i = 0; i < entities.size(); ++i) {
+        if (!entities[i].is_drawn()) {
+            this->entity_visibility[i] = 0;
+        }
+    }
+}
+
+void Scene::cull_entities_linear(const Frustum& frustum) {
+    this->entity_visibility.assign(this->entities.size(), 1);
+    auto start = std::chrono::steady_clock::now();
+    auto entities = this->entities.values();
+    auto chunk_count = (entities.size() + PREPARE_CHUNK_SIZE - 1) / PREPARE_CHUNK_SIZE;
+    // Never shrunk, to keep the allocations of cullers.
+    if (this->culling_chunks.size() < chunk_count) {
+        this->culling_chunks.resize(chunk_count);
+    }
+    auto cull_chunk = [&](size_t chunk_index, size_t begin, size_t end) {
+        auto& chunk = this->culling_chunks[chunk_index];
+        chunk.culler.clear();
+        chunk.entity_indices.clear();
+        for (size_t i = begin; i < end; ++i) {
+            const auto& model_matrix = this->transforms.get_model_matrix(entities[i].slot_index);
+            if (auto bounds = entities[i].world_bounds(model_matrix); bounds.has_value()) {
+                chunk.culler.push(bounds.value());
+                chunk.entity_indices.push_back((uint32_t)i);
+            }
+        }
+        chunk.culler.cull(frustum);
+        auto visibility = chunk.culler.get_visibility();
+        chunk.stats = CullingStats {
+            .tested_count = visibility.size(),
+            .culled_count = 0,
+            .seconds = 0,
+        };
+        for (size_t i = 0; i < visibility.size(); ++i) {
+            this->entity_visibility[chunk.entity_indices[i]] = visibility[i];
+            chunk.stats.culled_count += visibility[i] == 0;
+        }
+    };
+    this->parallel_for(entities.size(), PREPARE_CHUNK_SIZE, cull_chunk);
+    auto end = std::chrono::steady_clock::now();
+    this->culling_stats_ = CullingStats {
+        .tested_count = 0,
+        .culled_count = 0,
+        .seconds = std::chrono::duration<double>(end - start).count(),
+    };
+    for (const auto& chunk : std::span(this->culling_chunks).first(chunk_count)) {
+        this->culling_stats_.tested_count += chunk.stats.tested_count;
+        this->culling_stats_.culled_count += chunk.stats.culled_count;
+    }
+}
+
+void Scene::update_static_order() {
+    // Sorted like the render queue but without depth, so that the order does not depend on the
+    // camera.
+    auto static_queue = RenderQueue();
+    for (const auto& entity : this->entities.values()) {
+        if (entity.is_static() && entity.is_drawn()) {
+            auto identity = glm::identity<glm::mat4x4>();
+            auto key = entity.sort_key(identity, identity) & ~RenderQueue::DEPTH_MASK;
+            static_queue.push(key, entity.slot_index);
+        }
+    }
+    static_queue.sort();
+    this->static_order.clear();
+    for (const auto& item : static_queue.get_items()) {
+        this->static_order.push_back(item.entity_index);
+    }
+
+    // One batch per pipeline.
+    this->static_batches.clear();
+    auto entities = this->entities.values();
+    auto pipeline_id_of = [&](uint32_t slot_index) {
+        return entities[this->entities.dense_index_of(slot_index)].get_pipeline_id();
+    };
+    for (size_t begin = 0; begin < this->static_order.size();) {
+        auto pipeline_id = pipeline_id_of(this->static_order[begin]);
+        auto end = begin + 1;
+        while (end < this->static_order.size() &&
+               pipeline_id_of(this->static_order[end]) == pipeline_id) {
+            ++end;
+        }
+        this->static_batches.push_back(StaticBatch {
+            .begin = begin,
+            .end = end,
+            .bundle = nullptr,
+            .visible = true,
+        });
+        begin = end;
+    }
+}
 
-    render_pass.SetBindGroup(0, this->camera_bind_group);
+void Scene::record_static_bundles() {
+    auto bundle_encoder_descriptor = wgpu::RenderBundleEncoderDescriptor {
+        .label = "Static Entities"sv,
+        .colorFormatCount = 1,
+        .colorFormats = &this->surface_color_format,
+        .depthStencilFormat = this->surface_depth_stencil_format,
+        .sampleCount = 1,
+    };
+    auto static_order = std::span<const uint32_t>(this->static_dense_order);
+    // Batches have disjoint entities, so their lazily created bind groups can be too.
+    auto record_batches = [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            auto& batch = this->static_batches[i];
+            auto bundle_encoder =
+                this->device.CreateRenderBundleEncoder(&bundle_encoder_descriptor);
+            bundle_encoder.SetBindGroup(0, this->frame_bind_group);
+            auto render_pass_state = RenderPassState {};
+            this->encode_entities(
+                bundle_encoder,
+                static_order.subspan(batch.begin, batch.end - batch.begin),
+                render_pass_state
+            );
+            batch.bundle = bundle_encoder.Finish();
+        }
+    };
+    if (this->device_is_thread_safe) {
+        this->parallel_for(this->static_batches.size(), 1, record_batches);
+    } else {
+        record_batches(0, 0, this->static_batches.size());
+    }
+    this->static_bundles_dirty = false;
+    this->static_bundles_instances_generation = this->instances.get_generation();
+    this->static_bundles_geometry_pool_generation = this->geometry_pool->get_generation();
+    log_verbose(
+        "recorded {} render bundles for {} static entities",
+        this->static_batches.size(),
+        this->static_order.size()
+    );
+}
 
-    for (auto& entity : this->entities) {
-        if (entity != nullptr) {
-            entity.prepare_for_drawing(this->queue, view_position, view_matrix);
-            entity.draw_commands(render_pass);
+void Scene::record_dynamic_bundles() {
+    auto entities = this->entities.values();
+    auto dynamic_order = std::span<const uint32_t>(this->dynamic_order);
+    this->dynamic_chunk_bounds.clear();
+    this->dynamic_chunk_bounds.push_back(0);
+    while (this->dynamic_chunk_bounds.back() < dynamic_order.size()) {
+        auto end =
+            std::min(this->dynamic_chunk_bounds.back() + RECORD_CHUNK_SIZE, dynamic_order.size());
+        while (this->instancing_enabled && end < dynamic_order.size() &&
+               entities[dynamic_order[end - 1]].can_draw_instanced_with(
+                   entities[dynamic_order[end]]
+               )) {
+            ++end;
         }
+        this->dynamic_chunk_bounds.push_back(end);
     }
 
-    render_pass.End();
+    auto bundle_encoder_descriptor = wgpu::RenderBundleEncoderDescriptor {
+        .label = "Dynamic Entities"sv,
+        .colorFormatCount = 1,
+        .colorFormats = &this->surface_color_format,
+        .depthStencilFormat = this->surface_depth_stencil_format,
+        .sampleCount = 1,
+    };
+    auto chunk_count = this->dynamic_chunk_bounds.size() - 1;
+    auto first_bundle = this->frame_bundles.size();
+    this->frame_bundles.resize(first_bundle + chunk_count);
+    // Chunks have disjoint entities, so their lazily created bind groups can be too.
+    this->parallel_for(chunk_count, 1, [&](size_t chunk, size_t, size_t) {
+        auto begin = this->dynamic_chunk_bounds[chunk];
+        auto end = this->dynamic_chunk_bounds[chunk + 1];
+        auto bundle_encoder = this->device.CreateRenderBundleEncoder(&bundle_encoder_descriptor);
+        bundle_encoder.SetBindGroup(0, this->frame_bind_group);
+        auto render_pass_state = RenderPassState {};
+        this->encode_entities(
+            bundle_encoder,
+            dynamic_order.subspan(begin, end - begin),
+            render_pass_state
+        );
+        this->frame_bundles[first_bundle + chunk] = bundle_encoder.Finish();
+    });
+}
+
+void Scene::write_instance_transforms(std::span<InstanceTransforms> instances) {
+    auto slots = std::span<const uint32_t>(this->instance_slots);
+    this->parallel_for(slots.size(), PREPARE_CHUNK_SIZE, [&](size_t, size_t begin, size_t end) {
+        this->transforms.write_instances(
+            slots.subspan(begin, end - begin),
+            instances.subspan(begin, end - begin)
+        );
+    });
+}
+
+void Scene::prepare_entities(std::span<const uint32_t> entity_indices, bool visible) {
+    // Instances are pushed in draw order, so that instances of the same draw call are contiguous.
+    auto entities = this->entities.values();
+    for (auto entity_index : entity_indices) {
+        auto& entity = entities[entity_index];
+        entity.prepare_for_drawing(this->instances);
+        this->instance_slots.push_back(visible ? entity.slot_index : TransformSystem::NULL_SLOT);
+    }
+}
 
-    auto command_buffer = encoder.Finish();
-    this->device.GetQueue().Submit(1, &command_buffer);
+template <RenderCommandEncoder E>
+void Scene::encode_entities(
+    E& encoder,
+    std::span<const uint32_t> entity_indices,
+    RenderPassState& render_pass_state
+) {
+    auto entities = this->entities.values();
+    for (size_t i = 0; i < entity_indices.size();) {
+        auto& entity = entities[entity_indices[i]];
+        auto j = i + 1;
+        if (this->instancing_enabled) {
+            while (j < entity_indices.size() &&
+                   entities[entity_indices[j - 1]].can_draw_instanced_with(
+                       entities[entity_indices[j]]
+                   )) {
+                ++j;
+            }
+        }
+        entity.draw_commands(
+            this->device,
+            this->instances,
+            encoder,
+            render_pass_state,
+            (uint32_t)(j - i)
+        );
+        i = j;
+    }
 }
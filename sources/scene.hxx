@@ -1,17 +1,73 @@
 #pragma once
 
+#include <chrono>
 #include <webgpu/webgpu_cpp.h>
 
+#include "bvh.hxx"
 #include "camera/base.hxx"
 #include "canvas.hxx"
+#include "culling.hxx"
 #include "entity.hxx"
+#include "frame_constants.hxx"
+#include "geometry/pool.hxx"
+#include "gpu_culling.hxx"
+#include "instance_buffer.hxx"
+#include "job_system.hxx"
+#include "material/color.hxx"
+#include "pipeline_cache.hxx"
+#include "render_graph.hxx"
+#include "render_queue.hxx"
+#include "slot_map.hxx"
+#include "staging_belt.hxx"
+#include "transform_system.hxx"
+#include "uniform_arena.hxx"
 
-struct EntityId {
-    size_t index;
+/// Zero-initialized IDs are null, IDs of deleted entities are detected as stale.
+using EntityId = SlotKey;
 
-    constexpr bool operator==(nullptr_t) const {
-        return this->index == 0;
-    }
+struct SceneRaycastHit {
+    EntityId entity;
+    /// Distance along the ray direction to where it enters the entity's bounding box.
+    float distance;
+};
+
+/// State of a scene produced by a simulation on another thread, applied by the thread drawing the
+/// scene with `Scene::apply_snapshot`. Scenes are not thread-safe, so a simulation running on its
+/// own thread only writes snapshots, and hands them over with a `TripleBuffer`.
+///
+/// Snapshots hold the full state of what the simulation drives rather than changes, so that
+/// snapshots dropped by the handoff lose nothing. They refer to scene objects by IDs and indices
+/// only, never by owning pointers: the simulation could otherwise drop the last reference and
+/// destroy GPU resources off the render thread.
+struct SceneSnapshot {
+    struct EntityState {
+        EntityId id;
+        Transform transform;
+        bool hidden;
+    };
+
+    struct ColorMaterialState {
+        /// From `Scene::add_snapshot_color_material`.
+        uint32_t material;
+        glm::vec3 color;
+    };
+
+    /// Entities not in the snapshot are left as they are.
+    std::vector<EntityState> entities = {};
+    std::vector<ColorMaterialState> color_materials = {};
+};
+
+enum class CullingMode {
+    Disabled,
+    /// Test every entity with `FrustumCuller`.
+    Linear,
+    /// Traverse the scene's `DynamicBvh`.
+    Bvh,
+    /// Test every entity in a compute pass with `GpuCuller`, and draw with one indirect draw call
+    /// per run of entities sharing pipeline, geometry and material. Static entities are drawn like
+    /// dynamic ones, without render bundles, and `Scene::set_instancing_enabled` is ignored. Needs
+    /// `wgpu::FeatureName::IndirectFirstInstance`.
+    Gpu,
 };
 
 class Scene {
@@ -21,31 +77,326 @@ class Scene {
     wgpu::TextureFormat surface_color_format = wgpu::TextureFormat::Undefined;
     wgpu::TextureFormat surface_depth_stencil_format = wgpu::TextureFormat::Undefined;
 
-    wgpu::BindGroupLayout camera_bind_group_layout = nullptr;
-    wgpu::BindGroup camera_bind_group = nullptr;
-    wgpu::Buffer projection_uniform = nullptr;
+    /// `FrameConstants` at group 0 of every pipeline.
+    wgpu::BindGroupLayout frame_bind_group_layout = nullptr;
+    wgpu::BindGroup frame_bind_group = nullptr;
+    wgpu::Buffer frame_constants_buffer = nullptr;
+
+    std::chrono::steady_clock::time_point start_time = {};
+    std::vector<Light> lights = {};
+
+    /// Shared by all entities of this scene.
+    PipelineCache pipeline_cache = {};
+    /// Drawn by entities whose pipeline is compiling, nullable.
+    std::shared_ptr<MaterialBase> fallback_material = nullptr;
+    /// Materials that snapshots may change, by index. Kept alive by the scene.
+    std::vector<std::shared_ptr<ColorMaterial>> snapshot_color_materials = {};
+
+    /// Per-frame data of the current frame is written into it.
+    StagingBelt staging_belt = {};
+
+    /// Shared by pooled geometries (see `ModelGeometry`) created for this scene.
+    std::shared_ptr<GeometryPool> geometry_pool = nullptr;
+
+    /// Shared by materials (see `ColorMaterial`) created for this scene.
+    std::shared_ptr<UniformArena> uniform_arena = nullptr;
+
+    /// Per-entity transforms of the current frame.
+    InstanceBuffer instances = {};
+    /// Slot index of the entity of each instance of the current frame, `TransformSystem::NULL_SLOT`
+    /// for reserved instances of culled static entities.
+    std::vector<uint32_t> instance_slots = {};
+
+    /// Transforms of entities, by slot index.
+    TransformSystem transforms = {};
+
+    /// Whether adjacent entities in the render queue sharing geometry and material are drawn with
+    /// one instanced draw call.
+    bool instancing_enabled = true;
+
+    RenderQueue render_queue = {};
+    RenderQueueStats render_queue_stats_ = {};
+    // Per-frame lists of entities are dense indices into `entities.values()`, which are only stable
+    // within a frame. Lists kept across frames are slot indices.
+
+    /// Dense indices of dynamic entities in draw order, from `render_queue`.
+    std::vector<uint32_t> dynamic_order = {};
+
+    /// Spatial index over bounds of entities, user data is the slot index.
+    DynamicBvh bvh = {};
+    std::vector<uint32_t> bvh_results = {};
+
+    CullingMode culling_mode = CullingMode::Bvh;
+    /// A chunk of entities culled with `CullingMode::Linear`, chunks are culled in parallel.
+    struct CullingChunk {
+        FrustumCuller culler;
+        /// Dense index of each box in `culler`.
+        std::vector<uint32_t> entity_indices;
+        CullingStats stats;
+    };
+    std::vector<CullingChunk> culling_chunks = {};
+    /// Visibility of each entity in the current frame, by dense index.
+    std::vector<uint8_t> entity_visibility = {};
+    CullingStats culling_stats_ = {};
+
+    /// Static entities of the same pipeline, a range in `static_order`.
+    struct StaticBatch {
+        size_t begin;
+        size_t end;
+        wgpu::RenderBundle bundle;
+        /// Whether any entity of this batch is visible in the current frame.
+        bool visible;
+    };
+
+    /// Slot indices of static entities in draw order.
+    /// The order is independent of the camera, and static entities are prepared before dynamic
+    /// ones, so their instance indices and uniform offsets baked into the bundles stay valid until
+    /// the static set changes. Culled batches still reserve their instances for the same reason.
+    std::vector<uint32_t> static_order = {};
+    /// `static_order` as dense indices, for the current frame.
+    std::vector<uint32_t> static_dense_order = {};
+    std::vector<StaticBatch> static_batches = {};
+    bool static_bundles_dirty = true;
+    /// Generations of the buffers that the static bundles were recorded against.
+    uint64_t static_bundles_instances_generation = 0;
+    uint64_t static_bundles_geometry_pool_generation = 0;
+
+    GpuCuller gpu_culler = {};
+    /// Slot indices of all entities in draw order for `CullingMode::Gpu`, independent of the
+    /// camera like `static_order`. Instance `i` of a frame is the entity of `gpu_order[i]`.
+    std::vector<uint32_t> gpu_order = {};
+    /// `gpu_order` as dense indices, for the current frame.
+    std::vector<uint32_t> gpu_dense_order = {};
+    /// Slot index of the first entity of each draw group of `gpu_culler`.
+    std::vector<uint32_t> gpu_group_leaders = {};
+    bool gpu_groups_dirty = true;
+    /// Generation of `geometry_pool` that draw arguments of groups were computed against.
+    uint64_t gpu_groups_geometry_pool_generation = 0;
+
+    /// Nullable. When null, frames are prepared and recorded on the thread calling `add_passes`.
+    std::shared_ptr<JobSystem> jobs = nullptr;
+    /// Whether the device may be called from several threads at once, which Dawn only allows with
+    /// `wgpu::FeatureName::ImplicitDeviceSynchronization`. Render bundles are only recorded in
+    /// parallel if so.
+    bool device_is_thread_safe = false;
+    /// Whether the device has `wgpu::FeatureName::IndirectFirstInstance`. Without it, indirect
+    /// draws with a non-zero first instance draw nothing, as would all draw groups of `gpu_culler`
+    /// but the first.
+    bool device_supports_gpu_culling = false;
+    /// Sort key of each visible dynamic entity of the current frame, by dense index.
+    std::vector<uint64_t> sort_keys = {};
+    /// Bounds of the chunks of `dynamic_order` recorded in parallel, `chunk_count + 1` of them.
+    std::vector<size_t> dynamic_chunk_bounds = {};
+    /// Bundles of the chunks of `dynamic_order` of the current frame, and visible static bundles
+    /// before them.
+    std::vector<wgpu::RenderBundle> frame_bundles = {};
+    /// Whether `dynamic_order` is recorded into `frame_bundles` in the current frame, rather than
+    /// directly into the render pass.
+    bool dynamic_in_bundles = false;
 
     /// Nullable.
     /// When null, use identity as projection and view.
     std::shared_ptr<CameraBase> camera = nullptr;
 
-    /// Each entity is nullable for deletion.
-    std::vector<Entity> entities = {};
+    SlotMap<Entity> entities = {};
 
   public:
     Scene() = default;
 
-    Scene(wgpu::Device device, wgpu::Queue queue, CanvasFormat surface_format);
+    /// `instance` must have been created with `wgpu::InstanceFeatureName::TimedWaitAny`.
+    Scene(
+        wgpu::Instance instance,
+        wgpu::Device device,
+        wgpu::Queue queue,
+        CanvasFormat surface_format
+    );
 
     void set_camera(std::shared_ptr<CameraBase> camera);
 
+    /// Nullable. With a job system, `add_passes` splits entities into chunks to write instance
+    /// transforms, cull and compute sort keys in parallel, and records render bundles of chunks
+    /// of dynamic entities and of static batches in parallel if the device is thread-safe.
+    void set_job_system(std::shared_ptr<JobSystem> jobs);
+
+    /// At most `MAX_LIGHTS`, the rest are ignored with a warning.
+    void set_lights(std::span<const Light> lights);
+
+    /// Does not wait for the pipeline of a new combination of geometry and material types to
+    /// compile: the entity is drawn with the fallback material until the pipeline is ready, see
+    /// `set_fallback_material`.
     EntityId create_entity(
         std::shared_ptr<GeometryBase> geometry,
         std::shared_ptr<MaterialBase> material
     );
+    /// Aborts if `id` is null or stale.
     Entity& get_entity(EntityId id);
+    /// Whether `id` refers to an entity that is not deleted yet.
+    bool contains_entity(EntityId id) const;
+    /// Does nothing but warn if `id` is null or stale.
+    /// Children of the entity become roots, keeping their transforms relative to it.
     void delete_entity(EntityId id);
 
+    /// Sets the transform relative to the entity's parent, or to the world for roots.
+    /// Entities are created with the identity transform.
+    void set_entity_transform(EntityId id, const Transform& transform);
+
+    Transform get_entity_transform(EntityId id);
+
+    /// `parent` may be null to make the entity a root. Aborts if that would make a cycle.
+    /// Only the subtrees of entities whose transforms or parents changed are recomputed per frame.
+    void set_entity_parent(EntityId id, EntityId parent);
+
+    /// Null for roots.
+    EntityId get_entity_parent(EntityId id);
+
+    /// Static entities have their draw commands recorded once into render bundles, which are only
+    /// re-recorded when a static entity is added, deleted or changes material.
+    /// Their transforms can still change.
+    void set_entity_static(EntityId id, bool is_static);
+
+    /// Pipelines of new materials compile asynchronously, see `set_fallback_material`.
+    void set_entity_material(EntityId id, std::shared_ptr<MaterialBase> material);
+
+    /// Drawn instead of materials whose pipeline is still compiling, nullable. Pipelines of the
+    /// fallback material are compiled synchronously, once per geometry type, so it should be
+    /// cheap to compile. Without one, such entities are not drawn until their pipeline is ready.
+    void set_fallback_material(std::shared_ptr<MaterialBase> material);
+
+    /// Hidden entities are not drawn, but are still hit by `raycast` and `query_aabb`.
+    /// Hiding or showing a static entity re-records the static render bundles.
+    void set_entity_hidden(EntityId id, bool is_hidden);
+
+    /// Lets snapshots set the color of `material`, which lives as long as the scene. Returns its
+    /// index for `SceneSnapshot::ColorMaterialState`.
+    uint32_t add_snapshot_color_material(std::shared_ptr<ColorMaterial> material);
+
+    /// Sets the transforms, hidden flags and material parameters of the snapshot. Entities of the
+    /// snapshot deleted since are skipped.
+    void apply_snapshot(const SceneSnapshot& snapshot);
+
+    /// Instancing is enabled by default.
+    void set_instancing_enabled(bool enabled);
+
+    /// `CullingMode::Bvh` by default. `CullingMode::Gpu` falls back to `CullingMode::Bvh`, with a
+    /// warning, on devices without `wgpu::FeatureName::IndirectFirstInstance`.
+    void set_culling_mode(CullingMode mode);
+
+    /// The closest entity whose bounding box is hit by the ray.
+    /// Entities without bounds (see `GeometryBase::local_bounds`) are never hit.
+    std::optional<SceneRaycastHit> raycast(glm::vec3 origin, glm::vec3 direction);
+
+    /// Appends all entities whose bounding boxes intersect `box` to `results`.
+    void query_aabb(const BoundingBox& box, std::vector<EntityId>& results);
+
+    /// Pool for geometries of entities of this scene. Geometries moved by defragmentation are
+    /// picked up by the next `add_passes`.
+    const std::shared_ptr<GeometryPool>& get_geometry_pool() const;
+
+    /// Arena for long-lived uniforms of materials and geometries of this scene.
+    const std::shared_ptr<UniformArena>& get_uniform_arena() const;
+
+    PipelineCache::Stats pipeline_cache_stats() const;
+
+    /// See `PipelineCache::compile_seconds`, indexed by `Entity::get_pipeline_id`.
+    std::span<const double> pipeline_compile_seconds() const;
+
+    /// See `PipelineCache::save_manifest`.
+    void save_pipeline_manifest(const std::filesystem::path& path) const;
+
+    /// See `PipelineCache::warm_up`.
+    void warm_up_pipelines(
+        const std::filesystem::path& path,
+        std::span<const GeometryBase* const> geometries,
+        std::span<const MaterialBase* const> materials
+    );
+
+    GeometryPool::Stats geometry_pool_stats() const;
+
+    UniformArena::Stats uniform_arena_stats() const;
+
+    /// Statistics of the render queue of the last `add_passes`.
+    RenderQueueStats render_queue_stats() const;
+
+    /// Frames that may be submitted before `add_passes` waits for the GPU to finish the oldest of
+    /// them. 2 by default.
+    void set_frames_in_flight(uint32_t frames_in_flight);
+
+    StagingBelt::Stats staging_belt_stats() const;
+
+    /// Statistics of frustum culling of the last `add_passes`.
+    /// With `CullingMode::Gpu`, results stay on the GPU, so no entity is counted as culled.
+    CullingStats culling_stats() const;
+
+    /// Adds the passes of a frame of the scene to `graph`: uploads of per-frame data, the culling
+    /// pass with `CullingMode::Gpu`, and the render pass onto `color` and `depth`, textures of the
+    /// formats that the scene is created for. Entities are culled and per-frame data is staged
+    /// right away, the passes only record commands, so the scene must not change until the graph
+    /// is executed.
+    void add_passes(RenderGraph& graph, RenderGraphResource color, RenderGraphResource depth);
+
+    /// Draws onto `surface` with a render graph of its own, executed right away.
     /// Must be a surface of the same texture format that the scene is created for.
     void draw(const Canvas& surface);
+
+  private:
+    /// Recomputes matrices of transforms set since the last update, and brings `bvh` up to date
+    /// with the entities that moved.
+    void update_spatial_index();
+
+    /// Updates `entity_visibility`. Hidden entities are invisible in every mode.
+    void cull_entities(const Frustum& frustum);
+
+    void cull_entities_linear(const Frustum& frustum);
+
+    void update_static_order();
+
+    /// Records bundles of static batches, in parallel if the device is thread-safe.
+    void record_static_bundles();
+
+    /// Records `dynamic_order` into render bundles of chunks of entities, in parallel, appended to
+    /// `frame_bundles`. Chunks do not split runs of entities drawn instanced.
+    void record_dynamic_bundles();
+
+    /// Culls with `frustum`, prepares and stages per-frame data of visible entities, and records
+    /// render bundles, for all culling modes but `CullingMode::Gpu`.
+    void prepare_cpu_culled(const Frustum& frustum, const glm::mat4x4& view_matrix);
+
+    /// Encodes entities prepared by `prepare_cpu_culled`.
+    void encode_cpu_culled(wgpu::RenderPassEncoder& render_pass);
+
+    /// Prepares and stages per-frame data of all entities, and stages the culling pass of
+    /// `gpu_culler`.
+    void prepare_gpu_driven(const Frustum& frustum);
+
+    /// Encodes indirect draws of the groups of `gpu_culler`, after its culling pass.
+    void encode_gpu_driven(wgpu::RenderPassEncoder& render_pass);
+
+    /// Recomputes `gpu_order` and draw groups of `gpu_culler`.
+    void update_gpu_groups();
+
+    /// Switches entities to pipelines compiled since the last frame, resolved by
+    /// `wgpu::Instance::ProcessEvents`.
+    void update_pending_pipelines();
+
+    /// Runs `f(chunk, begin, end)` over chunks of `[0, count)` with `jobs`, or one chunk after the
+    /// other without a job system.
+    template <class F>
+    void parallel_for(size_t count, size_t chunk_size, F&& f);
+
+    /// Writes instance transforms of `instance_slots` into `instances`, in parallel.
+    void write_instance_transforms(std::span<InstanceTransforms> instances);
+
+    /// Reserves instances of the entities at the dense indices, in the order given, and records
+    /// them in `instance_slots`.
+    /// If `visible` is false, instance transforms are left unwritten.
+    void prepare_entities(std::span<const uint32_t> entity_indices, bool visible = true);
+
+    /// Encodes draw commands of entities at the dense indices, prepared in the same order with
+    /// `prepare_entities`.
+    template <RenderCommandEncoder E>
+    void encode_entities(
+        E& encoder,
+        std::span<const uint32_t> entity_indices,
+        RenderPassState& render_pass_state
+    );
 };
@@ -1,10 +1,12 @@
 #pragma once
 
-#include <vector>
+#include <string>
 #include <webgpu/webgpu_cpp.h>
 
+/// Pipeline-overridable constants are not part of this, they are queried separately (see
+/// `GeometryBase::vertex_shader_constants` and `MaterialBase::fragment_shader_constants`) so that
+/// one shader module can be shared by pipelines with different constants.
 struct ShaderInfo {
     wgpu::ShaderModule shader_module = nullptr;
     std::string entry_point = "main";
-    std::vector<wgpu::ConstantEntry> constants = {};
 };
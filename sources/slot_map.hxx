@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// Key of a `SlotMap`, which tells apart values that lived in the same slot by their generations.
+struct SlotKey {
+    uint32_t index = 0;
+    /// Generations of live slots start at 1, so a zero-initialized key is null.
+    uint32_t generation = 0;
+
+    constexpr bool operator==(nullptr_t) const {
+        return this->generation == 0;
+    }
+
+    constexpr bool operator==(const SlotKey&) const = default;
+};
+
+/// Generational slot map.
+///
+/// Values are packed densely for iteration, and reached from keys through a sparse array of slots.
+/// Insertion, removal and lookup are O(1). Removal swaps the last value into the hole, so dense
+/// indices of values are not stable, while slot indices are until the value is removed. Removed
+/// slots are reused, with a bumped generation so that stale keys are detected.
+template <class T>
+class SlotMap {
+    static constexpr uint32_t NULL_INDEX = UINT32_MAX;
+
+    struct Slot {
+        uint32_t generation;
+        /// Index in `values` for live slots, the next free slot for free slots.
+        uint32_t index;
+        bool is_live;
+    };
+
+    std::vector<Slot> slots = {};
+    uint32_t free_head = NULL_INDEX;
+
+    std::vector<T> values_ = {};
+    /// Slot index of each value.
+    std::vector<uint32_t> value_slots = {};
+
+  public:
+    SlotMap() = default;
+
+    SlotKey insert(T value) {
+        uint32_t slot_index;
+        if (this->free_head != NULL_INDEX) {
+            slot_index = this->free_head;
+            this->free_head = this->slots[slot_index].index;
+        } else {
+            slot_index = (uint32_t)this->slots.size();
+            this->slots.push_back(Slot {
+                .generation = 1,
+                .index = NULL_INDEX,
+                .is_live = false,
+            });
+        }
+        auto& slot = this->slots[slot_index];
+        slot.index = (uint32_t)this->values_.size();
+        slot.is_live = true;
+        this->values_.push_back(std::move(value));
+        this->value_slots.push_back(slot_index);
+        return SlotKey {
+            .index = slot_index,
+            .generation = slot.generation,
+        };
+    }
+
+    /// Returns false if `key` is stale.
+    bool remove(SlotKey key) {
+        if (!this->contains(key)) {
+            return false;
+        }
+        auto& slot = this->slots[key.index];
+        auto dense_index = slot.index;
+        auto last = (uint32_t)this->values_.size() - 1;
+        if (dense_index != last) {
+            this->values_[dense_index] = std::move(this->values_[last]);
+            this->value_slots[dense_index] = this->value_slots[last];
+            this->slots[this->value_slots[dense_index]].index = dense_index;
+        }
+        this->values_.pop_back();
+        this->value_slots.pop_back();
+
+        slot.is_live = false;
+        // Generation 0 is reserved for null keys.
+        if (++slot.generation == 0) {
+            slot.generation = 1;
+        }
+        slot.index = this->free_head;
+        this->free_head = key.index;
+        return true;
+    }
+
+    bool contains(SlotKey key) const {
+        return key.index < this->slots.size() && this->slots[key.index].is_live &&
+               this->slots[key.index].generation == key.generation;
+    }
+
+    /// `nullptr` if `key` is stale.
+    T* get(SlotKey key) {
+        return this->contains(key) ? &this->values_[this->slots[key.index].index] : nullptr;
+    }
+
+    /// `nullptr` if `key` is stale.
+    const T* get(SlotKey key) const {
+        return this->contains(key) ? &this->values_[this->slots[key.index].index] : nullptr;
+    }
+
+    /// Whether the slot holds a value, regardless of generation.
+    bool slot_is_live(uint32_t slot_index) const {
+        return slot_index < this->slots.size() && this->slots[slot_index].is_live;
+    }
+
+    /// Index in `values()` of the value in a live slot.
+    uint32_t dense_index_of(uint32_t slot_index) const {
+        assert(this->slot_is_live(slot_index));
+        return this->slots[slot_index].index;
+    }
+
+    /// Key of the value at `dense_index` in `values()`.
+    SlotKey key_at(uint32_t dense_index) const {
+        auto slot_index = this->value_slots[dense_index];
+        return SlotKey {
+            .index = slot_index,
+            .generation = this->slots[slot_index].generation,
+        };
+    }
+
+    /// All values, densely packed in no particular order.
+    std::span<T> values() {
+        return this->values_;
+    }
+
+    std::span<const T> values() const {
+        return this->values_;
+    }
+
+    size_t size() const {
+        return this->values_.size();
+    }
+};
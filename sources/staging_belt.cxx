@@ -0,0 +1,172 @@
+#include "staging_belt.hxx"
+#include "log.hxx"
+
+#include <cassert>
+#include <chrono>
+#include <dawn/webgpu_cpp_print.h>
+#include <fmt/ostream.h>
+
+using namespace std::literals;
+
+StagingBelt::StagingBelt(
+    wgpu::Instance instance,
+    wgpu::Device device,
+    uint32_t frames_in_flight,
+    uint64_t initial_capacity
+)
+    : instance(std::move(instance))
+    , device(std::move(device))
+    , initial_capacity(initial_capacity) {
+    this->set_frames_in_flight(frames_in_flight);
+}
+
+void StagingBelt::set_frames_in_flight(uint32_t frames_in_flight) {
+    assert(!this->in_frame);
+    if (frames_in_flight == 0) {
+        log_error("at least 1 frame in flight is needed");
+        abort();
+    }
+    // Dropped frames still pending are kept alive by their `MapAsync` callback.
+    while (this->frames.size() > frames_in_flight) {
+        this->frames.pop_back();
+    }
+    while (this->frames.size() < frames_in_flight) {
+        this->frames.push_back(std::make_shared<Frame>(Frame {
+            .buffers = {this->create_mapped_buffer(this->initial_capacity)},
+            .map_state = MapState::Mapped,
+            .map_future = {},
+        }));
+    }
+    this->frame_index %= this->frames.size();
+}
+
+void StagingBelt::begin_frame() {
+    assert(!this->in_frame);
+    this->frame_index = (this->frame_index + 1) % this->frames.size();
+    auto& frame = *this->frames[this->frame_index];
+    if (frame.map_state == MapState::Pending) {
+        auto start = std::chrono::steady_clock::now();
+        this->instance.WaitAny(frame.map_future, UINT64_MAX);
+        auto end = std::chrono::steady_clock::now();
+        ++this->wait_count;
+        this->wait_seconds += std::chrono::duration<double>(end - start).count();
+    }
+    if (frame.map_state != MapState::Mapped) {
+        log_warn("re-creating staging buffer that failed to map");
+        frame.buffers = {this->create_mapped_buffer(frame.buffers.back().GetSize())};
+        frame.map_state = MapState::Mapped;
+    }
+    this->in_frame = true;
+    this->mapped_data = (std::byte*)frame.buffers.back().GetMappedRange();
+    this->offset = 0;
+}
+
+std::span<std::byte> StagingBelt::write(
+    const wgpu::Buffer& destination,
+    uint64_t destination_offset,
+    uint64_t size
+) {
+    assert(this->in_frame);
+    assert(size % 4 == 0 && destination_offset % 4 == 0);
+    auto& frame = *this->frames[this->frame_index];
+    auto offset = (this->offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    if (offset + size > frame.buffers.back().GetSize()) {
+        auto capacity = std::max(frame.buffers.back().GetSize() * 2, size);
+        log_verbose("adding staging buffer of {} bytes to frame {}", capacity, this->frame_index);
+        frame.buffers.push_back(this->create_mapped_buffer(capacity));
+        this->mapped_data = (std::byte*)frame.buffers.back().GetMappedRange();
+        offset = 0;
+    }
+    this->copies.push_back(Copy {
+        .source = frame.buffers.back(),
+        .source_offset = offset,
+        .destination = destination,
+        .destination_offset = destination_offset,
+        .size = size,
+    });
+    this->offset = offset + size;
+    return std::span(this->mapped_data + offset, size);
+}
+
+void StagingBelt::finish(wgpu::CommandEncoder& encoder) {
+    assert(this->in_frame);
+    auto& frame = *this->frames[this->frame_index];
+    for (auto& buffer : frame.buffers) {
+        buffer.Unmap();
+    }
+    this->mapped_data = nullptr;
+
+    this->used = 0;
+    for (const auto& copy : this->copies) {
+        encoder.CopyBufferToBuffer(
+            copy.source,
+            copy.source_offset,
+            copy.destination,
+            copy.destination_offset,
+            copy.size
+        );
+        this->used += copy.size;
+    }
+    this->copies.clear();
+}
+
+void StagingBelt::recycle() {
+    assert(this->in_frame);
+    this->in_frame = false;
+    auto frame = this->frames[this->frame_index];
+    if (frame->buffers.size() > 1) {
+        uint64_t capacity = 0;
+        for (const auto& buffer : frame->buffers) {
+            capacity += buffer.GetSize();
+        }
+        // The previous buffers are released once the GPU is done with them.
+        frame->buffers = {this->create_mapped_buffer(capacity)};
+        frame->map_state = MapState::Mapped;
+        return;
+    }
+    frame->map_state = MapState::Pending;
+    frame->map_future = frame->buffers[0].MapAsync(
+        wgpu::MapMode::Write,
+        0,
+        wgpu::kWholeMapSize,
+        wgpu::CallbackMode::AllowProcessEvents,
+        [frame](wgpu::MapAsyncStatus status, wgpu::StringView message) {
+            if (status == wgpu::MapAsyncStatus::Success) {
+                frame->map_state = MapState::Mapped;
+            } else {
+                log_warn(
+                    "mapping staging buffer failed, status: {}, message: {}",
+                    fmt::streamed(status),
+                    fmt::streamed(message)
+                );
+                frame->map_state = MapState::Failed;
+            }
+        }
+    );
+}
+
+StagingBelt::Stats StagingBelt::stats() const {
+    uint64_t capacity = 0;
+    for (const auto& frame : this->frames) {
+        for (const auto& buffer : frame->buffers) {
+            capacity += buffer.GetSize();
+        }
+    }
+    return Stats {
+        .frames_in_flight = (uint32_t)this->frames.size(),
+        .capacity = capacity,
+        .used = this->used,
+        .wait_count = this->wait_count,
+        .wait_seconds = this->wait_seconds,
+    };
+}
+
+wgpu::Buffer StagingBelt::create_mapped_buffer(uint64_t capacity) const {
+    auto descriptor = wgpu::BufferDescriptor {
+        .label = "Staging Belt"sv,
+        .usage = wgpu::BufferUsage::MapWrite | wgpu::BufferUsage::CopySrc,
+        .size = (capacity + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT,
+        .mappedAtCreation = true,
+    };
+    return this->device.CreateBuffer(&descriptor);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+/// Uploads of per-frame data through a ring of persistently mapped staging buffers
+/// (`MapWrite | CopySrc`), one per frame in flight.
+///
+/// During a frame, data is written directly into the mapped memory of the frame's staging buffer.
+/// `finish` then unmaps it and records all copies of the frame into a command encoder, before the
+/// commands of the frame that read the data. Once submitted, `recycle` maps the staging buffer
+/// again with `MapAsync`, which completes when the GPU is done with the frame, as observed by
+/// `wgpu::Instance::ProcessEvents`.
+///
+/// `begin_frame` waits for the staging buffer of the frame `frames_in_flight` frames ago to be
+/// mapped again, which bounds how far the CPU runs ahead of the GPU, like waiting on a fence.
+class StagingBelt {
+  public:
+    struct Stats {
+        uint32_t frames_in_flight;
+        /// Of the staging buffers of all frames in flight.
+        uint64_t capacity;
+        /// Bytes written in the last finished frame.
+        uint64_t used;
+        /// Frames whose `begin_frame` waited for the GPU, and how long they waited in total.
+        uint64_t wait_count;
+        double wait_seconds;
+    };
+
+  private:
+    enum class MapState {
+        Mapped,
+        Pending,
+        Failed,
+    };
+
+    /// Shared with the `MapAsync` callback, which may outlive the belt.
+    struct Frame {
+        /// The last buffer is written into. Previous ones filled up during the frame, and are
+        /// replaced by one buffer of their total size once the frame is submitted.
+        std::vector<wgpu::Buffer> buffers;
+        MapState map_state;
+        wgpu::Future map_future;
+    };
+
+    /// Copies are 4-byte aligned, and staged data is 16-byte aligned for vectors and matrices.
+    static constexpr uint64_t ALIGNMENT = 16;
+
+    struct Copy {
+        wgpu::Buffer source;
+        uint64_t source_offset;
+        wgpu::Buffer destination;
+        uint64_t destination_offset;
+        uint64_t size;
+    };
+
+    wgpu::Instance instance = nullptr;
+    wgpu::Device device = nullptr;
+    uint64_t initial_capacity = 0;
+
+    std::vector<std::shared_ptr<Frame>> frames = {};
+    size_t frame_index = 0;
+    bool in_frame = false;
+
+    /// Of the last buffer of the current frame.
+    std::byte* mapped_data = nullptr;
+    uint64_t offset = 0;
+    std::vector<Copy> copies = {};
+
+    uint64_t used = 0;
+    uint64_t wait_count = 0;
+    double wait_seconds = 0;
+
+  public:
+    StagingBelt() = default;
+
+    /// `instance` must have been created with `wgpu::InstanceFeatureName::TimedWaitAny`.
+    StagingBelt(
+        wgpu::Instance instance,
+        wgpu::Device device,
+        uint32_t frames_in_flight = 2,
+        uint64_t initial_capacity = 1 << 20
+    );
+
+    /// Must not be called during a frame. Takes effect from the next frame.
+    void set_frames_in_flight(uint32_t frames_in_flight);
+
+    /// Waits until the staging buffer of the frame is mapped.
+    void begin_frame();
+
+    /// Mapped memory for `size` bytes to be copied to `destination` at `destination_offset`, valid
+    /// until `finish`. `size` and `destination_offset` must be multiples of 4.
+    std::span<std::byte> write(
+        const wgpu::Buffer& destination,
+        uint64_t destination_offset,
+        uint64_t size
+    );
+
+    /// Unmaps the staging buffer of the frame and records the copies of the frame into `encoder`,
+    /// before the commands reading the data. No data may be written after it in the frame.
+    void finish(wgpu::CommandEncoder& encoder);
+
+    /// Maps the staging buffer of the frame again, must be called once the commands of `finish`
+    /// are submitted.
+    void recycle();
+
+    Stats stats() const;
+
+  private:
+    wgpu::Buffer create_mapped_buffer(uint64_t capacity) const;
+};
@@ -116,6 +116,13 @@ Swapchain::Swapchain(
         std::span(capabilities.formats, (size_t)capabilities.formatCount)
     );
 
+    if (info.allow_storage_binding &&
+        (capabilities.usages & wgpu::TextureUsage::StorageBinding) &&
+        !storage_texel_format(this->device, this->format.color_format).empty()) {
+        this->usage |= wgpu::TextureUsage::StorageBinding;
+    }
+    log_verbose("swapchain texture usages: {}", fmt::streamed(this->usage));
+
     if (info.create_depth_stencil_texture) {
         if (info.depth_stencil_format == wgpu::TextureFormat::Undefined) {
             log_error(
@@ -131,6 +138,7 @@ Swapchain::Swapchain(
     auto surface_configuration = wgpu::SurfaceConfiguration {
         .device = this->device,
         .format = this->format.color_format,
+        .usage = this->usage,
         .width = width,
         .height = height,
     };
@@ -188,6 +196,7 @@ void Swapchain::reconfigure_for_size(uint32_t width, uint32_t height) {
     auto surface_configuration = wgpu::SurfaceConfiguration {
         .device = this->device,
         .format = this->format.color_format,
+        .usage = this->usage,
         .width = this->width,
         .height = this->height,
     };
@@ -16,6 +16,8 @@ class Swapchain {
         .depth_stencil_format = wgpu::TextureFormat::Undefined,
     };
 
+    wgpu::TextureUsage usage = wgpu::TextureUsage::RenderAttachment;
+
     wgpu::Surface surface = nullptr;
     wgpu::Texture depth_stencil_texture = nullptr;
 
@@ -35,6 +37,11 @@ class Swapchain {
         /// Whether to prefer float over unorm for output color textures.
         /// Only applicable if `prefer_srgb == `false`, or if surface does not support SRGB output.
         bool prefer_float = false;
+
+        /// Whether to add `wgpu::TextureUsage::StorageBinding` to the usage of output color
+        /// textures, for compute passes to write them directly. Only applied if the surface and
+        /// the device support storage textures of the chosen format.
+        bool allow_storage_binding = false;
     };
 
     Swapchain() = default;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <glm/vec2.hpp>
 
 #include "texture_blitter.hxx"
@@ -128,47 +129,36 @@ TextureBlitter::TextureBlitter(
     };
     this->pipeline = this->device.CreateRenderPipeline(&pipelineDesc);
 
-    auto buffer_descriptor = wgpu::BufferDescriptor {
-        .label = "Texture Blitter Extend Uniform",
-        .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
-        .size = sizeof(glm::uvec2),
-    };
-    this->extend_uniform = this->device.CreateBuffer(&buffer_descriptor);
-
     this->resize(info.width, info.height);
 }
 
 void TextureBlitter::resize(uint32_t width, uint32_t height) {
-    auto extend = glm::uvec2(width, height);
-    this->queue.WriteBuffer(this->extend_uniform, 0, (const uint8_t*)&extend, sizeof(extend));
+    this->width = width;
+    this->height = height;
 }
 
 void TextureBlitter::blit(
     wgpu::CommandEncoder& encoder,
     wgpu::TextureView src_texture,
     wgpu::TextureView dst_texture
-) const {
-    auto bgEntries = std::array {
-        wgpu::BindGroupEntry {
-            .binding = 0,
-            .textureView = src_texture,
-        },
-        wgpu::BindGroupEntry {
-            .binding = 1,
-            .buffer = this->extend_uniform,
-            .offset = 0,
-            .size = sizeof(uint32_t) * 2
-        },
+) {
+    auto region = Region {
+        .src_texture = std::move(src_texture),
+        .src_width = this->width,
+        .src_height = this->height,
+        .x = 0,
+        .y = 0,
+        .width = this->width,
+        .height = this->height,
     };
+    this->blit(encoder, std::move(dst_texture), std::span(&region, 1));
+}
 
-    auto bind_group_descriptor = wgpu::BindGroupDescriptor {
-        .layout = this->bind_group_layout,
-        .entryCount = bgEntries.size(),
-        .entries = bgEntries.data()
-    };
-
-    auto bind_group = device.CreateBindGroup(&bind_group_descriptor);
-
+void TextureBlitter::blit(
+    wgpu::CommandEncoder& encoder,
+    wgpu::TextureView dst_texture,
+    std::span<const Region> regions
+) {
     auto color_attachment = wgpu::RenderPassColorAttachment {
         .view = dst_texture,
         .loadOp = wgpu::LoadOp::Clear,
@@ -182,8 +172,77 @@ void TextureBlitter::blit(
     };
     auto render_pass = encoder.BeginRenderPass(&render_pass_descriptor);
 
-    render_pass.SetBindGroup(0, bind_group);
     render_pass.SetPipeline(this->pipeline);
-    render_pass.Draw(6);
+    for (const auto& region : regions) {
+        render_pass.SetViewport(
+            (float)region.x,
+            (float)region.y,
+            (float)region.width,
+            (float)region.height,
+            0.0f,
+            1.0f
+        );
+        render_pass.SetBindGroup(0, this->get_bind_group(region));
+        render_pass.Draw(6);
+    }
     render_pass.End();
 }
+
+void TextureBlitter::trim() {
+    std::erase_if(this->bind_groups, [&](const CachedBindGroup& cached) {
+        return this->frame - cached.last_used_frame >= MAX_UNUSED_FRAMES;
+    });
+    ++this->frame;
+}
+
+void TextureBlitter::forget(const wgpu::TextureView& src_texture) {
+    std::erase_if(this->bind_groups, [&](const CachedBindGroup& cached) {
+        return cached.src_texture.Get() == src_texture.Get();
+    });
+}
+
+const wgpu::BindGroup& TextureBlitter::get_bind_group(const Region& region) {
+    auto cached = std::ranges::find_if(this->bind_groups, [&](const CachedBindGroup& cached) {
+        return cached.src_texture.Get() == region.src_texture.Get() &&
+               cached.src_width == region.src_width && cached.src_height == region.src_height;
+    });
+    if (cached == this->bind_groups.end()) {
+        auto buffer_descriptor = wgpu::BufferDescriptor {
+            .label = "Texture Blitter Extend Uniform",
+            .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
+            .size = sizeof(glm::uvec2),
+        };
+        auto extend_uniform = this->device.CreateBuffer(&buffer_descriptor);
+        auto extend = glm::uvec2(region.src_width, region.src_height);
+        this->queue.WriteBuffer(extend_uniform, 0, (const uint8_t*)&extend, sizeof(extend));
+
+        auto bgEntries = std::array {
+            wgpu::BindGroupEntry {
+                .binding = 0,
+                .textureView = region.src_texture,
+            },
+            wgpu::BindGroupEntry {
+                .binding = 1,
+                .buffer = extend_uniform,
+                .offset = 0,
+                .size = sizeof(uint32_t) * 2
+            },
+        };
+        auto bind_group_descriptor = wgpu::BindGroupDescriptor {
+            .layout = this->bind_group_layout,
+            .entryCount = bgEntries.size(),
+            .entries = bgEntries.data()
+        };
+        this->bind_groups.push_back(CachedBindGroup {
+            .src_texture = region.src_texture,
+            .src_width = region.src_width,
+            .src_height = region.src_height,
+            .extend_uniform = std::move(extend_uniform),
+            .bind_group = this->device.CreateBindGroup(&bind_group_descriptor),
+            .last_used_frame = 0,
+        });
+        cached = this->bind_groups.end() - 1;
+    }
+    cached->last_used_frame = this->frame;
+    return cached->bind_group;
+}
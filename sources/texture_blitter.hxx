@@ -2,16 +2,39 @@
 
 #include "object.hxx"
 
+#include <cstdint>
+#include <span>
+#include <vector>
 #include <webgpu/webgpu_cpp.h>
 
+/// Draws textures onto others, e.g. onto the swapchain texture.
+///
+/// Bind groups are cached by source view and extend, so that blitting the same textures every frame
+/// creates no bind group. A cached bind group keeps its source texture alive: sources are forgotten
+/// when not blitted during `MAX_UNUSED_FRAMES` calls to `trim`, or with `forget`.
 class TextureBlitter : public ObjectBase {
+    struct CachedBindGroup {
+        wgpu::TextureView src_texture;
+        uint32_t src_width;
+        uint32_t src_height;
+        wgpu::Buffer extend_uniform;
+        wgpu::BindGroup bind_group;
+        uint64_t last_used_frame;
+    };
+
     wgpu::Device device;
     wgpu::Queue queue;
 
     wgpu::BindGroupLayout bind_group_layout;
-    wgpu::Buffer extend_uniform;
     wgpu::RenderPipeline pipeline;
 
+    /// Of `blit` with a single source.
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    std::vector<CachedBindGroup> bind_groups = {};
+    uint64_t frame = 0;
+
   public:
     TextureBlitter() = default;
     constexpr TextureBlitter(nullptr_t) {}
@@ -27,13 +50,45 @@ class TextureBlitter : public ObjectBase {
         uint32_t height;
     };
 
+    /// One source drawn onto a rectangle of the destination.
+    struct Region {
+        wgpu::TextureView src_texture;
+        /// Texels read from the top-left corner of the source.
+        uint32_t src_width;
+        uint32_t src_height;
+        /// Rectangle of the destination drawn over.
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    static constexpr uint64_t MAX_UNUSED_FRAMES = 8;
+
     TextureBlitter(wgpu::Device device, wgpu::Queue queue, const CreateInfo& info);
 
     void resize(uint32_t width, uint32_t height);
 
+    /// Draws the top-left `width`x`height` texels of `src_texture` over `dst_texture`.
     void blit(
         wgpu::CommandEncoder& encoder,
         wgpu::TextureView src_texture,
         wgpu::TextureView dst_texture
-    ) const;
+    );
+
+    /// Draws all regions in one render pass, clearing the rest of `dst_texture`.
+    void blit(
+        wgpu::CommandEncoder& encoder,
+        wgpu::TextureView dst_texture,
+        std::span<const Region> regions
+    );
+
+    /// Ends a frame, forgetting sources not blitted during `MAX_UNUSED_FRAMES` frames.
+    void trim();
+
+    /// Releases the bind groups of `src_texture`, e.g. before re-creating its texture.
+    void forget(const wgpu::TextureView& src_texture);
+
+  private:
+    const wgpu::BindGroup& get_bind_group(const Region& region);
 };
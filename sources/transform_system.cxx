@@ -0,0 +1,506 @@
+#include "transform_system.hxx"
+
+#include <cassert>
+#include <cstring>
+#include <glm/ext/matrix_transform.hpp>
+
+#if defined(__x86_64__) && !defined(__EMSCRIPTEN__)
+#define HAS_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+glm::mat4x4 Transform::to_matrix() const {
+    auto matrix = glm::translate(glm::identity<glm::mat4x4>(), this->translation);
+    matrix = matrix * glm::mat4_cast(this->rotation);
+    return glm::scale(matrix, this->scale);
+}
+
+static constexpr size_t BATCH_SIZE = 8;
+
+/// Up to `BATCH_SIZE` transforms, gathered from the arrays of `TransformSystem`.
+struct alignas(32) TrsBatch {
+    float translation_x[BATCH_SIZE];
+    float translation_y[BATCH_SIZE];
+    float translation_z[BATCH_SIZE];
+    float rotation_x[BATCH_SIZE];
+    float rotation_y[BATCH_SIZE];
+    float rotation_z[BATCH_SIZE];
+    float rotation_w[BATCH_SIZE];
+    float scale_x[BATCH_SIZE];
+    float scale_y[BATCH_SIZE];
+    float scale_z[BATCH_SIZE];
+};
+
+/// Upper 3x3 of model and normal matrices of a `TrsBatch`, column-major.
+struct alignas(32) MatrixBatch {
+    float model[9][BATCH_SIZE];
+    float normal[9][BATCH_SIZE];
+};
+
+/// Lanes of the kernels built for the baseline of the target, AVX2 is picked at runtime.
+#if defined(__SSE2__)
+using NativeLanes = __m128;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+using NativeLanes = float32x4_t;
+#else
+using NativeLanes = float;
+#endif
+
+/// Written once for all targets, with the arithmetic operators of GCC/Clang vector types. Inlined
+/// into the kernel of each target, so that `Lanes` operations compile to its instructions.
+template <class Lanes>
+[[gnu::always_inline]] static inline void compute_matrices(const TrsBatch& trs, MatrixBatch& out) {
+    constexpr size_t lane_count = sizeof(Lanes) / sizeof(float);
+    for (size_t i = 0; i < BATCH_SIZE; i += lane_count) {
+        // No helper lambdas, they would take 32-byte vectors by value outside of the AVX2 target.
+        Lanes x, y, z, w, scale_x, scale_y, scale_z;
+        std::memcpy(&x, trs.rotation_x + i, sizeof(Lanes));
+        std::memcpy(&y, trs.rotation_y + i, sizeof(Lanes));
+        std::memcpy(&z, trs.rotation_z + i, sizeof(Lanes));
+        std::memcpy(&w, trs.rotation_w + i, sizeof(Lanes));
+        std::memcpy(&scale_x, trs.scale_x + i, sizeof(Lanes));
+        std::memcpy(&scale_y, trs.scale_y + i, sizeof(Lanes));
+        std::memcpy(&scale_z, trs.scale_z + i, sizeof(Lanes));
+
+        auto xx = x * x, yy = y * y, zz = z * z;
+        auto xy = x * y, xz = x * z, yz = y * z;
+        auto wx = w * x, wy = w * y, wz = w * z;
+
+        // Columns of the rotation matrix of the quaternion.
+        Lanes rotation[9] = {
+            1.0f - 2.0f * (yy + zz),
+            2.0f * (xy + wz),
+            2.0f * (xz - wy),
+            2.0f * (xy - wz),
+            1.0f - 2.0f * (xx + zz),
+            2.0f * (yz + wx),
+            2.0f * (xz + wy),
+            2.0f * (yz - wx),
+            1.0f - 2.0f * (xx + yy),
+        };
+
+        // M = R * S, so M^-T = R^-T * S^-T = R * S^-1.
+        Lanes scales[3] = {scale_x, scale_y, scale_z};
+        Lanes inverse_scales[3] = {1.0f / scale_x, 1.0f / scale_y, 1.0f / scale_z};
+        for (size_t column = 0; column < 3; ++column) {
+            for (size_t row = 0; row < 3; ++row) {
+                auto r = rotation[column * 3 + row];
+                Lanes model = r * scales[column];
+                Lanes normal = r * inverse_scales[column];
+                std::memcpy(out.model[column * 3 + row] + i, &model, sizeof(Lanes));
+                std::memcpy(out.normal[column * 3 + row] + i, &normal, sizeof(Lanes));
+            }
+        }
+    }
+}
+
+/// `a * b`, for world matrices of children.
+[[gnu::always_inline]] static inline void multiply(
+    const glm::mat4x4& a,
+    const glm::mat4x4& b,
+    glm::mat4x4& out
+) {
+#if defined(__SSE2__)
+    auto a_0 = _mm_loadu_ps(&a[0][0]);
+    auto a_1 = _mm_loadu_ps(&a[1][0]);
+    auto a_2 = _mm_loadu_ps(&a[2][0]);
+    auto a_3 = _mm_loadu_ps(&a[3][0]);
+    for (int j = 0; j < 4; ++j) {
+        auto result = _mm_mul_ps(a_0, _mm_set1_ps(b[j][0]));
+        result = _mm_add_ps(result, _mm_mul_ps(a_1, _mm_set1_ps(b[j][1])));
+        result = _mm_add_ps(result, _mm_mul_ps(a_2, _mm_set1_ps(b[j][2])));
+        result = _mm_add_ps(result, _mm_mul_ps(a_3, _mm_set1_ps(b[j][3])));
+        _mm_storeu_ps(&out[j][0], result);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    auto a_0 = vld1q_f32(&a[0][0]);
+    auto a_1 = vld1q_f32(&a[1][0]);
+    auto a_2 = vld1q_f32(&a[2][0]);
+    auto a_3 = vld1q_f32(&a[3][0]);
+    for (int j = 0; j < 4; ++j) {
+        auto b_column = vld1q_f32(&b[j][0]);
+        auto result = vmulq_laneq_f32(a_0, b_column, 0);
+        result = vfmaq_laneq_f32(result, a_1, b_column, 1);
+        result = vfmaq_laneq_f32(result, a_2, b_column, 2);
+        result = vfmaq_laneq_f32(result, a_3, b_column, 3);
+        vst1q_f32(&out[j][0], result);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+/// Kernels of one instruction set, picked once by the constructor of `TransformSystem`.
+struct TransformKernels {
+    std::string_view name;
+    void (*compute_matrices)(const TrsBatch& trs, MatrixBatch& out);
+    /// World matrices of `order`, in which parents come before their children.
+    void (*propagate)(
+        std::span<const uint32_t> order,
+        const uint32_t* parents,
+        const glm::mat4x4* local_model_matrices,
+        const glm::mat4x4* local_normal_matrices,
+        glm::mat4x4* model_matrices,
+        glm::mat4x4* normal_matrices
+    );
+};
+
+static void compute_matrices_native(const TrsBatch& trs, MatrixBatch& out) {
+    compute_matrices<NativeLanes>(trs, out);
+}
+
+static void propagate_native(
+    std::span<const uint32_t> order,
+    const uint32_t* parents,
+    const glm::mat4x4* local_model_matrices,
+    const glm::mat4x4* local_normal_matrices,
+    glm::mat4x4* model_matrices,
+    glm::mat4x4* normal_matrices
+) {
+    for (auto slot : order) {
+        auto parent = parents[slot];
+        if (parent == TransformSystem::NULL_SLOT) {
+            model_matrices[slot] = local_model_matrices[slot];
+            normal_matrices[slot] = local_normal_matrices[slot];
+            continue;
+        }
+        multiply(model_matrices[parent], local_model_matrices[slot], model_matrices[slot]);
+        // (P * L)^-T = P^-T * L^-T.
+        multiply(normal_matrices[parent], local_normal_matrices[slot], normal_matrices[slot]);
+    }
+}
+
+static constexpr auto NATIVE_KERNELS = TransformKernels {
+#if defined(__SSE2__)
+    .name = "SSE2",
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    .name = "NEON",
+#else
+    .name = "scalar",
+#endif
+    .compute_matrices = compute_matrices_native,
+    .propagate = propagate_native,
+};
+
+#if defined(HAS_AVX2_KERNELS)
+// Compiled for AVX2 and FMA alone, so that the rest of the app runs on any x86-64 CPU.
+
+__attribute__((target("avx2,fma"))) static void compute_matrices_avx2(
+    const TrsBatch& trs,
+    MatrixBatch& out
+) {
+    compute_matrices<__m256>(trs, out);
+}
+
+/// Two columns of the result at a time, the columns of `a` are duplicated in both halves.
+__attribute__((target("avx2,fma"))) [[gnu::always_inline]] static inline void multiply_avx2(
+    const glm::mat4x4& a,
+    const glm::mat4x4& b,
+    glm::mat4x4& out
+) {
+    const float* a_data = &a[0][0];
+    auto a_0 = _mm256_broadcast_ps((const __m128*)(a_data + 0));
+    auto a_1 = _mm256_broadcast_ps((const __m128*)(a_data + 4));
+    auto a_2 = _mm256_broadcast_ps((const __m128*)(a_data + 8));
+    auto a_3 = _mm256_broadcast_ps((const __m128*)(a_data + 12));
+    for (int j = 0; j < 4; j += 2) {
+        auto b_columns = _mm256_loadu_ps(&b[j][0]);
+        auto result = _mm256_mul_ps(a_0, _mm256_permute_ps(b_columns, 0x00));
+        result = _mm256_fmadd_ps(a_1, _mm256_permute_ps(b_columns, 0x55), result);
+        result = _mm256_fmadd_ps(a_2, _mm256_permute_ps(b_columns, 0xAA), result);
+        result = _mm256_fmadd_ps(a_3, _mm256_permute_ps(b_columns, 0xFF), result);
+        _mm256_storeu_ps(&out[j][0], result);
+    }
+}
+
+/// Same as `propagate_native`, GCC does not inline AVX2 functions into generic templates.
+__attribute__((target("avx2,fma"))) static void propagate_avx2(
+    std::span<const uint32_t> order,
+    const uint32_t* parents,
+    const glm::mat4x4* local_model_matrices,
+    const glm::mat4x4* local_normal_matrices,
+    glm::mat4x4* model_matrices,
+    glm::mat4x4* normal_matrices
+) {
+    for (auto slot : order) {
+        auto parent = parents[slot];
+        if (parent == TransformSystem::NULL_SLOT) {
+            model_matrices[slot] = local_model_matrices[slot];
+            normal_matrices[slot] = local_normal_matrices[slot];
+            continue;
+        }
+        multiply_avx2(model_matrices[parent], local_model_matrices[slot], model_matrices[slot]);
+        multiply_avx2(normal_matrices[parent], local_normal_matrices[slot], normal_matrices[slot]);
+    }
+}
+
+static constexpr auto AVX2_KERNELS = TransformKernels {
+    .name = "AVX2",
+    .compute_matrices = compute_matrices_avx2,
+    .propagate = propagate_avx2,
+};
+#endif
+
+static const TransformKernels* pick_kernels() {
+#if defined(HAS_AVX2_KERNELS)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return &AVX2_KERNELS;
+    }
+#endif
+    return &NATIVE_KERNELS;
+}
+
+TransformSystem::TransformSystem()
+    : kernels(pick_kernels()) {}
+
+std::string_view TransformSystem::kernel_name() const {
+    return this->kernels->name;
+}
+
+void TransformSystem::resize(size_t size) {
+    this->translation_x.resize(size);
+    this->translation_y.resize(size);
+    this->translation_z.resize(size);
+    this->rotation_x.resize(size);
+    this->rotation_y.resize(size);
+    this->rotation_z.resize(size);
+    this->rotation_w.resize(size);
+    this->scale_x.resize(size);
+    this->scale_y.resize(size);
+    this->scale_z.resize(size);
+    this->local_model_matrices.resize(size, glm::identity<glm::mat4x4>());
+    this->local_normal_matrices.resize(size, glm::identity<glm::mat4x4>());
+    this->model_matrices.resize(size, glm::identity<glm::mat4x4>());
+    this->normal_matrices.resize(size, glm::identity<glm::mat4x4>());
+    this->parents.resize(size, NULL_SLOT);
+    this->first_children.resize(size, NULL_SLOT);
+    this->next_siblings.resize(size, NULL_SLOT);
+    this->previous_siblings.resize(size, NULL_SLOT);
+    this->is_dirty.resize(size);
+}
+
+void TransformSystem::mark_dirty(uint32_t slot) {
+    if (!this->is_dirty[slot]) {
+        this->is_dirty[slot] = true;
+        this->dirty.push_back(slot);
+    }
+}
+
+void TransformSystem::set(uint32_t slot, const Transform& transform) {
+    if (slot >= this->model_matrices.size()) {
+        this->resize((size_t)slot + 1);
+    }
+    this->translation_x[slot] = transform.translation.x;
+    this->translation_y[slot] = transform.translation.y;
+    this->translation_z[slot] = transform.translation.z;
+    this->rotation_x[slot] = transform.rotation.x;
+    this->rotation_y[slot] = transform.rotation.y;
+    this->rotation_z[slot] = transform.rotation.z;
+    this->rotation_w[slot] = transform.rotation.w;
+    this->scale_x[slot] = transform.scale.x;
+    this->scale_y[slot] = transform.scale.y;
+    this->scale_z[slot] = transform.scale.z;
+    this->mark_dirty(slot);
+}
+
+Transform TransformSystem::get(uint32_t slot) const {
+    assert(slot < this->model_matrices.size());
+    return Transform {
+        .translation = glm::vec3(
+            this->translation_x[slot],
+            this->translation_y[slot],
+            this->translation_z[slot]
+        ),
+        .rotation = glm::quat::wxyz(
+            this->rotation_w[slot],
+            this->rotation_x[slot],
+            this->rotation_y[slot],
+            this->rotation_z[slot]
+        ),
+        .scale = glm::vec3(this->scale_x[slot], this->scale_y[slot], this->scale_z[slot]),
+    };
+}
+
+bool TransformSystem::set_parent(uint32_t slot, uint32_t parent) {
+    assert(slot < this->parents.size());
+    assert(parent == NULL_SLOT || parent < this->parents.size());
+    if (this->parents[slot] == parent) {
+        return true;
+    }
+    for (auto ancestor = parent; ancestor != NULL_SLOT; ancestor = this->parents[ancestor]) {
+        if (ancestor == slot) {
+            return false;
+        }
+    }
+    this->unlink_from_parent(slot);
+    if (parent != NULL_SLOT) {
+        auto next_sibling = this->first_children[parent];
+        this->parents[slot] = parent;
+        this->next_siblings[slot] = next_sibling;
+        if (next_sibling != NULL_SLOT) {
+            this->previous_siblings[next_sibling] = slot;
+        }
+        this->first_children[parent] = slot;
+    }
+    this->mark_dirty(slot);
+    return true;
+}
+
+uint32_t TransformSystem::get_parent(uint32_t slot) const {
+    assert(slot < this->parents.size());
+    return this->parents[slot];
+}
+
+void TransformSystem::remove(uint32_t slot) {
+    assert(slot < this->parents.size());
+    this->unlink_from_parent(slot);
+    this->mark_dirty(slot);
+    while (this->first_children[slot] != NULL_SLOT) {
+        auto child = this->first_children[slot];
+        this->unlink_from_parent(child);
+        this->mark_dirty(child);
+    }
+}
+
+void TransformSystem::unlink_from_parent(uint32_t slot) {
+    auto parent = this->parents[slot];
+    if (parent == NULL_SLOT) {
+        return;
+    }
+    auto previous_sibling = this->previous_siblings[slot];
+    auto next_sibling = this->next_siblings[slot];
+    if (previous_sibling != NULL_SLOT) {
+        this->next_siblings[previous_sibling] = next_sibling;
+    } else {
+        this->first_children[parent] = next_sibling;
+    }
+    if (next_sibling != NULL_SLOT) {
+        this->previous_siblings[next_sibling] = previous_sibling;
+    }
+    this->parents[slot] = NULL_SLOT;
+    this->previous_siblings[slot] = NULL_SLOT;
+    this->next_siblings[slot] = NULL_SLOT;
+}
+
+bool TransformSystem::has_dirty_ancestor(uint32_t slot) const {
+    for (auto ancestor = this->parents[slot]; ancestor != NULL_SLOT;
+         ancestor = this->parents[ancestor]) {
+        if (this->is_dirty[ancestor]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransformSystem::update() {
+    // Local matrices of dirty slots.
+    auto trs = TrsBatch {};
+    auto matrices = MatrixBatch {};
+    for (size_t begin = 0; begin < this->dirty.size(); begin += BATCH_SIZE) {
+        auto count = std::min(BATCH_SIZE, this->dirty.size() - begin);
+
+        // Gather. Unused lanes are identity transforms.
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            auto slot = i < count ? this->dirty[begin + i] : UINT32_MAX;
+            bool used = slot != UINT32_MAX;
+            trs.translation_x[i] = used ? this->translation_x[slot] : 0.0f;
+            trs.translation_y[i] = used ? this->translation_y[slot] : 0.0f;
+            trs.translation_z[i] = used ? this->translation_z[slot] : 0.0f;
+            trs.rotation_x[i] = used ? this->rotation_x[slot] : 0.0f;
+            trs.rotation_y[i] = used ? this->rotation_y[slot] : 0.0f;
+            trs.rotation_z[i] = used ? this->rotation_z[slot] : 0.0f;
+            trs.rotation_w[i] = used ? this->rotation_w[slot] : 1.0f;
+            trs.scale_x[i] = used ? this->scale_x[slot] : 1.0f;
+            trs.scale_y[i] = used ? this->scale_y[slot] : 1.0f;
+            trs.scale_z[i] = used ? this->scale_z[slot] : 1.0f;
+        }
+
+        this->kernels->compute_matrices(trs, matrices);
+
+        // Scatter.
+        for (size_t i = 0; i < count; ++i) {
+            auto slot = this->dirty[begin + i];
+            auto& model = this->local_model_matrices[slot];
+            auto& normal = this->local_normal_matrices[slot];
+            for (size_t column = 0; column < 3; ++column) {
+                for (size_t row = 0; row < 3; ++row) {
+                    model[column][row] = matrices.model[column * 3 + row][i];
+                    normal[column][row] = matrices.normal[column * 3 + row][i];
+                }
+                model[column][3] = 0.0f;
+                normal[column][3] = 0.0f;
+            }
+            model[3] =
+                glm::vec4(trs.translation_x[i], trs.translation_y[i], trs.translation_z[i], 1);
+            // The translation does not affect normals.
+            normal[3] = glm::vec4(0, 0, 0, 1);
+        }
+    }
+
+    // World matrices, depth-first from the topmost dirty slots so that parents come before
+    // children. Clean subtrees are not visited.
+    this->updated.clear();
+    for (auto root : this->dirty) {
+        if (this->has_dirty_ancestor(root)) {
+            continue;
+        }
+        this->traversal_stack.push_back(root);
+        while (!this->traversal_stack.empty()) {
+            auto slot = this->traversal_stack.back();
+            this->traversal_stack.pop_back();
+            this->updated.push_back(slot);
+            for (auto child = this->first_children[slot]; child != NULL_SLOT;
+                 child = this->next_siblings[child]) {
+                this->traversal_stack.push_back(child);
+            }
+        }
+    }
+    this->kernels->propagate(
+        this->updated,
+        this->parents.data(),
+        this->local_model_matrices.data(),
+        this->local_normal_matrices.data(),
+        this->model_matrices.data(),
+        this->normal_matrices.data()
+    );
+    for (auto slot : this->dirty) {
+        this->is_dirty[slot] = false;
+    }
+    this->dirty.clear();
+}
+
+std::span<const uint32_t> TransformSystem::get_updated() const {
+    return this->updated;
+}
+
+const glm::mat4x4& TransformSystem::get_model_matrix(uint32_t slot) const {
+    assert(slot < this->model_matrices.size());
+    return this->model_matrices[slot];
+}
+
+const glm::mat4x4& TransformSystem::get_normal_matrix(uint32_t slot) const {
+    assert(slot < this->normal_matrices.size());
+    return this->normal_matrices[slot];
+}
+
+void TransformSystem::write_instances(
+    std::span<const uint32_t> slots,
+    std::span<InstanceTransforms> instances
+) const {
+    assert(slots.size() == instances.size());
+    for (size_t i = 0; i < slots.size(); ++i) {
+        auto slot = slots[i];
+        if (slot == NULL_SLOT) {
+            continue;
+        }
+        instances[i] = InstanceTransforms {
+            .model = this->model_matrices[slot],
+            .normal_transform = this->normal_matrices[slot],
+        };
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "geometry/base.hxx"
+
+/// Translation, rotation and scale, applied in the order of scale, rotation, translation.
+struct Transform {
+    glm::vec3 translation = glm::vec3(0, 0, 0);
+    glm::quat rotation = glm::identity<glm::quat>();
+    glm::vec3 scale = glm::vec3(1, 1, 1);
+
+    glm::mat4x4 to_matrix() const;
+};
+
+/// SIMD kernels of `TransformSystem`, see `transform_system.cxx`.
+struct TransformKernels;
+
+/// Transforms of all entities of a scene, in SoA arrays indexed by slot index of the entity.
+///
+/// Transforms form a hierarchy: each transform is local to its parent, if any. Model and normal
+/// matrices are cached and only recomputed in `update` for transforms that changed and their
+/// descendants. Local matrices are computed 8 at a time, and world matrices propagated, with SIMD
+/// kernels: AVX2 on x86-64 CPUs supporting it, detected at runtime, SSE2 on other x86-64 CPUs,
+/// NEON, with a scalar fallback. As transforms are TRS, the local normal matrix (inverse-transpose
+/// of the model matrix) is just the rotation divided by the scale, with no general matrix inverse,
+/// and world normal matrices are products of local ones like world model matrices.
+class TransformSystem {
+    std::vector<float> translation_x = {};
+    std::vector<float> translation_y = {};
+    std::vector<float> translation_z = {};
+    std::vector<float> rotation_x = {};
+    std::vector<float> rotation_y = {};
+    std::vector<float> rotation_z = {};
+    std::vector<float> rotation_w = {};
+    std::vector<float> scale_x = {};
+    std::vector<float> scale_y = {};
+    std::vector<float> scale_z = {};
+
+    std::vector<glm::mat4x4> local_model_matrices = {};
+    std::vector<glm::mat4x4> local_normal_matrices = {};
+    std::vector<glm::mat4x4> model_matrices = {};
+    std::vector<glm::mat4x4> normal_matrices = {};
+
+    // Hierarchy, as intrusive doubly linked lists of children. `NULL_SLOT` for none.
+    std::vector<uint32_t> parents = {};
+    std::vector<uint32_t> first_children = {};
+    std::vector<uint32_t> next_siblings = {};
+    std::vector<uint32_t> previous_siblings = {};
+
+    /// Whether the local transform or the parent changed since the last update.
+    std::vector<uint8_t> is_dirty = {};
+    std::vector<uint32_t> dirty = {};
+    /// Slots whose world matrices were recomputed, in topological order.
+    std::vector<uint32_t> updated = {};
+    std::vector<uint32_t> traversal_stack = {};
+
+    const TransformKernels* kernels = nullptr;
+
+  public:
+    /// No slot, for roots in the hierarchy and in `write_instances`.
+    static constexpr uint32_t NULL_SLOT = UINT32_MAX;
+
+    /// Picks the kernels for the CPU.
+    TransformSystem();
+
+    /// Of the instruction set of the kernels, for benchmarks.
+    std::string_view kernel_name() const;
+
+    /// Sets the transform relative to the parent.
+    void set(uint32_t slot, const Transform& transform);
+
+    Transform get(uint32_t slot) const;
+
+    /// `parent` may be `NULL_SLOT` to make `slot` a root.
+    /// Returns false without changing anything if that would make a cycle.
+    bool set_parent(uint32_t slot, uint32_t parent);
+
+    /// `NULL_SLOT` for roots.
+    uint32_t get_parent(uint32_t slot) const;
+
+    /// Detaches `slot` from its parent and its children, which become roots.
+    void remove(uint32_t slot);
+
+    /// Recomputes matrices of transforms set or reparented since the last update, and of their
+    /// descendants.
+    void update();
+
+    /// Slots whose world matrices were recomputed by the last `update`, parents before children.
+    std::span<const uint32_t> get_updated() const;
+
+    /// World model matrix, only valid after `update`.
+    const glm::mat4x4& get_model_matrix(uint32_t slot) const;
+
+    /// World normal matrix, only valid after `update`.
+    const glm::mat4x4& get_normal_matrix(uint32_t slot) const;
+
+    /// Writes instance transforms of `slots[i]` into `instances[i]`, skipping `NULL_SLOT`s.
+    void write_instances(
+        std::span<const uint32_t> slots,
+        std::span<InstanceTransforms> instances
+    ) const;
+
+  private:
+    void resize(size_t size);
+
+    void mark_dirty(uint32_t slot);
+
+    bool has_dirty_ancestor(uint32_t slot) const;
+
+    void unlink_from_parent(uint32_t slot);
+};
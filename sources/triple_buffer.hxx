@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/// Lock-free handoff of values from one producer thread to one consumer thread.
+///
+/// The producer writes into its back buffer and publishes it, which swaps it with the middle
+/// buffer. The consumer takes the middle buffer if it was published since it last took one, which
+/// swaps it with its front buffer. Neither side ever waits for the other, the consumer never sees a
+/// buffer being written, and published values that the consumer did not take in time are dropped.
+///
+/// Buffers are reused: after `publish`, the back buffer holds an older value, which the producer
+/// must overwrite entirely.
+template <class T>
+class TripleBuffer {
+    static constexpr uint8_t INDEX_MASK = 3;
+    /// Set in `middle` when it was published and not consumed yet.
+    static constexpr uint8_t FRESH_BIT = 4;
+
+    std::array<T, 3> buffers = {};
+    std::atomic<uint8_t> middle = 1;
+    /// Only accessed by the producer.
+    uint8_t back = 0;
+    /// Only accessed by the consumer.
+    uint8_t front = 2;
+
+  public:
+    /// Producer side.
+    T& get_back() {
+        return this->buffers[this->back];
+    }
+
+    /// Producer side. Makes the back buffer the latest value.
+    void publish() {
+        auto previous = this->middle.exchange(this->back | FRESH_BIT, std::memory_order_acq_rel);
+        this->back = previous & INDEX_MASK;
+    }
+
+    /// Consumer side. Takes the latest published value if there is a new one, returns whether it
+    /// did.
+    bool consume() {
+        if ((this->middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        auto previous = this->middle.exchange(this->front, std::memory_order_acq_rel);
+        this->front = previous & INDEX_MASK;
+        return true;
+    }
+
+    /// Consumer side. The value last taken with `consume`, default-constructed before that.
+    const T& get_front() const {
+        return this->buffers[this->front];
+    }
+};
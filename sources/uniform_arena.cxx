@@ -0,0 +1,78 @@
+#include "uniform_arena.hxx"
+#include "log.hxx"
+
+#include <bit>
+#include <cassert>
+
+using namespace std::literals;
+
+UniformArena::UniformArena(wgpu::Device device) : device(std::move(device)) {
+    wgpu::Limits limits;
+    this->device.GetLimits(&limits);
+    this->alignment = limits.minUniformBufferOffsetAlignment;
+    this->free_slots.resize(this->size_class_of(PAGE_SIZE) + 1);
+}
+
+UniformArena::Slot UniformArena::allocate(uint32_t size) {
+    if (size == 0 || size > PAGE_SIZE) {
+        log_error("uniform arena slot size {} not in [1, {}]", size, PAGE_SIZE);
+        abort();
+    }
+    auto size_class = this->size_class_of(size);
+    auto& free_slots = this->free_slots[size_class];
+    if (free_slots.empty()) {
+        auto descriptor = wgpu::BufferDescriptor {
+            .label = "Uniform Arena"sv,
+            .usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
+            .size = PAGE_SIZE,
+            .mappedAtCreation = false,
+        };
+        auto page = (uint32_t)this->pages.size();
+        this->pages.push_back(Page {
+            .buffer = this->device.CreateBuffer(&descriptor),
+            .size_class = size_class,
+            .used = 0,
+        });
+        // In reverse, so that slots are handed out in increasing offsets.
+        auto slot_size = this->alignment << size_class;
+        for (auto offset = PAGE_SIZE / slot_size * slot_size; offset > 0;) {
+            offset -= slot_size;
+            free_slots.emplace_back(page, offset);
+        }
+        log_verbose("allocated uniform arena page {} for slots of {} bytes", page, slot_size);
+    }
+    auto [page, offset] = free_slots.back();
+    free_slots.pop_back();
+    ++this->pages[page].used;
+    ++this->slot_count;
+    this->used_bytes += size;
+    return Slot {
+        .buffer = this->pages[page].buffer,
+        .offset = offset,
+        .size = size,
+        .page = page,
+    };
+}
+
+void UniformArena::free(const Slot& slot) {
+    assert(slot.page < this->pages.size() && this->pages[slot.page].used > 0);
+    auto& page = this->pages[slot.page];
+    --page.used;
+    --this->slot_count;
+    this->used_bytes -= slot.size;
+    this->free_slots[page.size_class].emplace_back(slot.page, slot.offset);
+}
+
+UniformArena::Stats UniformArena::stats() const {
+    return Stats {
+        .pages = this->pages.size(),
+        .slots = this->slot_count,
+        .used_bytes = this->used_bytes,
+        .page_bytes = this->pages.size() * PAGE_SIZE,
+    };
+}
+
+uint32_t UniformArena::size_class_of(uint32_t size) const {
+    auto blocks = (size + this->alignment - 1) / this->alignment;
+    return (uint32_t)std::bit_width(blocks - 1);
+}
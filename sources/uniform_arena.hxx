@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+/// Long-lived uniform data of materials and geometries, packed into shared pages instead of one
+/// small buffer each.
+///
+/// Slots are offsets aligned to `minUniformBufferOffsetAlignment` in 64 KiB pages. Each page holds
+/// slots of a single size class, a power of two multiple of the alignment, and freed slots are
+/// recycled for the next allocation of their class. Slots are bound with their buffer and offset
+/// like standalone buffers, and written with `WriteBuffer` at their offset.
+class UniformArena {
+    wgpu::Device device = nullptr;
+
+    struct Page {
+        wgpu::Buffer buffer;
+        uint32_t size_class;
+        uint32_t used;
+    };
+
+  public:
+    static constexpr uint32_t PAGE_SIZE = 64 * 1024;
+
+    struct Slot {
+        wgpu::Buffer buffer = nullptr;
+        uint32_t offset = 0;
+        /// Requested size, the slot may be larger.
+        uint32_t size = 0;
+        uint32_t page = UINT32_MAX;
+    };
+
+    struct Stats {
+        size_t pages = 0;
+        size_t slots = 0;
+        /// Requested bytes of live slots.
+        size_t used_bytes = 0;
+        size_t page_bytes = 0;
+    };
+
+  private:
+    std::vector<Page> pages = {};
+    /// Free slots of each size class, as page index and offset.
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> free_slots = {};
+
+    /// `minUniformBufferOffsetAlignment` of the device.
+    uint32_t alignment = 256;
+
+    size_t slot_count = 0;
+    size_t used_bytes = 0;
+
+  public:
+    UniformArena() = default;
+
+    UniformArena(wgpu::Device device);
+
+    /// `size` must be at most `PAGE_SIZE`. The content is undefined until written.
+    Slot allocate(uint32_t size);
+
+    void free(const Slot& slot);
+
+    Stats stats() const;
+
+  private:
+    uint32_t size_class_of(uint32_t size) const;
+};
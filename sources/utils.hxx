@@ -2,6 +2,7 @@
 
 #include <webgpu/webgpu_cpp.h>
 #include <fstream>
+#include <string_view>
 #include <source_location>
 
 #include "log.hxx"
@@ -110,3 +111,23 @@ static inline bool format_is_float(wgpu::TextureFormat format) {
     default: return false;
     }
 }
+
+/// WGSL texel format of `format` for write-only storage textures, empty if textures of `format`
+/// cannot be written as storage textures on `device`.
+static inline std::string_view storage_texel_format(
+    const wgpu::Device& device,
+    wgpu::TextureFormat format
+) {
+    switch (format) {
+    case wgpu::TextureFormat::RGBA8Unorm: return "rgba8unorm";
+    case wgpu::TextureFormat::RGBA16Float: return "rgba16float";
+    case wgpu::TextureFormat::RGBA32Float: return "rgba32float";
+    case wgpu::TextureFormat::BGRA8Unorm: {
+        if (device.HasFeature(wgpu::FeatureName::BGRA8UnormStorage)) {
+            return "bgra8unorm";
+        }
+        return "";
+    }
+    default: return "";
+    }
+}
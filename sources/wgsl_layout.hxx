@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/// Compile-time WGSL memory layouts of C++ structs shared with shaders.
+///
+/// A layout lists the fields of a struct with `WGSL_FIELD`, computes their offsets with the WGSL
+/// alignment and size rules of an address space, and fails to compile if they differ from the
+/// offsets and size of the C++ struct. It then provides the WGSL declaration of the struct and its
+/// size for `minBindingSize`:
+///
+/// ```cpp
+/// inline constexpr auto PARAMETERS_LAYOUT = wgsl::struct_layout<Parameters, wgsl::Uniform>(
+///     "Parameters",
+///     WGSL_FIELD(Parameters, color),
+///     WGSL_FIELD(Parameters, strength)
+/// );
+/// template <>
+/// struct wgsl::TypeOf<Parameters> : wgsl::StructType<PARAMETERS_LAYOUT> {};
+/// ```
+///
+/// The `TypeOf` specialization makes the struct usable as a field of other layouts.
+namespace wgsl {
+
+enum AddressSpace {
+    Uniform,
+    Storage,
+};
+
+/// Host-shareable WGSL type.
+struct TypeInfo {
+    /// Element type name for arrays.
+    std::string_view name;
+    uint32_t align;
+    uint32_t size;
+    /// Element count of fixed-size arrays, 0 for other types.
+    uint32_t array_count = 0;
+    bool is_struct = false;
+};
+
+/// WGSL type of a C++ type, specialized for scalars, glm vectors and matrices, `std::array`s of
+/// those, and structs with a layout.
+template <class T>
+struct TypeOf;
+
+template <>
+struct TypeOf<float> {
+    static constexpr auto info = TypeInfo {.name = "f32", .align = 4, .size = 4};
+};
+
+template <>
+struct TypeOf<int32_t> {
+    static constexpr auto info = TypeInfo {.name = "i32", .align = 4, .size = 4};
+};
+
+template <>
+struct TypeOf<uint32_t> {
+    static constexpr auto info = TypeInfo {.name = "u32", .align = 4, .size = 4};
+};
+
+template <>
+struct TypeOf<glm::vec2> {
+    static constexpr auto info = TypeInfo {.name = "vec2<f32>", .align = 8, .size = 8};
+};
+
+template <>
+struct TypeOf<glm::vec3> {
+    static constexpr auto info = TypeInfo {.name = "vec3<f32>", .align = 16, .size = 12};
+};
+
+template <>
+struct TypeOf<glm::vec4> {
+    static constexpr auto info = TypeInfo {.name = "vec4<f32>", .align = 16, .size = 16};
+};
+
+template <>
+struct TypeOf<glm::mat4x4> {
+    static constexpr auto info = TypeInfo {.name = "mat4x4<f32>", .align = 16, .size = 64};
+};
+
+template <class T, size_t N>
+struct TypeOf<std::array<T, N>> {
+    static_assert(TypeOf<T>::info.array_count == 0, "nested arrays are not supported");
+    static constexpr auto info = TypeInfo {
+        .name = TypeOf<T>::info.name,
+        .align = TypeOf<T>::info.align,
+        // The stride is the element size rounded up to its alignment.
+        .size = (uint32_t)N * ((TypeOf<T>::info.size + TypeOf<T>::info.align - 1) /
+                               TypeOf<T>::info.align * TypeOf<T>::info.align),
+        .array_count = (uint32_t)N,
+        .is_struct = TypeOf<T>::info.is_struct,
+    };
+};
+
+struct Field {
+    std::string_view name;
+    TypeInfo type;
+    /// Offset in the C++ struct.
+    uint32_t host_offset;
+};
+
+template <class T>
+consteval Field field(std::string_view name, size_t host_offset) {
+    return Field {
+        .name = name,
+        .type = TypeOf<T>::info,
+        .host_offset = (uint32_t)host_offset,
+    };
+}
+
+template <size_t N>
+struct StructLayout {
+    std::string_view name;
+    std::array<Field, N> fields;
+    /// WGSL offset of each field, equal to its offset in the C++ struct.
+    std::array<uint32_t, N> offsets;
+    uint32_t align;
+    uint32_t size;
+
+    constexpr TypeInfo type() const {
+        return TypeInfo {
+            .name = this->name,
+            .align = this->align,
+            .size = this->size,
+            .array_count = 0,
+            .is_struct = true,
+        };
+    }
+
+    /// `struct Name { ... };`, without the declarations of structs it contains.
+    std::string declaration() const {
+        auto code = "struct " + std::string(this->name) + " {\n";
+        for (const auto& field : this->fields) {
+            code += "    " + std::string(field.name) + ": ";
+            if (field.type.array_count != 0) {
+                code += "array<" + std::string(field.type.name) + ", " +
+                        std::to_string(field.type.array_count) + ">";
+            } else {
+                code += std::string(field.type.name);
+            }
+            code += ",\n";
+        }
+        code += "};\n";
+        return code;
+    }
+};
+
+/// Makes a struct with a layout usable as a field type of other layouts.
+template <const auto& layout>
+struct StructType {
+    static constexpr auto info = layout.type();
+};
+
+// Not constexpr, so that calling them from `struct_layout` fails compilation with their names in
+// the error.
+inline void host_offset_differs_from_wgsl_offset() {}
+inline void host_size_differs_from_wgsl_size() {}
+inline void uniform_array_stride_is_not_a_multiple_of_16() {}
+inline void uniform_struct_member_is_not_followed_by_16_byte_padding() {}
+
+constexpr uint32_t round_up(uint32_t alignment, uint32_t value) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/// Alignment of a field of `type` in structs of `address_space`.
+constexpr uint32_t field_align(AddressSpace address_space, const TypeInfo& type) {
+    // Structs and arrays in the uniform address space are aligned to 16 bytes.
+    if (address_space == Uniform && (type.array_count != 0 || type.is_struct)) {
+        return round_up(16, type.align);
+    }
+    return type.align;
+}
+
+/// Layout of `S` in `address_space`, checked against the C++ layout.
+template <class S, AddressSpace address_space, std::same_as<Field>... F>
+consteval StructLayout<sizeof...(F)> struct_layout(std::string_view name, F... fields) {
+    auto layout = StructLayout<sizeof...(F)> {
+        .name = name,
+        .fields = {fields...},
+        .offsets = {},
+        .align = 1,
+        .size = 0,
+    };
+    uint32_t offset = 0;
+    // In the uniform address space, a member of struct type must be followed by at least
+    // `roundUp(16, SizeOf(S))` bytes before the next member. Declarations have no `@align` or
+    // `@size` attributes, so that padding must come from the alignment of the next member.
+    uint32_t min_offset = 0;
+    for (size_t i = 0; i < layout.fields.size(); ++i) {
+        const auto& type = layout.fields[i].type;
+        auto align = field_align(address_space, type);
+        if (address_space == Uniform && type.array_count != 0 &&
+            type.size / type.array_count % 16 != 0) {
+            uniform_array_stride_is_not_a_multiple_of_16();
+        }
+        offset = round_up(align, offset);
+        if (offset < min_offset) {
+            uniform_struct_member_is_not_followed_by_16_byte_padding();
+        }
+        if (offset != layout.fields[i].host_offset) {
+            host_offset_differs_from_wgsl_offset();
+        }
+        layout.offsets[i] = offset;
+        if (address_space == Uniform && type.is_struct && type.array_count == 0) {
+            min_offset = offset + round_up(16, type.size);
+        }
+        offset += type.size;
+        layout.align = std::max(layout.align, align);
+    }
+    layout.size = round_up(layout.align, offset);
+    if (layout.size != sizeof(S)) {
+        host_size_differs_from_wgsl_size();
+    }
+    return layout;
+}
+
+} // namespace wgsl
+
+/// `wgsl::Field` of `member` of struct `S`, named as in C++.
+#define WGSL_FIELD(S, member) ::wgsl::field<decltype(S::member)>(#member, offsetof(S, member))